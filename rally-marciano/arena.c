@@ -0,0 +1,151 @@
+/*
+ * Arena em ladrilhos alocados na primeira escrita (Arena em rally.h).
+ *
+ * O diretório e a reserva são os de diretorio.h: a memória usada é a dos
+ * ladrilhos com algum pilar, bateria, figura ou robô, arredondada para
+ * cima até o fim do segmento da reserva, mais a dos grupos do diretório
+ * que têm algum desses ladrilhos e um ponteiro por grupo.
+ *
+ * Quem lê um ladrilho não alocado, ou que outra thread está iniciando,
+ * encontra no diretório um dos ladrilhos vazios dele, o que o ladrilho de
+ * fato é até a publicação.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rally.h"
+
+static void inicia_ladrilho(void *bloco)
+{
+    // Células vazias e sem robôs (-1 tem todos os bytes 0xff)
+    Ladrilho *l = (Ladrilho *) bloco;
+    memset(l->obj, VAZIO, sizeof(l->obj));
+    memset(l->id, 0xff, sizeof(l->id));
+}
+
+/*
+ * 1 se a arena cabe no diretório: no máximo MAX_LADRILHOS posições, para
+ * que os índices de célula caibam em size_t e o vetor de grupos, que tem
+ * um ponteiro por LADRILHOS_GRUPO posições, não passe de 128 MB.
+ */
+int arena_dimensoes_validas(Coordenada linhas, Coordenada colunas)
+{
+    if (linhas < 0 || colunas < 0 || linhas > MAX_COORDENADA || colunas > MAX_COORDENADA)
+        return 0;
+    size_t faixas = ((size_t) linhas + LADO_LADRILHO - 1) >> BITS_LADRILHO;
+    size_t por_linha = ((size_t) colunas + LADO_LADRILHO - 1) >> BITS_LADRILHO;
+    return por_linha == 0 || faixas <= MAX_LADRILHOS / por_linha;
+}
+
+/* Travas listradas de a: uma por célula em arenas pequenas, no máximo MAX_TRAVAS nas grandes */
+static void cria_travas(Arena *a)
+{
+    size_t num_celulas = (size_t) a->n_lins * (size_t) a->n_cols;
+    a->num_travas = 1;
+    while (a->num_travas < MAX_TRAVAS && (size_t) a->num_travas < num_celulas)
+        a->num_travas *= 2;
+
+    a->travas = (TravaArena *) aligned_alloc(sizeof(TravaArena),
+                                             a->num_travas * sizeof(TravaArena));
+    for (int t = 0; t < a->num_travas; t++)
+        pthread_mutex_init(&a->travas[t].mutex, NULL);
+}
+
+/* Função para criar a arena com o número de linhas e colunas fornecido, toda vazia */
+void cria_arena(Arena *a, Coordenada linhas, Coordenada colunas)
+{
+    a->n_lins = linhas;
+    a->n_cols = colunas;
+
+    size_t faixas = ((size_t) linhas + LADO_LADRILHO - 1) >> BITS_LADRILHO;
+    a->ladrilhos_por_linha = ((size_t) colunas + LADO_LADRILHO - 1) >> BITS_LADRILHO;
+    a->num_ladrilhos = faixas * a->ladrilhos_por_linha;
+
+    diretorio_cria(&a->ladrilhos, a->num_ladrilhos, sizeof(Ladrilho), inicia_ladrilho);
+    cria_travas(a);
+}
+
+/*
+ * Cria a como cópia de base (modo lote): os ladrilhos de base, com os
+ * pilares, ficam compartilhados até a primeira escrita em cada um, e só
+ * os que têm baterias, figuras ou robôs mexidos são copiados. base não
+ * pode mudar enquanto a existir.
+ */
+void cria_arena_copia(Arena *a, const Arena *base)
+{
+    a->n_lins = base->n_lins;
+    a->n_cols = base->n_cols;
+    a->ladrilhos_por_linha = base->ladrilhos_por_linha;
+    a->num_ladrilhos = base->num_ladrilhos;
+
+    diretorio_cria_copia(&a->ladrilhos, a->num_ladrilhos, &base->ladrilhos);
+    cria_travas(a);
+}
+
+/* Função para desalocar a memória utilizada pela arena */
+void destroi_arena(Arena *a)
+{
+    // Destrói as travas listradas
+    for (int t = 0; t < a->num_travas; t++)
+        pthread_mutex_destroy(&a->travas[t].mutex);
+    free(a->travas);
+
+    // Libera o diretório e a reserva dos ladrilhos
+    diretorio_destroi(&a->ladrilhos);
+}
+
+/* Aloca o ladrilho da posição do diretório de a, ou retorna o que outra thread alocou */
+Ladrilho *aloca_ladrilho_em(Arena *a, size_t posicao)
+{
+    return (Ladrilho *) diretorio_aloca(&a->ladrilhos, posicao);
+}
+
+Ladrilho *aloca_ladrilho(size_t posicao)
+{
+    return aloca_ladrilho_em(&sim->arena, posicao);
+}
+
+/*
+ * Preenche os objetos da linha i com as n_cols células de obj. Só os
+ * ladrilhos com algum objeto diferente de VAZIO na linha são alocados.
+ */
+void arena_poe_linha(Coordenada i, const char *obj)
+{
+    for (Coordenada j = 0; j < sim->arena.n_cols; j += LADO_LADRILHO) {
+        int n = sim->arena.n_cols - j < LADO_LADRILHO ? (int) (sim->arena.n_cols - j)
+                                                       : LADO_LADRILHO;
+        int k = 0;
+        while (k < n && obj[j + k] == VAZIO)
+            k++;
+        if (k == n)
+            continue;
+
+        size_t c = celula(i, j);
+        Ladrilho *l = ladrilho_escrita(c);
+        memcpy(&l->obj[c & (CELULAS_LADRILHO - 1)], &obj[j], (size_t) n);
+    }
+}
+
+/*
+ * Copia os ladrilhos alocados da arena para *ladrilhos e as posições
+ * deles para *posicoes, na ordem de alocação, e retorna quantos são. Os
+ * vetores, de capacidade *cap, crescem quando preciso.
+ */
+size_t arena_copia(Ladrilho **ladrilhos, size_t **posicoes, size_t *cap)
+{
+    const Arena *a = &sim->arena;
+    size_t n = arena_alocados(a);
+    if (n > *cap) {
+        *cap = n > 2 * *cap ? n : 2 * *cap;
+        free(*ladrilhos);
+        *ladrilhos = (Ladrilho *) malloc(*cap * sizeof(Ladrilho));
+        *posicoes = (size_t *) realloc(*posicoes, *cap * sizeof(size_t));
+    }
+    for (size_t k = 0; k < n; k++) {
+        memcpy(&(*ladrilhos)[k], arena_ladrilho_k(a, k), sizeof(Ladrilho));
+        (*posicoes)[k] = arena_posicao_k(a, k);
+    }
+    return n;
+}
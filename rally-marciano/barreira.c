@@ -0,0 +1,306 @@
+/*
+ * Barreiras para as etapas de cada turno do rally.
+ *
+ * Todas as implementações têm a mesma interface: barreira_espera recebe o
+ * índice da thread, usado pelas barreiras que guardam estado por thread e
+ * pela contabilização do tempo de espera.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include <sched.h>
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+#include "barreira.h"
+
+/* Iterações de espera ativa antes de dormir, quando há núcleos para todos */
+#define GIROS_BARREIRA 4000
+
+/* Quando a thread saiu da última barreira em que esperou (com contabilização) */
+static __thread uint64_t ultima_saida_ns;
+
+static inline void pausa_cpu()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+}
+
+/* Dorme enquanto *endereco == esperado */
+static void futex_espera(atomic_int *endereco, int esperado)
+{
+#ifdef __linux__
+    syscall(SYS_futex, (int *) endereco, FUTEX_WAIT_PRIVATE, esperado, NULL, NULL, 0);
+#else
+    if (atomic_load(endereco) == esperado)
+        sched_yield();
+#endif
+}
+
+/* Acorda as threads que dormem em *endereco */
+static void futex_acorda(atomic_int *endereco)
+{
+#ifdef __linux__
+    syscall(SYS_futex, (int *) endereco, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+#else
+    (void) endereco;
+#endif
+}
+
+static inline uint64_t agora_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * Espera *endereco deixar de valer 'antigo': primeiro gira por b->giros
+ * iterações, depois dorme no futex. 'dormindo' avisa quem sinaliza que
+ * precisa chamar futex_acorda.
+ */
+static void espera_valor(Barreira *b, atomic_int *endereco, int antigo, atomic_int *dormindo)
+{
+    for (int g = 0; g < b->giros; g++) {
+        if (atomic_load_explicit(endereco, memory_order_acquire) != antigo)
+            return;
+        pausa_cpu();
+    }
+    while (atomic_load(endereco) == antigo) {
+        atomic_fetch_add(dormindo, 1);
+        futex_espera(endereco, antigo);
+        atomic_fetch_sub(dormindo, 1);
+    }
+}
+
+/* Barreira original: a última thread a chegar acorda as demais */
+static void espera_condvar(Barreira *b)
+{
+    pthread_mutex_lock(&b->mutex);
+
+    unsigned geracao = b->geracao;
+    b->contador++;
+
+    if (b->contador == b->num_threads) {
+        b->contador = 0;
+        b->geracao++;
+        pthread_cond_broadcast(&b->cond);
+    } else {
+        // A geração protege contra despertares espúrios
+        while (geracao == b->geracao)
+            pthread_cond_wait(&b->cond, &b->mutex);
+    }
+    pthread_mutex_unlock(&b->mutex);
+}
+
+/*
+ * Barreira centralizada com inversão de sentido: cada thread decrementa o
+ * contador; a última o restaura e inverte o sentido global, liberando as
+ * outras, que esperam o sentido global ficar igual ao seu sentido local.
+ */
+static void espera_central(Barreira *b, int tid)
+{
+    EstadoBarreira *local = &b->local[tid];
+    int sentido = !local->sentido;
+    local->sentido = sentido;
+
+    if (atomic_fetch_sub(&b->restantes, 1) == 1) {
+        atomic_store(&b->restantes, b->num_threads);
+        atomic_store(&b->sentido, sentido);
+        if (atomic_load(&b->dormindo) > 0)
+            futex_acorda(&b->sentido);
+    } else {
+        espera_valor(b, &b->sentido, !sentido, &b->dormindo);
+    }
+}
+
+/*
+ * Barreira de disseminação: na rodada k a thread i sinaliza a thread
+ * (i + 2^k) mod n e espera o sinal de (i - 2^k) mod n. Após log2(n)
+ * rodadas todas as threads sabem que as demais chegaram. Não há nenhuma
+ * variável escrita por todas as threads.
+ */
+static void espera_disseminacao(Barreira *b, int tid)
+{
+    EstadoBarreira *local = &b->local[tid];
+    int n = b->num_threads;
+
+    for (int k = 0, dist = 1; k < b->rodadas; k++, dist *= 2) {
+        int parceiro = (int) (((long) tid + dist) % n);
+        atomic_int *flag_parceiro = &b->flags[((size_t) parceiro * 2 + local->paridade) * b->rodadas + k];
+        atomic_int *flag = &b->flags[((size_t) tid * 2 + local->paridade) * b->rodadas + k];
+
+        atomic_store(flag_parceiro, local->sentido);
+        if (atomic_load(&b->local[parceiro].dormindo) > 0)
+            futex_acorda(flag_parceiro);
+
+        espera_valor(b, flag, !local->sentido, &local->dormindo);
+    }
+
+    if (local->paridade == 1)
+        local->sentido = !local->sentido;
+    local->paridade = 1 - local->paridade;
+}
+
+void barreira_init(Barreira *b, TipoBarreira tipo, int num_threads, int contabiliza)
+{
+    memset(b, 0, sizeof(Barreira));
+    b->tipo = tipo;
+    b->num_threads = num_threads;
+    b->contabiliza = contabiliza;
+
+    // Girar só compensa se cada thread tiver um núcleo para si
+    long nucleos = sysconf(_SC_NPROCESSORS_ONLN);
+    b->giros = (num_threads <= nucleos) ? GIROS_BARREIRA : 0;
+
+    b->local = (EstadoBarreira *) aligned_alloc(sizeof(EstadoBarreira),
+                                                sizeof(EstadoBarreira) * num_threads);
+    memset(b->local, 0, sizeof(EstadoBarreira) * num_threads);
+
+    switch (tipo) {
+        case BARREIRA_CONDVAR:
+            pthread_mutex_init(&b->mutex, NULL);
+            pthread_cond_init(&b->cond, NULL);
+            break;
+        case BARREIRA_PTHREAD:
+            pthread_barrier_init(&b->pbarreira, NULL, num_threads);
+            break;
+        case BARREIRA_CENTRAL:
+            atomic_init(&b->restantes, num_threads);
+            atomic_init(&b->sentido, 0);
+            atomic_init(&b->dormindo, 0);
+            break;
+        case BARREIRA_DISSEMINACAO:
+            b->rodadas = 0;
+            while ((1L << b->rodadas) < num_threads)
+                b->rodadas++;
+            // Com uma única thread ainda há pelo menos uma rodada (consigo mesma)
+            if (b->rodadas == 0)
+                b->rodadas = 1;
+            b->flags = (atomic_int *) calloc((size_t) num_threads * 2 * b->rodadas, sizeof(atomic_int));
+            for (int t = 0; t < num_threads; t++)
+                b->local[t].sentido = 1;
+            break;
+        case BARREIRA_OMP:
+            break;
+    }
+}
+
+void barreira_espera(Barreira *b, int tid)
+{
+    uint64_t inicio = b->contabiliza ? agora_ns() : 0;
+
+    switch (b->tipo) {
+        case BARREIRA_CONDVAR:
+            espera_condvar(b);
+            break;
+        case BARREIRA_PTHREAD:
+            pthread_barrier_wait(&b->pbarreira);
+            break;
+        case BARREIRA_CENTRAL:
+            espera_central(b, tid);
+            break;
+        case BARREIRA_DISSEMINACAO:
+            espera_disseminacao(b, tid);
+            break;
+        case BARREIRA_OMP: {
+#ifdef _OPENMP
+            // Liga-se à região paralela mais interna em execução
+            #pragma omp barrier
+#endif
+            break;
+        }
+    }
+
+    if (b->contabiliza) {
+        uint64_t fim = agora_ns();
+        // A etapa da thread começou quando ela saiu da barreira anterior
+        if (ultima_saida_ns != 0)
+            b->local[tid].trabalho_ns += inicio - ultima_saida_ns;
+        b->local[tid].espera_ns += fim - inicio;
+        b->local[tid].chamadas++;
+        ultima_saida_ns = fim;
+    }
+}
+
+void barreira_inicia_thread()
+{
+    ultima_saida_ns = 0;
+}
+
+void barreira_destroi(Barreira *b)
+{
+    switch (b->tipo) {
+        case BARREIRA_CONDVAR:
+            pthread_mutex_destroy(&b->mutex);
+            pthread_cond_destroy(&b->cond);
+            break;
+        case BARREIRA_PTHREAD:
+            pthread_barrier_destroy(&b->pbarreira);
+            break;
+        case BARREIRA_CENTRAL:
+            break;
+        case BARREIRA_DISSEMINACAO:
+            free(b->flags);
+            break;
+        case BARREIRA_OMP:
+            break;
+    }
+    free(b->local);
+}
+
+uint64_t barreira_tempo_espera(const Barreira *b)
+{
+    uint64_t total = 0;
+    for (int t = 0; t < b->num_threads; t++)
+        total += b->local[t].espera_ns;
+    return total;
+}
+
+uint64_t barreira_tempo_trabalho(const Barreira *b)
+{
+    uint64_t total = 0;
+    for (int t = 0; t < b->num_threads; t++)
+        total += b->local[t].trabalho_ns;
+    return total;
+}
+
+uint64_t barreira_chamadas(const Barreira *b)
+{
+    uint64_t total = 0;
+    for (int t = 0; t < b->num_threads; t++)
+        total += b->local[t].chamadas;
+    return total;
+}
+
+static const char *nomes_barreira[] = {
+    [BARREIRA_CONDVAR] = "condvar",
+    [BARREIRA_CENTRAL] = "central",
+    [BARREIRA_DISSEMINACAO] = "disseminacao",
+    [BARREIRA_PTHREAD] = "pthread",
+    [BARREIRA_OMP] = "omp",
+};
+
+const char *barreira_nome(TipoBarreira tipo)
+{
+    return nomes_barreira[tipo];
+}
+
+int barreira_tipo_de_nome(const char *nome, TipoBarreira *tipo)
+{
+    for (int t = 0; t < (int) (sizeof(nomes_barreira) / sizeof(nomes_barreira[0])); t++) {
+        // A barreira OpenMP não serve para as threads dos outros motores
+        if (t != BARREIRA_OMP && strcmp(nome, nomes_barreira[t]) == 0) {
+            *tipo = (TipoBarreira) t;
+            return 1;
+        }
+    }
+    return 0;
+}
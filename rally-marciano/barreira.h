@@ -0,0 +1,86 @@
+#ifndef __BARREIRA_H__
+#define __BARREIRA_H__
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+
+/* Implementações de barreira disponíveis */
+typedef enum {
+    BARREIRA_CONDVAR,       // Mutex + pthread_cond_broadcast (implementação original)
+    BARREIRA_CENTRAL,       // Centralizada com inversão de sentido, gira e depois dorme no futex
+    BARREIRA_DISSEMINACAO,  // Disseminação: log2(n) rodadas de sinalização par a par
+    BARREIRA_PTHREAD,       // pthread_barrier_t, usada como referência
+    BARREIRA_OMP            // #pragma omp barrier; só dentro da região paralela do motor omp
+} TipoBarreira;
+
+/* Estado de cada thread na barreira, alinhado para evitar falso compartilhamento */
+typedef struct {
+    int sentido;             // Sentido local (barreira central e disseminação)
+    int paridade;            // Paridade da rodada atual (disseminação)
+    atomic_int dormindo;     // Indica que a thread pode estar dormindo no futex
+    uint64_t espera_ns;      // Tempo acumulado esperando na barreira
+    uint64_t trabalho_ns;    // Tempo acumulado na etapa que termina nesta barreira
+    uint64_t chamadas;       // Número de chamadas a barreira_espera
+} __attribute__((aligned(64))) EstadoBarreira;
+
+typedef struct {
+    TipoBarreira tipo;
+    int num_threads;
+    int giros;          // Iterações de espera ativa antes de dormir no futex
+    int contabiliza;    // Se diferente de 0, mede o tempo de espera de cada thread
+
+    /* BARREIRA_CONDVAR */
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    int contador;
+    unsigned geracao;
+
+    /* BARREIRA_PTHREAD */
+    pthread_barrier_t pbarreira;
+
+    /* BARREIRA_CENTRAL */
+    atomic_int restantes __attribute__((aligned(64)));
+    atomic_int sentido __attribute__((aligned(64)));
+    atomic_int dormindo;
+
+    /* BARREIRA_DISSEMINACAO: flags[tid][paridade][rodada] */
+    int rodadas;
+    atomic_int *flags;
+
+    EstadoBarreira *local;  // Um por thread
+} Barreira;
+
+/* Inicializa a barreira para num_threads threads, identificadas de 0 a num_threads - 1 */
+void barreira_init(Barreira *b, TipoBarreira tipo, int num_threads, int contabiliza);
+
+/* Espera todas as threads chegarem. tid é o índice da thread chamadora */
+void barreira_espera(Barreira *b, int tid);
+
+void barreira_destroi(Barreira *b);
+
+/*
+ * Esquece a última saída de barreira da thread chamadora. Toda thread que
+ * já pode ter esperado numa barreira de outra execução (a que cria as
+ * barreiras, as threads do OpenMP) chama no início da execução, para que
+ * a primeira etapa não conte o intervalo entre as execuções.
+ */
+void barreira_inicia_thread();
+
+/* Soma do tempo de espera de todas as threads, em nanossegundos */
+uint64_t barreira_tempo_espera(const Barreira *b);
+
+/*
+ * Soma, entre todas as threads, do tempo gasto na etapa que termina nesta
+ * barreira: da saída da barreira anterior da thread até a chegada nesta
+ */
+uint64_t barreira_tempo_trabalho(const Barreira *b);
+
+/* Número total de chamadas a barreira_espera (só contado com contabilização) */
+uint64_t barreira_chamadas(const Barreira *b);
+
+/* Conversão entre o tipo e o nome usado na linha de comando */
+const char *barreira_nome(TipoBarreira tipo);
+int barreira_tipo_de_nome(const char *nome, TipoBarreira *tipo);
+
+#endif /*__BARREIRA_H__*/
@@ -0,0 +1,56 @@
+#!/bin/sh
+#
+# Benchmark do rally: gera cenários com gera_cenario e roda rally_marciano
+# sem saída (-q) para cada combinação de tamanho, motor e número de
+# trabalhadores, imprimindo a vazão e o tempo de cada etapa do turno.
+#
+# Uso: ./bench.sh [diretório dos executáveis]
+#
+# As listas podem ser trocadas por variáveis de ambiente:
+#   TAMANHOS      "linhas x colunas : robôs", separados por espaço
+#   MOTORES       motores passados em -e (por padrão pool, plano, blocos e,
+#                 se rally_marciano foi compilado com OpenMP, omp)
+#   TRABALHADORES números de trabalhadores passados em -w
+#   TURNOS        turnos de cada cenário
+#   BARREIRA      barreira passada em -b
+
+BIN=${1:-.}
+TAMANHOS=${TAMANHOS:-"100x100:1000 500x500:20000 2000x2000:200000"}
+# O motor omp só existe nas versões compiladas com OpenMP (make OPENMP=1)
+if "$BIN/rally_marciano" -h 2>&1 | grep -q '|omp'; then
+    MOTORES=${MOTORES:-"pool plano blocos omp"}
+else
+    MOTORES=${MOTORES:-"pool plano blocos"}
+fi
+TRABALHADORES=${TRABALHADORES:-"1 2 4 $(getconf _NPROCESSORS_ONLN)"}
+TURNOS=${TURNOS:-200}
+BARREIRA=${BARREIRA:-central}
+
+CENARIO=$(mktemp)
+trap 'rm -f "$CENARIO"' EXIT
+
+printf "%-12s %9s %-7s %3s %12s %12s  %s\n" "arena" "robôs" "motor" "w" "turnos/s" "ns/robô-t" "tempo por etapa (ms, média por thread)"
+
+for tam in $TAMANHOS; do
+    dims=${tam%%:*}
+    robos=${tam##*:}
+    "$BIN/gera_cenario" -n "${dims%%x*}" -m "${dims##*x}" -r "$robos" \
+        -s "$TURNOS" -t "$TURNOS" -g 0.3 -S 42 > "$CENARIO" || exit 1
+
+    for motor in $MOTORES; do
+        # Repetir o mesmo número de trabalhadores não acrescenta nada
+        for w in $(echo $TRABALHADORES | tr ' ' '\n' | sort -nu); do
+            "$BIN/rally_marciano" -q -T -e "$motor" -w "$w" -b "$BARREIRA" < "$CENARIO" 2>&1 |
+            LC_ALL=C awk -v arena="$dims" -v robos="$robos" -v motor="$motor" -v w="$w" '
+                /^Vaz/ { turnos = $2; ns = $4 }
+                /^  / && !/^  etapa/ && !/^  total/ {
+                    # Nome da etapa (pode ter espaço) e depois "trabalho ms espera ms ..."
+                    n = split($0, f, " ms")
+                    nome = f[1]; sub(/^ +/, "", nome); sub(/ +[0-9.]+$/, "", nome); gsub(/ /, "_", nome)
+                    split(f[1], v, " "); trabalho = v[length(v)]
+                    fases = fases sprintf(" %s=%s", nome, trabalho)
+                }
+                END { printf "%-12s %8s %-7s %3s %12s %12s %s\n", arena, robos, motor, w, turnos, ns, fases }'
+        done
+    done
+done
@@ -0,0 +1,355 @@
+/*
+ * Checkpoint e retomada da simulação.
+ *
+ * O checkpoint é tirado no início do turno, no ponto em que só a thread
+ * que imprime o turno está rodando e as demais esperam na barreira. Essa
+ * thread chama fork(): o processo filho recebe uma cópia (copy-on-write)
+ * da arena e dos robôs naquele instante e grava o arquivo, enquanto o pai
+ * volta imediatamente para a simulação. O filho escreve num arquivo
+ * temporário e o renomeia no fim, então um arquivo de checkpoint nunca
+ * fica pela metade.
+ *
+ * Na retomada o arquivo é mapeado com mmap e copiado direto para a arena
+ * e para os robôs, sem passar pelo le_entrada().
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "rally.h"
+#include "checkpoint.h"
+
+_Static_assert(sizeof(int) == sizeof(int32_t), "o id dos ladrilhos é gravado como int32_t");
+
+#define ORDEM_BYTES 0x01020304u
+
+static char *arquivo_checkpoint;  // NULL se não houver checkpoint
+static char *arquivo_temporario;  // Onde o filho grava antes de renomear
+static int periodo_checkpoint;
+static pid_t gravador = -1;       // Processo filho gravando o último checkpoint
+
+/* Buffer de escrita do processo filho; cada processo tem sua cópia */
+static char buffer[1 << 16];
+static size_t usado;
+
+static int escreve_tudo(int fd, const void *p, size_t n)
+{
+    const char *c = (const char *) p;
+    while (n > 0) {
+        ssize_t w = write(fd, c, n);
+        if (w < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        c += w;
+        n -= (size_t) w;
+    }
+    return 0;
+}
+
+static int esvazia(int fd)
+{
+    int r = escreve_tudo(fd, buffer, usado);
+    usado = 0;
+    return r;
+}
+
+/* Acumula pedaços pequenos no buffer; os grandes vão direto para o arquivo */
+static int acumula(int fd, const void *p, size_t n)
+{
+    if (usado + n > sizeof(buffer) && esvazia(fd) < 0)
+        return -1;
+    if (n > sizeof(buffer))
+        return escreve_tudo(fd, p, n);
+    memcpy(buffer + usado, p, n);
+    usado += n;
+    return 0;
+}
+
+/* Grava o estado atual em fd. Só usa write(), pois roda no filho do fork() */
+static int grava_estado(int fd, int turno)
+{
+    CabecalhoCheckpoint cab;
+    memset(&cab, 0, sizeof(cab));
+    memcpy(cab.magica, CHECKPOINT_MAGICA, sizeof(cab.magica));
+    cab.versao = CHECKPOINT_VERSAO;
+    cab.ordem_bytes = ORDEM_BYTES;
+    cab.n_lins = sim->arena.n_lins;
+    cab.n_cols = sim->arena.n_cols;
+    cab.num_robos = sim->num_robos;
+    cab.num_total_turnos = sim->num_total_turnos;
+    cab.energia_bateria = sim->energia_bateria;
+    cab.turno = turno;
+    cab.lado_ladrilho = LADO_LADRILHO;
+    cab.num_ladrilhos = arena_alocados(&sim->arena);
+    for (int r = 0; r < sim->num_robos; r++)
+        cab.tam_sequencias += (uint64_t) sequencia_bytes(sim->robos.frio[r].sequencia_movimentos, SIZE_MAX,
+                                                         sim->robos.frio[r].tamanho_sequencia);
+
+    usado = 0;
+    if (acumula(fd, &cab, sizeof(cab)) < 0)
+        return -1;
+    for (size_t k = 0; k < cab.num_ladrilhos; k++) {
+        uint64_t posicao = arena_posicao_k(&sim->arena, k);
+        if (acumula(fd, &posicao, sizeof(posicao)) < 0 ||
+            acumula(fd, arena_ladrilho_k(&sim->arena, k), sizeof(Ladrilho)) < 0)
+            return -1;
+    }
+
+    for (int r = 0; r < sim->num_robos; r++) {
+        RoboCheckpoint rc = {
+            .i = sim->robos.i[r],
+            .j = sim->robos.j[r],
+            .energia = sim->robos.energia[r],
+            .figuras_coletadas = sim->robos.frio[r].figuras_coletadas,
+            .tamanho_sequencia = sim->robos.frio[r].tamanho_sequencia,
+            .id_movimento = robo_movimento(&sim->robos, r),
+            .move_i = sim->robos.move_i[r],
+            .move_j = sim->robos.move_j[r],
+        };
+        if (acumula(fd, &rc, sizeof(rc)) < 0)
+            return -1;
+    }
+    for (int r = 0; r < sim->num_robos; r++) {
+        long bytes = sequencia_bytes(sim->robos.frio[r].sequencia_movimentos, SIZE_MAX,
+                                     sim->robos.frio[r].tamanho_sequencia);
+        if (acumula(fd, sim->robos.frio[r].sequencia_movimentos, (size_t) bytes) < 0)
+            return -1;
+    }
+    return esvazia(fd);
+}
+
+void checkpoint_configura(const char *arquivo, int periodo)
+{
+    arquivo_checkpoint = strdup(arquivo);
+    arquivo_temporario = (char *) malloc(strlen(arquivo) + 5);
+    sprintf(arquivo_temporario, "%s.tmp", arquivo);
+    periodo_checkpoint = periodo > 0 ? periodo : 1;
+}
+
+int checkpoint_devido(int turno)
+{
+    return arquivo_checkpoint != NULL && turno > sim->turno_inicial &&
+           (turno - sim->turno_inicial) % periodo_checkpoint == 0;
+}
+
+/* Espera o filho que está gravando e avisa se a gravação falhou */
+static void espera_gravador()
+{
+    if (gravador < 0)
+        return;
+    int status;
+    while (waitpid(gravador, &status, 0) < 0 && errno == EINTR)
+        ;
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        fprintf(stderr, "Falha ao gravar o checkpoint em %s\n", arquivo_checkpoint);
+    gravador = -1;
+}
+
+void checkpoint_turno(int turno)
+{
+    if (!checkpoint_devido(turno))
+        return;
+
+    // Só um checkpoint é gravado por vez; normalmente o anterior já acabou
+    espera_gravador();
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        return;
+    }
+    if (pid == 0) {
+        int fd = open(arquivo_temporario, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0)
+            _exit(1);
+        int ok = grava_estado(fd, turno) == 0 && fsync(fd) == 0;
+        ok = close(fd) == 0 && ok;
+        if (!ok || rename(arquivo_temporario, arquivo_checkpoint) < 0)
+            _exit(1);
+        _exit(0);
+    }
+    gravador = pid;
+}
+
+void checkpoint_finaliza()
+{
+    espera_gravador();
+    free(arquivo_checkpoint);
+    free(arquivo_temporario);
+    arquivo_checkpoint = NULL;
+    arquivo_temporario = NULL;
+}
+
+/* Indica se as células do ladrilho têm só objetos conhecidos e IDs de robôs existentes */
+static int ladrilho_valido(const Ladrilho *l, int total)
+{
+    for (int k = 0; k < CELULAS_LADRILHO; k++) {
+        char obj = l->obj[k];
+        if (obj != VAZIO && obj != PILAR && obj != BATERIA && obj != FIGURA)
+            return 0;
+        if (l->id[k] < -1 || l->id[k] >= total)
+            return 0;
+    }
+    return 1;
+}
+
+/* Robôs presentes nas células do ladrilho */
+static long ocupantes(const Ladrilho *l)
+{
+    long n = 0;
+    for (int k = 0; k < CELULAS_LADRILHO; k++)
+        n += l->id[k] >= 0;
+    return n;
+}
+
+/*
+ * Indica se o estado do robô é possível: dentro da arena, na célula que
+ * tem o seu ID e com o destino pretendido na própria célula ou numa
+ * vizinha (os motores threads e pool guardam destinos fora da arena).
+ */
+static int robo_valido(const RoboCheckpoint *rc, int r)
+{
+    if (!eh_posicao_valida(rc->i, rc->j) || arena_id(celula(rc->i, rc->j)) != r)
+        return 0;
+    if (llabs(rc->move_i - rc->i) + llabs(rc->move_j - rc->j) > 1)
+        return 0;
+    return rc->energia >= 0 && rc->figuras_coletadas >= 0;
+}
+
+int checkpoint_restaura(const char *arquivo)
+{
+    int fd = open(arquivo, O_RDONLY);
+    if (fd < 0) {
+        perror(arquivo);
+        exit(1);
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        perror(arquivo);
+        exit(1);
+    }
+    size_t tam = (size_t) st.st_size;
+    if (tam < sizeof(CabecalhoCheckpoint)) {
+        fprintf(stderr, "%s: checkpoint truncado\n", arquivo);
+        exit(1);
+    }
+
+    const char *mapa = (const char *) mmap(NULL, tam, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapa == MAP_FAILED) {
+        perror("mmap");
+        exit(1);
+    }
+    close(fd);
+    madvise((void *) mapa, tam, MADV_SEQUENTIAL);
+
+    const CabecalhoCheckpoint *cab = (const CabecalhoCheckpoint *) mapa;
+    if (memcmp(cab->magica, CHECKPOINT_MAGICA, sizeof(cab->magica)) != 0 ||
+        cab->ordem_bytes != ORDEM_BYTES) {
+        fprintf(stderr, "%s: não é um checkpoint desta plataforma\n", arquivo);
+        exit(1);
+    }
+    if (cab->versao != CHECKPOINT_VERSAO) {
+        fprintf(stderr, "%s: versão %u do checkpoint não suportada\n", arquivo, cab->versao);
+        exit(1);
+    }
+
+    if (cab->lado_ladrilho != LADO_LADRILHO) {
+        fprintf(stderr, "%s: ladrilhos de lado %u, esperado %d\n", arquivo, cab->lado_ladrilho,
+                LADO_LADRILHO);
+        exit(1);
+    }
+    if (!arena_dimensoes_validas(cab->n_lins, cab->n_cols) || cab->num_robos < 0 ||
+        cab->num_total_turnos < 0 ||
+        cab->turno < 0 || cab->turno > cab->num_total_turnos) {
+        fprintf(stderr, "%s: cabeçalho do checkpoint inválido\n", arquivo);
+        exit(1);
+    }
+
+    // Cada seção é conferida contra o que resta do arquivo antes de calcular a posição da próxima
+    const size_t tam_ladrilho = sizeof(uint64_t) + sizeof(Ladrilho);
+    size_t pos_ladrilhos = sizeof(CabecalhoCheckpoint);
+    int ok = cab->num_ladrilhos <= (tam - pos_ladrilhos) / tam_ladrilho;
+    size_t pos_robos = ok ? pos_ladrilhos + (size_t) cab->num_ladrilhos * tam_ladrilho : tam;
+    ok = ok && (size_t) cab->num_robos <= (tam - pos_robos) / sizeof(RoboCheckpoint);
+    size_t pos_seq = ok ? pos_robos + (size_t) cab->num_robos * sizeof(RoboCheckpoint) : tam;
+    if (!ok || cab->tam_sequencias != tam - pos_seq) {
+        fprintf(stderr, "%s: tamanho do checkpoint inconsistente\n", arquivo);
+        exit(1);
+    }
+
+    sim->num_robos = cab->num_robos;
+    sim->num_total_turnos = cab->num_total_turnos;
+    sim->energia_bateria = cab->energia_bateria;
+
+    cria_arena(&sim->arena, cab->n_lins, cab->n_cols);
+    long ocupadas = 0;
+    for (uint64_t k = 0; k < cab->num_ladrilhos; k++) {
+        const char *p = mapa + pos_ladrilhos + k * tam_ladrilho;
+        uint64_t posicao;
+        memcpy(&posicao, p, sizeof(posicao));
+        if (posicao >= sim->arena.num_ladrilhos ||
+            ladrilho_alocado_em(&sim->arena, posicao << (2 * BITS_LADRILHO))) {
+            fprintf(stderr, "%s: ladrilho fora da arena ou repetido\n", arquivo);
+            exit(1);
+        }
+        Ladrilho *l = aloca_ladrilho(posicao);
+        memcpy(l, p + sizeof(posicao), sizeof(Ladrilho));
+        if (!ladrilho_valido(l, sim->num_robos)) {
+            fprintf(stderr, "%s: conteúdo inválido no ladrilho %llu\n", arquivo,
+                    (unsigned long long) posicao);
+            exit(1);
+        }
+        ocupadas += ocupantes(l);
+    }
+
+    cria_robos(&sim->robos, sim->num_robos);
+    const RoboCheckpoint *rc = (const RoboCheckpoint *) (mapa + pos_robos);
+    const unsigned char *seq = (const unsigned char *) (mapa + pos_seq);
+    uint64_t restante = cab->tam_sequencias;
+    // Com cada robô na célula do seu ID, nenhuma outra célula pode ter robô
+    if (ocupadas != sim->num_robos) {
+        fprintf(stderr, "%s: a arena tem %ld robôs, esperado %d\n", arquivo, ocupadas, sim->num_robos);
+        exit(1);
+    }
+    for (int r = 0; r < sim->num_robos; r++) {
+        if (!robo_valido(&rc[r], r)) {
+            fprintf(stderr, "%s: estado inválido do robô %d\n", arquivo, r);
+            exit(1);
+        }
+        RoboFrio *frio = &sim->robos.frio[r];
+        frio->id = r;
+        sim->robos.i[r] = rc[r].i;
+        sim->robos.j[r] = rc[r].j;
+        sim->robos.energia[r] = rc[r].energia;
+        frio->figuras_coletadas = rc[r].figuras_coletadas;
+        sim->robos.move_i[r] = rc[r].move_i;
+        sim->robos.move_j[r] = rc[r].move_j;
+
+        int n_mov = rc[r].tamanho_sequencia;
+        long bytes = n_mov < 0 ? -1 : sequencia_bytes(seq, restante, n_mov);
+        if (bytes < 0 || rc[r].id_movimento < 0 || rc[r].id_movimento > n_mov) {
+            fprintf(stderr, "%s: sequência de movimentos inconsistente\n", arquivo);
+            exit(1);
+        }
+        frio->tamanho_sequencia = n_mov;
+        frio->sequencia_movimentos = (unsigned char *) calloc(bytes + SEQUENCIA_FOLGA, 1);
+        memcpy(frio->sequencia_movimentos, seq, bytes);
+        // O cursor volta para o movimento em que o robô parou
+        robo_posiciona_sequencia(&sim->robos, r, rc[r].id_movimento);
+        seq += bytes;
+        restante -= (uint64_t) bytes;
+    }
+
+    int turno = cab->turno;
+    munmap((void *) mapa, tam);
+    return turno;
+}
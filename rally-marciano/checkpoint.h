@@ -0,0 +1,75 @@
+#ifndef __CHECKPOINT_H__
+#define __CHECKPOINT_H__
+
+#include <stdint.h>
+
+/* Identificação e versão do formato binário do checkpoint */
+#define CHECKPOINT_MAGICA "RALLYCKP"
+#define CHECKPOINT_VERSAO 4
+
+/* Intervalo padrão, em turnos, entre dois checkpoints */
+#define PERIODO_CHECKPOINT 1000
+
+/*
+ * Cabeçalho do arquivo de checkpoint. Depois dele vêm, nesta ordem:
+ * - os num_ladrilhos ladrilhos alocados da arena, cada um com a sua
+ *   posição no diretório (64 bits) seguida do Ladrilho (rally.h); os
+ *   ladrilhos que não estão no arquivo estão vazios;
+ * - um RoboCheckpoint por robô;
+ * - as sequências de movimentos compactadas (sequencia.h) de todos os
+ *   robôs, concatenadas.
+ */
+typedef struct {
+    char magica[8];
+    uint32_t versao;
+    uint32_t ordem_bytes;      // 0x01020304 na ordem de bytes de quem escreveu
+    int64_t n_lins;
+    int64_t n_cols;
+    int32_t num_robos;
+    int32_t num_total_turnos;
+    int32_t energia_bateria;
+    int32_t turno;             // Turno que começa no estado salvo
+    uint64_t tam_sequencias;   // Total de bytes das sequências compactadas
+    uint32_t lado_ladrilho;    // LADO_LADRILHO de quem escreveu
+    uint32_t reservado;
+    uint64_t num_ladrilhos;    // Ladrilhos gravados
+} CabecalhoCheckpoint;
+
+/* Estado de um robô no checkpoint */
+typedef struct {
+    int64_t i;
+    int64_t j;
+    int64_t move_i;   // Último destino pretendido; os motores threads e pool
+    int64_t move_j;   // o consultam para saber se o ocupante de uma célula saiu
+    int32_t energia;
+    int32_t figuras_coletadas;
+    int32_t tamanho_sequencia;
+    int32_t id_movimento;
+} RoboCheckpoint;
+
+/*
+ * Salva um checkpoint em 'arquivo' a cada 'periodo' turnos. Sem chamar
+ * esta função nenhum checkpoint é gravado.
+ */
+void checkpoint_configura(const char *arquivo, int periodo);
+
+/* Indica se um checkpoint será tirado no início do turno */
+int checkpoint_devido(int turno);
+
+/*
+ * Chamada no início de cada turno, com as demais threads paradas na
+ * barreira. Se houver checkpoint no turno, cria um processo filho com
+ * fork(), que grava o arquivo enquanto a simulação continua.
+ */
+void checkpoint_turno(int turno);
+
+/* Espera a gravação do último checkpoint terminar */
+void checkpoint_finaliza();
+
+/*
+ * Carrega a arena, os robôs e os parâmetros da simulação de um checkpoint,
+ * no lugar de le_entrada(). Retorna o turno em que a simulação continua.
+ */
+int checkpoint_restaura(const char *arquivo);
+
+#endif /*__CHECKPOINT_H__*/
@@ -0,0 +1,37 @@
+#!/bin/sh
+#
+# Compara duas versões do rally: roda bench.sh com os executáveis de cada
+# diretório, nos mesmos cenários, e imprime lado a lado os turnos/s de
+# cada combinação de arena, motor e trabalhadores, com a razão
+# depois/antes (acima de 1, a versão nova é mais rápida).
+#
+# Uso: ./compara.sh diretório_antes [diretório_depois]
+#
+# Cada diretório precisa ter rally_marciano e gera_cenario. As variáveis
+# de bench.sh valem aqui; por padrão os trabalhadores vão até 64, onde o
+# compartilhamento falso entre threads aparece.
+
+ANTES=${1:?"uso: $0 diretório_antes [diretório_depois]"}
+DEPOIS=${2:-.}
+DIR=$(dirname "$0")
+export TAMANHOS MOTORES TURNOS BARREIRA
+export TRABALHADORES=${TRABALHADORES:-"1 8 64"}
+
+SAIDA_ANTES=$(mktemp)
+SAIDA_DEPOIS=$(mktemp)
+trap 'rm -f "$SAIDA_ANTES" "$SAIDA_DEPOIS"' EXIT
+
+"$DIR/bench.sh" "$ANTES" > "$SAIDA_ANTES" || exit 1
+"$DIR/bench.sh" "$DEPOIS" > "$SAIDA_DEPOIS" || exit 1
+
+printf "%-12s %9s %-7s %3s %12s %12s %7s\n" "arena" "robôs" "motor" "w" "antes" "depois" "razão"
+LC_ALL=C awk '
+    FNR == 1 { next }  # Cabeçalho de bench.sh
+    NR == FNR { antes[$1 " " $2 " " $3 " " $4] = $5; next }
+    {
+        chave = $1 " " $2 " " $3 " " $4
+        if (!(chave in antes))
+            next
+        razao = antes[chave] > 0 ? sprintf("%.2f", $5 / antes[chave]) : "-"
+        printf "%-12s %8s %-7s %3s %12s %12s %7s\n", $1, $2, $3, $4, antes[chave], $5, razao
+    }' "$SAIDA_ANTES" "$SAIDA_DEPOIS"
@@ -0,0 +1,262 @@
+/*
+ * Decodificador do registro binário de eventos do Rally dos Robôs em Marte.
+ *
+ * Lê o arquivo gravado por rally_marciano -E, parte do estado inicial e
+ * aplica os eventos turno a turno. Com -t imprime o quadro do início de
+ * um turno, com -a os quadros de todos os turnos, no mesmo formato da
+ * saída de rally_marciano; com -l lista os eventos com a energia de cada
+ * robô depois deles.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+
+#include "eventos.h"
+
+#define VAZIO '.'
+#define BATERIA 'b'
+#define FIGURA 'f'
+
+static const int di[] = {-1, 1, 0, 0};
+static const int dj[] = { 0, 0, 1, -1};
+static const char *nome_direcao[] = {"N", "S", "L", "O"};
+
+/* Estado da arena e dos robôs */
+static CabecalhoEventos cab;
+static char *obj;
+static int *id;
+static int *energia;
+
+static Evento *eventos;
+static size_t cap_eventos;
+
+static void uso(const char *prog)
+{
+    fprintf(stderr, "Uso: %s [opções] eventos.bin\n", prog);
+    fprintf(stderr, "  -t  imprime o quadro do início do turno (padrão: o último)\n");
+    fprintf(stderr, "  -a  imprime os quadros de todos os turnos\n");
+    fprintf(stderr, "  -l  lista os eventos de cada turno\n");
+}
+
+static void le(void *p, size_t tam, size_t n, FILE *f, const char *arquivo)
+{
+    if (fread(p, tam, n, f) != n) {
+        fprintf(stderr, "%s: arquivo truncado\n", arquivo);
+        exit(1);
+    }
+}
+
+static void imprime_quadro(int turno)
+{
+    printf("Turno %d:\n", turno);
+    for (int64_t i = 0; i < cab.n_lins; i++) {
+        size_t base = (size_t) i * cab.n_cols;
+        for (int64_t j = 0; j < cab.n_cols; j++) {
+            size_t c = base + j;
+            if (id[c] == -1)
+                printf(" %c  ", obj[c]);
+            else
+                printf("(%d) ", id[c]);
+        }
+        putchar('\n');
+    }
+}
+
+static size_t destino_de(const Evento *e)
+{
+    int64_t i = (int64_t) (e->origem / (uint64_t) cab.n_cols) + di[e->direcao];
+    int64_t j = (int64_t) (e->origem % (uint64_t) cab.n_cols) + dj[e->direcao];
+    return (size_t) i * cab.n_cols + j;
+}
+
+/* Copia para obj e id as células dentro da arena de cada ladrilho gravado */
+static void le_ladrilhos(FILE *f, const char *arquivo)
+{
+    size_t lado = cab.lado_ladrilho;
+    size_t por_linha = ((size_t) cab.n_cols + lado - 1) / lado;
+    size_t faixas = ((size_t) cab.n_lins + lado - 1) / lado;
+    int *id_ladrilho = (int *) malloc(sizeof(int) * lado * lado);
+    char *obj_ladrilho = (char *) malloc(lado * lado);
+
+    for (uint64_t k = 0; k < cab.num_ladrilhos; k++) {
+        uint64_t posicao;
+        le(&posicao, sizeof(posicao), 1, f, arquivo);
+        le(id_ladrilho, sizeof(int), lado * lado, f, arquivo);
+        le(obj_ladrilho, 1, lado * lado, f, arquivo);
+        if (posicao >= faixas * por_linha) {
+            fprintf(stderr, "%s: ladrilho fora da arena\n", arquivo);
+            exit(1);
+        }
+        size_t i0 = posicao / por_linha * lado;
+        size_t j0 = posicao % por_linha * lado;
+        for (size_t a = 0; a < lado && i0 + a < (size_t) cab.n_lins; a++)
+            for (size_t b = 0; b < lado && j0 + b < (size_t) cab.n_cols; b++) {
+                size_t c = (i0 + a) * cab.n_cols + j0 + b;
+                obj[c] = obj_ladrilho[a * lado + b];
+                id[c] = id_ladrilho[a * lado + b];
+            }
+    }
+    free(id_ladrilho);
+    free(obj_ladrilho);
+}
+
+/* Confere um evento antes de aplicá-lo, para não escrever fora dos vetores */
+static int evento_valido(const Evento *e)
+{
+    if (e->robo < 0 || e->robo >= cab.num_robos)
+        return 0;
+    if (e->tipo == EVENTO_ROUBO)
+        return e->origem < (uint64_t) cab.num_robos;
+    if (e->tipo != EVENTO_MOVIMENTO || e->direcao > 3)
+        return 0;
+    uint64_t num_celulas = (uint64_t) cab.n_lins * cab.n_cols;
+    if (e->origem >= num_celulas)
+        return 0;
+    int64_t i = (int64_t) (e->origem / (uint64_t) cab.n_cols) + di[e->direcao];
+    int64_t j = (int64_t) (e->origem % (uint64_t) cab.n_cols) + dj[e->direcao];
+    return i >= 0 && i < cab.n_lins && j >= 0 && j < cab.n_cols;
+}
+
+/*
+ * Aplica os n eventos de um turno. Todas as saídas vêm antes das chegadas,
+ * porque numa troca ou numa cadeia de robôs a célula de origem de um é o
+ * destino de outro.
+ */
+static void aplica_turno(int turno, size_t n, int lista)
+{
+    for (size_t k = 0; k < n; k++)
+        if (eventos[k].tipo == EVENTO_MOVIMENTO)
+            id[eventos[k].origem] = -1;
+
+    for (size_t k = 0; k < n; k++) {
+        const Evento *e = &eventos[k];
+        if (e->tipo == EVENTO_MOVIMENTO) {
+            size_t destino = destino_de(e);
+            id[destino] = e->robo;
+            obj[destino] = VAZIO;
+            energia[e->robo] += e->objeto == BATERIA ? cab.energia_bateria - 1 : -1;
+            if (lista)
+                printf("%d %d movimento %s %llu %llu -> %zu %zu%s energia %d\n", turno, e->robo,
+                       nome_direcao[e->direcao],
+                       (unsigned long long) (e->origem / (uint64_t) cab.n_cols),
+                       (unsigned long long) (e->origem % (uint64_t) cab.n_cols), destino / cab.n_cols,
+                       destino % cab.n_cols,
+                       e->objeto == BATERIA ? " bateria" : e->objeto == FIGURA ? " figura" : "",
+                       energia[e->robo]);
+        } else {
+            energia[e->robo]++;
+            energia[e->origem]--;
+            if (lista)
+                printf("%d %d roubo de %d energia %d (%d: %d)\n", turno, e->robo, (int) e->origem,
+                       energia[e->robo], (int) e->origem, energia[e->origem]);
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    int turno_pedido = -1;
+    int todos = 0, lista = 0;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "t:alh")) != -1) {
+        switch (opt) {
+            case 't': turno_pedido = atoi(optarg); break;
+            case 'a': todos = 1; break;
+            case 'l': lista = 1; break;
+            default:
+                uso(argv[0]);
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (optind != argc - 1) {
+        uso(argv[0]);
+        return 1;
+    }
+    const char *arquivo = argv[optind];
+    FILE *f = fopen(arquivo, "rb");
+    if (!f) {
+        perror(arquivo);
+        return 1;
+    }
+
+    le(&cab, sizeof(cab), 1, f, arquivo);
+    if (memcmp(cab.magica, EVENTOS_MAGICA, sizeof(cab.magica)) != 0) {
+        fprintf(stderr, "%s: não é um registro de eventos\n", arquivo);
+        return 1;
+    }
+    if (cab.ordem_bytes != 0x01020304u) {
+        fprintf(stderr, "%s: gravado numa máquina com outra ordem de bytes\n", arquivo);
+        return 1;
+    }
+    if (cab.versao != EVENTOS_VERSAO) {
+        fprintf(stderr, "%s: versão %u do formato, esperada %d\n", arquivo, cab.versao,
+                EVENTOS_VERSAO);
+        return 1;
+    }
+    if (cab.n_lins < 1 || cab.n_cols < 1 || cab.num_robos < 0 || cab.lado_ladrilho < 1 ||
+        cab.turno_inicial < 0 || cab.turno_inicial > cab.num_total_turnos) {
+        fprintf(stderr, "%s: cabeçalho inválido\n", arquivo);
+        return 1;
+    }
+    // Só com -l, sem -t nem -a, lista os eventos sem imprimir quadros
+    int quadros = todos || turno_pedido >= 0 || !lista;
+    if (turno_pedido < 0)
+        turno_pedido = cab.num_total_turnos;
+    if (turno_pedido < cab.turno_inicial || turno_pedido > cab.num_total_turnos) {
+        fprintf(stderr, "Turno %d fora do registro (%d a %d)\n", turno_pedido,
+                cab.turno_inicial, cab.num_total_turnos);
+        return 1;
+    }
+
+    size_t num_celulas = (size_t) cab.n_lins * cab.n_cols;
+    obj = (char *) malloc(num_celulas);
+    id = (int *) malloc(sizeof(int) * num_celulas);
+    energia = (int *) malloc(sizeof(int) * (cab.num_robos > 0 ? cab.num_robos : 1));
+    memset(obj, VAZIO, num_celulas);
+    memset(id, 0xff, sizeof(int) * num_celulas);
+    le_ladrilhos(f, arquivo);
+    le(energia, sizeof(int), cab.num_robos, f, arquivo);
+
+    // Quadro a imprimir: o do início do turno, antes dos eventos dele
+    int ultimo = todos || !quadros ? cab.num_total_turnos : turno_pedido;
+    int turno = cab.turno_inicial;
+    CabecalhoTurno ct;
+    int tem_turno = fread(&ct, sizeof(ct), 1, f) == 1;
+    for (;; turno++) {
+        if (quadros && (todos || turno == turno_pedido))
+            imprime_quadro(turno);
+        if (turno == ultimo)
+            break;
+        if (tem_turno && ct.turno < turno) {
+            fprintf(stderr, "%s: turno %d fora de ordem\n", arquivo, ct.turno);
+            return 1;
+        }
+        if (!tem_turno || ct.turno != turno)
+            continue;
+
+        if (ct.num_eventos > cap_eventos) {
+            cap_eventos = ct.num_eventos;
+            eventos = (Evento *) realloc(eventos, cap_eventos * sizeof(Evento));
+        }
+        le(eventos, sizeof(Evento), ct.num_eventos, f, arquivo);
+        for (size_t k = 0; k < ct.num_eventos; k++)
+            if (!evento_valido(&eventos[k])) {
+                fprintf(stderr, "%s: evento inválido no turno %d\n", arquivo, turno);
+                return 1;
+            }
+        aplica_turno(turno, ct.num_eventos, lista);
+        tem_turno = fread(&ct, sizeof(ct), 1, f) == 1;
+    }
+
+    free(eventos);
+    free(energia);
+    free(id);
+    free(obj);
+    fclose(f);
+    return 0;
+}
@@ -0,0 +1,66 @@
+#!/bin/sh
+#
+# Teste diferencial: gera cenários com gera_cenario e roda cada motor
+# determinístico com -D, que compara o estado no início de cada turno com
+# o do motor sequencial de referência e para na primeira divergência.
+#
+# Uso: ./diferencial.sh [diretório dos executáveis]
+#
+# As listas podem ser trocadas por variáveis de ambiente:
+#   CENARIOS      "linhas x colunas : robôs : agrupamento", separados por espaço
+#   SEMENTES      sementes de cada cenário
+#   MOTORES       motores passados em -e (plano, blocos e, se compilado com
+#                 OpenMP, omp)
+#   TRABALHADORES números de trabalhadores passados em -w
+#   AVULSOS       pares "motor:trabalhadores" rodados além das combinações
+#                 acima; por padrão pool:1, pois o pool só é determinístico
+#                 com um trabalhador
+#   TURNOS        turnos de cada cenário
+
+BIN=${1:-.}
+CENARIOS=${CENARIOS:-"5x5:3:0 20x20:60:0 20x20:200:1 64x48:1500:0.5 200x200:8000:0.8"}
+SEMENTES=${SEMENTES:-"1 2 3"}
+if "$BIN/rally_marciano" -h 2>&1 | grep -q '|omp'; then
+    MOTORES=${MOTORES:-"plano blocos omp"}
+else
+    MOTORES=${MOTORES:-"plano blocos"}
+fi
+TRABALHADORES=${TRABALHADORES:-"1 2 3 8"}
+AVULSOS=${AVULSOS:-"pool:1"}
+TURNOS=${TURNOS:-60}
+
+CENARIO=$(mktemp)
+trap 'rm -f "$CENARIO"' EXIT
+
+falhas=0
+execucoes=0
+for cen in $CENARIOS; do
+    dims=${cen%%:*}
+    resto=${cen#*:}
+    robos=${resto%%:*}
+    grupo=${resto#*:}
+    for semente in $SEMENTES; do
+        # Energia baixa para que haja bastante roubo de energia
+        "$BIN/gera_cenario" -n "${dims%%x*}" -m "${dims##*x}" -r "$robos" -g "$grupo" \
+            -p 3 -s "$TURNOS" -t "$TURNOS" -S "$semente" > "$CENARIO" || exit 1
+        combinacoes=$AVULSOS
+        for motor in $MOTORES; do
+            for w in $TRABALHADORES; do
+                combinacoes="$combinacoes $motor:$w"
+            done
+        done
+        for comb in $combinacoes; do
+            motor=${comb%%:*}
+            w=${comb#*:}
+            execucoes=$((execucoes + 1))
+            if ! saida=$("$BIN/rally_marciano" -q -D -e "$motor" -w "$w" < "$CENARIO" 2>&1); then
+                falhas=$((falhas + 1))
+                echo "FALHA: $dims, $robos robôs, agrupamento $grupo, semente $semente, -e $motor -w $w"
+                echo "$saida" | sed 's/^/    /'
+            fi
+        done
+    done
+done
+
+echo "$execucoes execuções, $falhas divergências"
+[ "$falhas" -eq 0 ]
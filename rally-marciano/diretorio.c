@@ -0,0 +1,233 @@
+/*
+ * Diretório esparso de blocos por posição de ladrilho (diretorio.h).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <sys/mman.h>
+
+#include "diretorio.h"
+
+/* Região anônima: as páginas só existem depois de escritas */
+static char *mapeia_segmento(const Diretorio *d, int s)
+{
+    size_t tam = diretorio_capacidade(s) * (d->tam_bloco + sizeof(size_t));
+    void *regiao = mmap(NULL, tam, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (regiao == MAP_FAILED) {
+        perror("mmap");
+        exit(1);
+    }
+#ifdef MADV_HUGEPAGE
+    // Os blocos de um segmento são usados em ordem: páginas grandes reduzem as falhas de TLB
+    madvise(regiao, tam, MADV_HUGEPAGE);
+#endif
+    return (char *) regiao;
+}
+
+static void desmapeia_segmento(const Diretorio *d, int s, char *segmento)
+{
+    munmap(segmento, diretorio_capacidade(s) * (d->tam_bloco + sizeof(size_t)));
+}
+
+/* Segmentos com algum bloco alocado */
+static int segmentos_usados(const Diretorio *d)
+{
+    size_t alocados = diretorio_alocados(d);
+    if (alocados == 0)
+        return 0;
+    size_t desloc;
+    return diretorio_segmento(alocados - 1, &desloc) + 1;
+}
+
+/* Grupo com todas as posições no bloco vazio */
+static void *_Atomic *novo_grupo(const Diretorio *d)
+{
+    void *_Atomic *grupo = (void *_Atomic *) malloc(LADRILHOS_GRUPO * sizeof(*grupo));
+    for (int k = 0; k < LADRILHOS_GRUPO; k++)
+        atomic_init(&grupo[k], d->vazio);
+    return grupo;
+}
+
+void diretorio_cria(Diretorio *d, size_t num_posicoes, size_t tam_bloco,
+                    void (*inicia)(void *bloco))
+{
+    d->tam_bloco = tam_bloco;
+    d->inicia = inicia;
+
+    // O bloco vazio e o em_criacao, um depois do outro; ninguém escreve neles depois daqui
+    d->vazio = aligned_alloc(64, 2 * tam_bloco);
+    d->em_criacao = (char *) d->vazio + tam_bloco;
+    if (inicia) {
+        inicia(d->vazio);
+        inicia(d->em_criacao);
+    } else {
+        memset(d->vazio, 0, 2 * tam_bloco);
+    }
+
+    d->num_grupos = (num_posicoes + LADRILHOS_GRUPO - 1) >> BITS_GRUPO;
+    if (d->num_grupos == 0)
+        d->num_grupos = 1;
+    d->grupo_vazio = novo_grupo(d);
+    d->grupos = (void *_Atomic *_Atomic *) malloc(sizeof(*d->grupos) * d->num_grupos);
+    for (size_t g = 0; g < d->num_grupos; g++)
+        atomic_init(&d->grupos[g], d->grupo_vazio);
+    for (int s = 0; s < MAX_SEGMENTOS; s++)
+        atomic_init(&d->segmentos[s], NULL);
+    atomic_init(&d->num_alocados, 0);
+    d->base = NULL;
+}
+
+void diretorio_destroi(Diretorio *d)
+{
+    for (size_t g = 0; g < d->num_grupos; g++) {
+        void *_Atomic *grupo = atomic_load_explicit(&d->grupos[g], memory_order_relaxed);
+        if (grupo != d->grupo_vazio)
+            free((void *) grupo);
+    }
+    free((void *) d->grupos);
+    free((void *) d->grupo_vazio);
+    free(d->vazio);
+    for (int s = 0; s < MAX_SEGMENTOS; s++) {
+        char *segmento = atomic_load_explicit(&d->segmentos[s], memory_order_relaxed);
+        if (segmento)
+            desmapeia_segmento(d, s, segmento);
+    }
+    memset(d, 0, sizeof(*d));
+}
+
+/* Grupo g para escrita: põe um grupo próprio no lugar do vazio compartilhado, se preciso */
+static void *_Atomic *grupo_escrita(Diretorio *d, size_t g)
+{
+    void *_Atomic *grupo = atomic_load_explicit(&d->grupos[g], memory_order_acquire);
+    if (grupo != d->grupo_vazio)
+        return grupo;
+    void *_Atomic *novo = novo_grupo(d);
+    if (atomic_compare_exchange_strong_explicit(&d->grupos[g], &grupo, novo,
+                                                memory_order_acq_rel, memory_order_acquire))
+        return novo;
+    free((void *) novo);
+    return grupo;
+}
+
+/* Segmento s, mapeado por quem aloca o primeiro bloco que cai nele */
+static char *segmento_escrita(Diretorio *d, int s)
+{
+    char *segmento = atomic_load_explicit(&d->segmentos[s], memory_order_acquire);
+    if (segmento)
+        return segmento;
+    char *novo = mapeia_segmento(d, s);
+    if (atomic_compare_exchange_strong_explicit(&d->segmentos[s], &segmento, novo,
+                                                memory_order_acq_rel, memory_order_acquire))
+        return novo;
+    desmapeia_segmento(d, s, novo);
+    return segmento;
+}
+
+/* Vetor das posições dos blocos do segmento s, logo depois deles */
+static size_t *posicoes_segmento(const Diretorio *d, int s, char *segmento)
+{
+    return (size_t *) (segmento + diretorio_capacidade(s) * d->tam_bloco);
+}
+
+void diretorio_cria_copia(Diretorio *d, size_t num_posicoes, const Diretorio *base)
+{
+    diretorio_cria(d, num_posicoes, base->tam_bloco, base->inicia);
+    d->base = base;
+
+    // Cada bloco de base fica com o mesmo índice k; o lugar dele na reserva fica livre até a cópia
+    size_t alocados = diretorio_alocados(base);
+    for (size_t k = 0; k < alocados; k++) {
+        size_t desloc;
+        int s = diretorio_segmento(k, &desloc);
+        size_t posicao = diretorio_posicao_k(base, k);
+        posicoes_segmento(d, s, segmento_escrita(d, s))[desloc] = posicao;
+        void *_Atomic *grupo = grupo_escrita(d, posicao >> BITS_GRUPO);
+        atomic_store_explicit(&grupo[posicao & (LADRILHOS_GRUPO - 1)], diretorio_reserva_k(base, k),
+                              memory_order_relaxed);
+    }
+    atomic_store_explicit(&d->num_alocados, alocados, memory_order_release);
+}
+
+/* Índice k de um bloco da reserva de base */
+static size_t indice_base(const Diretorio *base, const char *b)
+{
+    for (int s = 0;; s++) {
+        const char *segmento = atomic_load_explicit(&base->segmentos[s], memory_order_relaxed);
+        if (b >= segmento && b < segmento + diretorio_capacidade(s) * base->tam_bloco)
+            return diretorio_capacidade(s) - BLOCOS_SEGMENTO + (size_t) (b - segmento) / base->tam_bloco;
+    }
+}
+
+void *diretorio_aloca(Diretorio *d, size_t posicao)
+{
+    void *_Atomic *grupo = grupo_escrita(d, posicao >> BITS_GRUPO);
+    void *_Atomic *entrada = &grupo[posicao & (LADRILHOS_GRUPO - 1)];
+    void *atual = atomic_load_explicit(entrada, memory_order_acquire);
+    for (;;) {
+        if (atual == d->em_criacao) {
+            sched_yield();
+            atual = atomic_load_explicit(entrada, memory_order_acquire);
+            continue;
+        }
+        if (diretorio_proprio(d, posicao, atual))
+            return atual;
+        void *anterior = atual;
+        if (!atomic_compare_exchange_strong_explicit(entrada, &atual, d->em_criacao,
+                                                     memory_order_acquire, memory_order_acquire))
+            continue;
+
+        // Cada posição passa por aqui uma única vez; um bloco compartilhado volta ao seu índice k
+        size_t k, desloc;
+        if (anterior == d->vazio)
+            k = atomic_fetch_add_explicit(&d->num_alocados, 1, memory_order_relaxed);
+        else
+            k = indice_base(d->base, (const char *) anterior);
+        int s = diretorio_segmento(k, &desloc);
+        char *segmento = segmento_escrita(d, s);
+        void *b = segmento + desloc * d->tam_bloco;
+        if (anterior != d->vazio)
+            memcpy(b, anterior, d->tam_bloco);
+        else if (d->inicia)
+            d->inicia(b);
+        posicoes_segmento(d, s, segmento)[desloc] = posicao;
+        atomic_store_explicit(entrada, b, memory_order_release);
+        return b;
+    }
+}
+
+void diretorio_nova_reserva(const Diretorio *d, char **segmentos)
+{
+    int usados = segmentos_usados(d);
+    for (int s = 0; s < MAX_SEGMENTOS; s++)
+        segmentos[s] = s < usados ? mapeia_segmento(d, s) : NULL;
+}
+
+void diretorio_troca_reserva(Diretorio *d, char **segmentos, const size_t *ordem)
+{
+    size_t alocados = diretorio_alocados(d);
+    int usados = segmentos_usados(d);
+
+    // As posições novas saem da reserva atual, que ainda não foi devolvida
+    for (size_t k = 0; k < alocados; k++) {
+        size_t desloc;
+        int s = diretorio_segmento(k, &desloc);
+        size_t posicao = diretorio_posicao_k(d, ordem[k]);
+        posicoes_segmento(d, s, segmentos[s])[desloc] = posicao;
+    }
+    for (int s = 0; s < usados; s++) {
+        desmapeia_segmento(d, s, atomic_load_explicit(&d->segmentos[s], memory_order_relaxed));
+        atomic_store_explicit(&d->segmentos[s], segmentos[s], memory_order_relaxed);
+    }
+
+    // O diretório passa a apontar para as cópias
+    for (size_t k = 0; k < alocados; k++) {
+        size_t posicao = diretorio_posicao_k(d, k);
+        void *_Atomic *grupo = atomic_load_explicit(&d->grupos[posicao >> BITS_GRUPO],
+                                                    memory_order_relaxed);
+        atomic_store_explicit(&grupo[posicao & (LADRILHOS_GRUPO - 1)], diretorio_reserva_k(d, k),
+                              memory_order_relaxed);
+    }
+}
@@ -0,0 +1,170 @@
+#ifndef __DIRETORIO_H__
+#define __DIRETORIO_H__
+
+/*
+ * Diretório esparso de blocos de tamanho fixo, um por posição de
+ * ladrilho da arena (rally.h). Guarda os ladrilhos da arena, os mapas de
+ * bits (mapa_bits.h) e as reivindicações dos motores de plano.
+ *
+ * O diretório tem dois níveis: um vetor com um grupo por
+ * LADRILHOS_GRUPO posições seguidas e, em cada grupo, o bloco de cada
+ * posição, ou NULL. Um grupo só é alocado quando recebe o primeiro
+ * bloco; até lá o vetor aponta para um grupo vazio compartilhado. As
+ * posições sem bloco apontam para um bloco vazio do próprio diretório,
+ * então a leitura não testa o grupo nem o bloco. Numa arena de
+ * 10^6 x 10^6 células, o vetor de grupos ocupa menos de 0,5 MB.
+ *
+ * Os blocos saem, na ordem da primeira escrita, de uma reserva em
+ * segmentos: o segmento s tem BLOCOS_SEGMENTO << s blocos e só é
+ * mapeado quando o primeiro bloco dele é alocado. Assim a reserva nunca
+ * passa do dobro dos blocos escritos (ou de um segmento inicial). O
+ * k-ésimo bloco alocado e a sua posição são diretorio_bloco_k e
+ * diretorio_posicao_k.
+ *
+ * Duas threads podem escrever ao mesmo tempo em posições de um bloco que
+ * ainda não existe. A primeira a trocar o bloco vazio por em_criacao no
+ * grupo aloca e inicia o bloco; as outras esperam ele ser publicado,
+ * inclusive as que o encontram já trocado (diretorio_escrita). Quem só
+ * lê vê em_criacao, que também é um bloco vazio.
+ *
+ * Uma cópia (diretorio_cria_copia) começa apontando para os blocos de
+ * outro diretório, a base, que não muda enquanto a cópia existe: os
+ * blocos só são copiados para a reserva da cópia na primeira escrita, e
+ * os que nunca são escritos ficam compartilhados entre todas as cópias.
+ */
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Posições de cada grupo do diretório (2^BITS_GRUPO) */
+#define BITS_GRUPO 12
+#define LADRILHOS_GRUPO (1 << BITS_GRUPO)
+
+/* Blocos do primeiro segmento da reserva (2^BITS_SEGMENTO); cada segmento dobra */
+#define BITS_SEGMENTO 6
+#define BLOCOS_SEGMENTO (1 << BITS_SEGMENTO)
+
+/* Segmentos da reserva: BLOCOS_SEGMENTO << MAX_SEGMENTOS blocos, mais que qualquer arena */
+#define MAX_SEGMENTOS 48
+
+typedef struct Diretorio {
+    void *_Atomic *_Atomic *grupos;  // Grupo de cada LADRILHOS_GRUPO posições
+    void *_Atomic *grupo_vazio;  // Grupo sem nenhum bloco, compartilhado pelos não alocados
+    size_t num_grupos;
+    size_t tam_bloco;   // Bytes de cada bloco (múltiplo de 64)
+    void *vazio;        // Bloco vazio, visto nas posições sem bloco
+    void *em_criacao;   // Bloco vazio visto no grupo enquanto um bloco é iniciado
+    void (*inicia)(void *bloco);  // Conteúdo inicial de um bloco, ou NULL para zeros
+    char *_Atomic segmentos[MAX_SEGMENTOS];  // Blocos e, depois deles, as suas posições
+    _Atomic size_t num_alocados;  // Blocos já tirados da reserva
+    const struct Diretorio *base;  // Diretório com os blocos compartilhados, ou NULL
+} Diretorio;
+
+/* Cria o diretório vazio de num_posicoes posições */
+void diretorio_cria(Diretorio *d, size_t num_posicoes, size_t tam_bloco,
+                    void (*inicia)(void *bloco));
+void diretorio_destroi(Diretorio *d);
+
+/*
+ * Cria d como cópia de base, com num_posicoes posições: os blocos
+ * alocados de base ficam compartilhados, com os mesmos índices k, até a
+ * primeira escrita em cada um. base não pode ser uma cópia.
+ */
+void diretorio_cria_copia(Diretorio *d, size_t num_posicoes, const Diretorio *base);
+
+/* Aloca o bloco da posição (numa cópia, copia o compartilhado), ou retorna o que outra thread alocou */
+void *diretorio_aloca(Diretorio *d, size_t posicao);
+
+/* Bloco da posição para leitura: um bloco vazio se ele ainda não foi alocado */
+static inline void *diretorio_bloco(const Diretorio *d, size_t posicao)
+{
+    void *_Atomic *grupo = atomic_load_explicit(&d->grupos[posicao >> BITS_GRUPO],
+                                                memory_order_acquire);
+    return atomic_load_explicit(&grupo[posicao & (LADRILHOS_GRUPO - 1)], memory_order_acquire);
+}
+
+/* 1 se b, lido com diretorio_bloco, já foi alocado e publicado, na cópia ou na base */
+static inline int diretorio_alocado(const Diretorio *d, const void *b)
+{
+    return b != d->vazio && b != d->em_criacao;
+}
+
+/* 1 se b, lido na posição com diretorio_bloco, pode ser escrito: alocado e não compartilhado */
+static inline int diretorio_proprio(const Diretorio *d, size_t posicao, const void *b)
+{
+    return diretorio_alocado(d, b) && !(d->base && b == diretorio_bloco(d->base, posicao));
+}
+
+/* Bloco da posição para escrita: se ele não existe, é compartilhado ou está sendo iniciado, o aloca ou espera */
+static inline void *diretorio_escrita(Diretorio *d, size_t posicao)
+{
+    void *b = diretorio_bloco(d, posicao);
+    if (!diretorio_proprio(d, posicao, b))
+        b = diretorio_aloca(d, posicao);
+    return b;
+}
+
+static inline size_t diretorio_alocados(const Diretorio *d)
+{
+    return atomic_load_explicit(&d->num_alocados, memory_order_relaxed);
+}
+
+/* Segmento do bloco k da reserva e a posição dele no segmento */
+static inline int diretorio_segmento(size_t k, size_t *desloc)
+{
+    size_t x = k + BLOCOS_SEGMENTO;
+    int s = 63 - __builtin_clzll((unsigned long long) x) - BITS_SEGMENTO;
+    *desloc = x - ((size_t) BLOCOS_SEGMENTO << s);
+    return s;
+}
+
+static inline size_t diretorio_capacidade(int s)
+{
+    return (size_t) BLOCOS_SEGMENTO << s;
+}
+
+/* Lugar do bloco de índice k (0 <= k < diretorio_alocados) na reserva, na ordem da primeira escrita */
+static inline void *diretorio_reserva_k(const Diretorio *d, size_t k)
+{
+    size_t desloc;
+    int s = diretorio_segmento(k, &desloc);
+    return atomic_load_explicit(&d->segmentos[s], memory_order_relaxed) + desloc * d->tam_bloco;
+}
+
+/* Posição do bloco alocado de índice k */
+static inline size_t diretorio_posicao_k(const Diretorio *d, size_t k)
+{
+    size_t desloc;
+    int s = diretorio_segmento(k, &desloc);
+    char *segmento = atomic_load_explicit(&d->segmentos[s], memory_order_relaxed);
+    return ((const size_t *) (segmento + diretorio_capacidade(s) * d->tam_bloco))[desloc];
+}
+
+/* Bloco alocado de índice k: o da reserva ou, numa cópia, o ainda compartilhado com a base */
+static inline void *diretorio_bloco_k(const Diretorio *d, size_t k)
+{
+    if (!d->base)
+        return diretorio_reserva_k(d, k);
+    return diretorio_bloco(d, diretorio_posicao_k(d, k));
+}
+
+/*
+ * Reserva nova, com os segmentos dos blocos já alocados mapeados e sem
+ * páginas, para quem quer escolher quem toca cada bloco primeiro (-N).
+ * diretorio_troca_reserva passa a usá-la: o bloco k da nova é o bloco
+ * ordem[k] da atual, e as páginas da atual são devolvidas. Não vale
+ * para cópias.
+ */
+void diretorio_nova_reserva(const Diretorio *d, char **segmentos);
+void diretorio_troca_reserva(Diretorio *d, char **segmentos, const size_t *ordem);
+
+/* Endereço do bloco k na reserva nova de diretorio_nova_reserva */
+static inline void *diretorio_endereco(const Diretorio *d, char *const *segmentos, size_t k)
+{
+    size_t desloc;
+    int s = diretorio_segmento(k, &desloc);
+    return segmentos[s] + desloc * d->tam_bloco;
+}
+
+#endif /*__DIRETORIO_H__*/
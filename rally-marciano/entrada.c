@@ -0,0 +1,485 @@
+/*
+ * Leitura da entrada da simulação.
+ *
+ * A entrada padrão é mapeada com mmap (ou lida inteira, se não for um
+ * arquivo comum) e percorrida por um leitor escrito à mão, sem scanf.
+ * A leitura é feita em duas passadas:
+ *
+ * 1. Uma passada sequencial lê o cabeçalho e as posições dos robôs e só
+ *    localiza o início de cada linha da arena e de cada sequência de
+ *    movimentos, pulando direto para o fim esperado de cada uma.
+ * 2. Os trabalhadores preenchem em paralelo faixas de linhas da arena e
+ *    compactam faixas de sequências para os robôs (sequencia.h),
+ *    conferindo que nenhuma delas é mais curta do que o informado. As
+ *    faixas de linhas começam em múltiplos de LADO_LADRILHO, então cada
+ *    ladrilho da arena é alocado e tocado pela primeira vez pelo
+ *    trabalhador da sua faixa, e só os que têm algum objeto.
+ *
+ * Não há limite para a largura da arena nem para o tamanho das sequências.
+ * Quando a entrada é um arquivo mapeado, as duas passadas devolvem ao
+ * sistema as páginas que já leram, a cada LADO_LADRILHO linhas ou robôs,
+ * então a entrada não fica inteira na memória do processo.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "rally.h"
+
+/* Quantidade mínima de entrada por trabalhador na cópia paralela */
+#define BYTES_POR_TRABALHADOR (1 << 20)
+
+typedef struct {
+    const char *p;    // Posição atual
+    const char *fim;  // Fim da entrada
+} Leitor;
+
+/* Seções da entrada localizadas antes da cópia */
+typedef struct {
+    const char **inicio_linha;      // Início de cada linha da arena na entrada
+    const char **inicio_sequencia;  // Início da sequência de cada robô na entrada
+    size_t pagina_devolvida;  // Tamanho de página se a entrada é um arquivo mapeado, senão 0
+} Carga;
+
+/* Faixas de linhas e de robôs copiadas por um trabalhador */
+typedef struct {
+    const Carga *carga;
+    Coordenada lin_ini, lin_fim;
+    int robo_ini, robo_fim;
+    Coordenada erro_linha;  // Primeira linha curta encontrada, ou -1
+    int erro_robo;   // Primeiro robô com sequência curta, ou -1
+} TarefaCarga;
+
+static void imprime_motivo(const char *formato, va_list args)
+{
+    fprintf(stderr, "Entrada inválida: ");
+    vfprintf(stderr, formato, args);
+    fprintf(stderr, "\n");
+}
+
+/* Imprime o motivo e retorna 0 para quem chamou desfazer a leitura */
+static int falha(const char *formato, ...)
+{
+    va_list args;
+    va_start(args, formato);
+    imprime_motivo(formato, args);
+    va_end(args);
+    return 0;
+}
+
+static inline int eh_espaco(char c)
+{
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == '\v' || c == '\f';
+}
+
+static inline void pula_espacos(Leitor *l)
+{
+    while (l->p < l->fim && eh_espaco(*l->p))
+        l->p++;
+}
+
+static inline void pula_token(Leitor *l)
+{
+    while (l->p < l->fim && !eh_espaco(*l->p))
+        l->p++;
+}
+
+/* Lê um inteiro decimal de módulo até 'limite', com sinal opcional. Retorna 0 se não houver número */
+static int le_numero(Leitor *l, int64_t limite, int64_t *v)
+{
+    pula_espacos(l);
+    int negativo = 0;
+    if (l->p < l->fim && (*l->p == '-' || *l->p == '+'))
+        negativo = *l->p++ == '-';
+    if (l->p >= l->fim || *l->p < '0' || *l->p > '9')
+        return 0;
+    int64_t x = 0;
+    while (l->p < l->fim && *l->p >= '0' && *l->p <= '9') {
+        x = x * 10 + (*l->p++ - '0');
+        if (x > limite)
+            return 0;
+    }
+    *v = negativo ? -x : x;
+    return 1;
+}
+
+static int le_inteiro(Leitor *l, int *v)
+{
+    int64_t x;
+    if (!le_numero(l, 0x7fffffffL, &x))
+        return 0;
+    *v = (int) x;
+    return 1;
+}
+
+static int le_coordenada(Leitor *l, Coordenada *v)
+{
+    return le_numero(l, MAX_COORDENADA, v);
+}
+
+/* Pula um token que deve ter ao menos n caracteres e retorna o seu início */
+static const char *localiza_token(Leitor *l, size_t n)
+{
+    pula_espacos(l);
+    const char *inicio = l->p;
+    if ((size_t) (l->fim - inicio) < n)
+        return NULL;
+    // A conferência de que não há espaços no meio fica para a cópia paralela
+    l->p += n;
+    pula_token(l);
+    return inicio;
+}
+
+/*
+ * Devolve as páginas inteiras de [ini, fim) da entrada, já lidas. Elas
+ * voltam do arquivo se forem lidas de novo. Uma entrada que não é um
+ * mapeamento do arquivo (a de le_entrada_dados) nunca é devolvida.
+ */
+static void devolve_lidas(const Carga *c, const char *ini, const char *fim)
+{
+    size_t pagina = c->pagina_devolvida;
+    if (!pagina)
+        return;
+    uintptr_t a = ((uintptr_t) ini + pagina - 1) & ~(uintptr_t) (pagina - 1);
+    uintptr_t b = (uintptr_t) fim & ~(uintptr_t) (pagina - 1);
+    if (a < b)
+        madvise((void *) a, b - a, MADV_DONTNEED);
+}
+
+static inline int tem_espaco(const char *p, size_t n)
+{
+    for (size_t k = 0; k < n; k++)
+        if (eh_espaco(p[k]))
+            return 1;
+    return 0;
+}
+
+/* Preenche as linhas e compacta as sequências da faixa do trabalhador */
+static void *copia_faixa(void *arg)
+{
+    TarefaCarga *t = (TarefaCarga *) arg;
+    const Carga *c = t->carga;
+    size_t m = (size_t) sim->arena.n_cols;
+
+    Coordenada lidas = t->lin_ini;  // Primeira linha ainda não devolvida
+    for (Coordenada i = t->lin_ini; i < t->lin_fim; i++) {
+        if (tem_espaco(c->inicio_linha[i], m)) {
+            t->erro_linha = i;
+            break;
+        }
+        arena_poe_linha(i, c->inicio_linha[i]);
+        if (i + 1 - lidas == LADO_LADRILHO || i + 1 == t->lin_fim) {
+            devolve_lidas(c, c->inicio_linha[lidas], c->inicio_linha[i] + m);
+            lidas = i + 1;
+        }
+    }
+
+    int robo_lido = t->robo_ini;
+    for (int r = t->robo_ini; r < t->robo_fim; r++) {
+        size_t n = (size_t) sim->robos.frio[r].tamanho_sequencia;
+        if (tem_espaco(c->inicio_sequencia[r], n)) {
+            t->erro_robo = r;
+            break;
+        }
+        sim->robos.frio[r].sequencia_movimentos = sequencia_compacta(c->inicio_sequencia[r], (int) n);
+        if (r + 1 - robo_lido == LADO_LADRILHO || r + 1 == t->robo_fim) {
+            devolve_lidas(c, c->inicio_sequencia[robo_lido], c->inicio_sequencia[r] + n);
+            robo_lido = r + 1;
+        }
+    }
+    return NULL;
+}
+
+/* Início da faixa de linhas do trabalhador t de n, numa fronteira de ladrilhos */
+static Coordenada inicio_faixa_linhas(Coordenada linhas, int t, int n)
+{
+    if (t == n)
+        return linhas;
+    return linhas * t / n & ~(Coordenada) (LADO_LADRILHO - 1);
+}
+
+/* Lê todo o arquivo quando ele não pode ser mapeado (pipe, terminal) */
+static char *le_tudo(int fd, size_t *tam)
+{
+    size_t cap = 1 << 16, n = 0;
+    char *buf = (char *) malloc(cap);
+    for (;;) {
+        if (n == cap) {
+            cap *= 2;
+            buf = (char *) realloc(buf, cap);
+        }
+        ssize_t lidos = read(fd, buf + n, cap - n);
+        if (lidos < 0) {
+            if (errno == EINTR)
+                continue;
+            perror("read");
+            exit(1);
+        }
+        if (lidos == 0)
+            break;
+        n += (size_t) lidos;
+    }
+    *tam = n;
+    return buf;
+}
+
+/* Mapeia o arquivo aberto em fd ou, se não der, lê ele inteiro */
+static char *carrega(int fd, size_t *tam, int *mapeado)
+{
+    char *dados = NULL;
+    struct stat st;
+
+    *mapeado = 0;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        *tam = (size_t) st.st_size;
+        // Sem MAP_POPULATE: as páginas são trazidas e devolvidas aos poucos pelas passadas
+        dados = (char *) mmap(NULL, *tam, PROT_READ, MAP_PRIVATE, fd, 0);
+        *mapeado = dados != MAP_FAILED;
+        if (*mapeado)
+            madvise(dados, *tam, MADV_WILLNEED);
+    }
+    if (!*mapeado)
+        dados = le_tudo(fd, tam);
+    return dados;
+}
+
+static void descarrega(char *dados, size_t tam, int mapeado)
+{
+    if (mapeado)
+        munmap(dados, tam);
+    else
+        free(dados);
+}
+
+/* Localiza as linhas da arena e as sequências e lê as posições dos robôs. Retorna 0 se inválidas */
+static int localiza_secoes(Carga *c, Leitor *l, Coordenada N, Coordenada M, int R)
+{
+    /* Localiza as linhas da arena */
+    for (Coordenada i = 0; i < N; i++) {
+        if (!(c->inicio_linha[i] = localiza_token(l, (size_t) M)))
+            return falha("a arena termina antes da linha %lld", (long long) i);
+        if ((i + 1) % LADO_LADRILHO == 0)
+            devolve_lidas(c, c->inicio_linha[i + 1 - LADO_LADRILHO], l->p);
+    }
+
+    /* Lê as posições iniciais dos robôs */
+    for (int r = 0; r < R; r++)
+    {
+        if (!le_coordenada(l, &sim->robos.i[r]) || !le_coordenada(l, &sim->robos.j[r]))
+            return falha("falta a posição do robô %d", r);
+        if (!eh_posicao_valida(sim->robos.i[r], sim->robos.j[r]))
+            return falha("robô %d fora da arena", r);
+        sim->robos.frio[r].id = r;
+        sim->robos.energia[r] = sim->energia_bateria;
+        sim->robos.frio[r].figuras_coletadas = 0;
+    }
+
+    /* Localiza a sequência de movimentos de cada robô */
+    for (int r = 0; r < R; r++)
+    {
+        int n_mov;
+        if (!le_inteiro(l, &n_mov) || n_mov < 0)
+            return falha("falta o número de movimentos do robô %d", r);
+        sim->robos.frio[r].tamanho_sequencia = n_mov;
+        sim->robos.faltam[r] = n_mov;
+        if (n_mov == 0)
+            c->inicio_sequencia[r] = l->p;
+        else if (!(c->inicio_sequencia[r] = localiza_token(l, (size_t) n_mov)))
+            return falha("a entrada termina na sequência do robô %d", r);
+        if ((r + 1) % LADO_LADRILHO == 0)
+            devolve_lidas(c, c->inicio_sequencia[r + 1 - LADO_LADRILHO], l->p);
+    }
+    return 1;
+}
+
+/* Copia as linhas e as sequências em paralelo. Retorna 0 se alguma for curta */
+static int copia_secoes(const Carga *c, size_t tam, Coordenada N, Coordenada M, int R)
+{
+    int n = sim->num_trabalhadores;
+    if ((size_t) n > tam / BYTES_POR_TRABALHADOR)
+        n = (int) (tam / BYTES_POR_TRABALHADOR);
+    if (n < 1)
+        n = 1;
+
+    TarefaCarga *tarefas = (TarefaCarga *) malloc(sizeof(TarefaCarga) * n);
+    pthread_t *threads = (pthread_t *) malloc(sizeof(pthread_t) * n);
+    for (int t = 0; t < n; t++) {
+        tarefas[t].carga = c;
+        tarefas[t].lin_ini = inicio_faixa_linhas(N, t, n);
+        tarefas[t].lin_fim = inicio_faixa_linhas(N, t + 1, n);
+        tarefas[t].robo_ini = (int) ((long) R * t / n);
+        tarefas[t].robo_fim = (int) ((long) R * (t + 1) / n);
+        tarefas[t].erro_linha = -1;
+        tarefas[t].erro_robo = -1;
+        if (t > 0)
+            cria_thread_simulacao(&threads[t], NULL, copia_faixa, &tarefas[t]);
+    }
+    copia_faixa(&tarefas[0]);
+    for (int t = 1; t < n; t++)
+        pthread_join(threads[t], NULL);
+
+    int ok = 1;
+    for (int t = 0; t < n && ok; t++) {
+        if (tarefas[t].erro_linha >= 0)
+            ok = falha("a linha %lld da arena tem menos de %lld colunas",
+                       (long long) tarefas[t].erro_linha, (long long) M);
+        else if (tarefas[t].erro_robo >= 0)
+            ok = falha("a sequência do robô %d tem menos de %d movimentos", tarefas[t].erro_robo,
+                       sim->robos.frio[tarefas[t].erro_robo].tamanho_sequencia);
+    }
+    free(tarefas);
+    free(threads);
+    return ok;
+}
+
+/* le_entrada_dados; 'pagina' é o tamanho de página se dados é um arquivo mapeado, senão 0 */
+static int le_secoes(const char *dados, size_t tam, size_t pagina)
+{
+    Leitor l = { dados, dados + tam };
+    Coordenada N, M;
+    int R, T;
+
+    /* Lê as dimensões da arena, número de robôs, energia por bateria e o número de turnos */
+    if (!le_coordenada(&l, &N) || !le_coordenada(&l, &M) || !le_inteiro(&l, &R) ||
+        !le_inteiro(&l, &sim->energia_bateria) || !le_inteiro(&l, &T) || N < 0 || M < 0 || R < 0)
+        return falha("cabeçalho incompleto");
+    if (!arena_dimensoes_validas(N, M))
+        return falha("arena de %lld x %lld grande demais", (long long) N, (long long) M);
+
+    /* Cria a arena; as células são preenchidas depois, em paralelo */
+    cria_arena(&sim->arena, N, M);
+
+    /* Cria os robôs */
+    cria_robos(&sim->robos, R);
+
+    sim->num_robos = R;
+    sim->num_total_turnos = T;
+
+    Carga c;
+    c.inicio_linha = (const char **) malloc(sizeof(char *) * (size_t) (N > 0 ? N : 1));
+    c.inicio_sequencia = (const char **) malloc(sizeof(char *) * (R > 0 ? R : 1));
+    c.pagina_devolvida = pagina;
+
+    int ok = localiza_secoes(&c, &l, N, M, R) && copia_secoes(&c, tam, N, M, R);
+
+    /* Marca a posição inicial dos robôs na arena */
+    if (ok)
+        for (int r = 0; r < R; r++)
+            arena_poe_id(celula(sim->robos.i[r], sim->robos.j[r]), r);
+
+    free(c.inicio_linha);
+    free(c.inicio_sequencia);
+    if (!ok) {
+        // As sequências que não chegaram a ser compactadas são NULL
+        for (int r = 0; r < R; r++)
+            free(sim->robos.frio[r].sequencia_movimentos);
+        libera_robos(&sim->robos);
+        destroi_arena(&sim->arena);
+        sim->num_robos = 0;
+    }
+    return ok;
+}
+
+/*
+ * Lê a entrada em dados[0, tam) e configura a arena e os robôs. Se ela for
+ * inválida, imprime o motivo em stderr, desfaz o que foi alocado e
+ * retorna 0.
+ */
+int le_entrada_dados(const char *dados, size_t tam)
+{
+    return le_secoes(dados, tam, 0);
+}
+
+/* Lê a entrada do arquivo aberto em fd, como le_entrada_dados */
+int le_entrada_fd(int fd)
+{
+    size_t tam = 0;
+    int mapeado;
+    char *dados = carrega(fd, &tam, &mapeado);
+    int ok = le_secoes(dados, tam, mapeado ? (size_t) sysconf(_SC_PAGESIZE) : 0);
+    descarrega(dados, tam, mapeado);
+    return ok;
+}
+
+/* Função para ler a entrada padrão e configurar a arena e os robôs */
+void le_entrada()
+{
+    if (!le_entrada_fd(STDIN_FILENO))
+        exit(1);
+}
+
+/*
+ * Lê os robôs do arquivo, no formato das duas últimas seções da entrada
+ * precedidas pelo número de robôs, numa simulação que já tem a arena e
+ * ainda não tem robôs (modo lote). Os robôs começam com energia_bateria
+ * de energia. Se o arquivo for inválido, imprime o motivo em stderr,
+ * descarta o que leu e retorna 0.
+ */
+int le_robos(const char *arquivo)
+{
+    int fd = open(arquivo, O_RDONLY);
+    if (fd < 0) {
+        perror(arquivo);
+        return 0;
+    }
+    size_t tam = 0;
+    int mapeado;
+    char *dados = carrega(fd, &tam, &mapeado);
+    close(fd);
+
+    Leitor l = { dados, dados + tam };
+    int R;
+    if (!le_inteiro(&l, &R) || R < 0) {
+        descarrega(dados, tam, mapeado);
+        return falha("%s: falta o número de robôs", arquivo);
+    }
+    cria_robos(&sim->robos, R);
+
+    int ok = 1;
+    for (int r = 0; ok && r < R; r++) {
+        if (!le_coordenada(&l, &sim->robos.i[r]) || !le_coordenada(&l, &sim->robos.j[r]))
+            ok = falha("%s: falta a posição do robô %d", arquivo, r);
+        else if (!eh_posicao_valida(sim->robos.i[r], sim->robos.j[r]))
+            ok = falha("%s: robô %d fora da arena", arquivo, r);
+        sim->robos.frio[r].id = r;
+        sim->robos.energia[r] = sim->energia_bateria;
+    }
+
+    for (int r = 0; ok && r < R; r++) {
+        int n_mov;
+        if (!le_inteiro(&l, &n_mov) || n_mov < 0) {
+            ok = falha("%s: falta o número de movimentos do robô %d", arquivo, r);
+            break;
+        }
+        const char *inicio = n_mov == 0 ? l.p : localiza_token(&l, (size_t) n_mov);
+        if (!inicio || tem_espaco(inicio, (size_t) n_mov)) {
+            ok = falha("%s: a sequência do robô %d tem menos de %d movimentos",
+                       arquivo, r, n_mov);
+            break;
+        }
+        sim->robos.frio[r].tamanho_sequencia = n_mov;
+        sim->robos.faltam[r] = n_mov;
+        sim->robos.frio[r].sequencia_movimentos = sequencia_compacta(inicio, n_mov);
+    }
+    descarrega(dados, tam, mapeado);
+
+    if (!ok) {
+        // As sequências não lidas continuam NULL (calloc em cria_robos)
+        for (int r = 0; r < R; r++)
+            free(sim->robos.frio[r].sequencia_movimentos);
+        libera_robos(&sim->robos);
+        return 0;
+    }
+    sim->num_robos = R;
+    for (int r = 0; r < R; r++)
+        arena_poe_id(celula(sim->robos.i[r], sim->robos.j[r]), r);
+    return 1;
+}
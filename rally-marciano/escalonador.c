@@ -0,0 +1,205 @@
+/*
+ * Filas de Chase-Lev e roubo de trabalho do motor pool (escalonador.h).
+ *
+ * A fila segue a formulação em C11 de Lê, Pop, Cohen e Zappa Nardelli
+ * ("Correct and Efficient Work-Stealing for Weak Memory Models"). Cada
+ * fila recebe, por etapa, só os pedaços da fatia do dono, então a
+ * capacidade é fixa e nunca cresce; topo e base só aumentam, e o vetor é
+ * usado como anel.
+ *
+ * O estado vem sempre por parâmetro depois de escolhido: no modo lote a
+ * função executada troca a simulação da thread (sim) a cada cenário.
+ */
+
+#include <sched.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+
+#include "rally.h"
+#include "escalonador.h"
+
+/* Resultado de deque_tira e deque_rouba quando não há pedaço */
+#define SEM_PEDACO (-1)
+#define DISPUTADO  (-2)  // Outro trabalhador levou o pedaço; vale tentar de novo
+
+/* Fila de um trabalhador, alinhada para evitar falso compartilhamento */
+typedef struct {
+    atomic_long topo;  // Próximo pedaço a roubar
+    atomic_long base;  // Próxima posição livre; só o dono escreve
+    long mascara;      // Capacidade - 1 (potência de 2)
+    atomic_int *pedacos;  // Primeiro robô de cada pedaço
+    int inicio, fim;   // Fatia do dono
+    long roubados;     // Pedaços que o dono roubou
+} __attribute__((aligned(64))) DequeTrabalho;
+
+/* Filas do motor pool numa execução (sim->escalonador), ou dos cenários do modo lote */
+typedef struct EstadoEscalonador {
+    DequeTrabalho *deques;
+    int num_deques;
+    int tam_pedaco;        // Itens por pedaço
+    atomic_int pendentes;  // Pedaços postos nas filas e ainda não tirados nem roubados
+} EstadoEscalonador;
+
+/* Só o dono */
+static void deque_poe(DequeTrabalho *d, int pedaco)
+{
+    long b = atomic_load_explicit(&d->base, memory_order_relaxed);
+    atomic_store_explicit(&d->pedacos[b & d->mascara], pedaco, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&d->base, b + 1, memory_order_relaxed);
+}
+
+/* Só o dono: tira o último pedaço posto */
+static int deque_tira(DequeTrabalho *d)
+{
+    long b = atomic_load_explicit(&d->base, memory_order_relaxed) - 1;
+    atomic_store_explicit(&d->base, b, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    long t = atomic_load_explicit(&d->topo, memory_order_relaxed);
+
+    if (t > b) {
+        atomic_store_explicit(&d->base, b + 1, memory_order_relaxed);
+        return SEM_PEDACO;
+    }
+    int pedaco = atomic_load_explicit(&d->pedacos[b & d->mascara], memory_order_relaxed);
+    if (t == b) {
+        // Último pedaço: disputa com os ladrões pelo topo
+        if (!atomic_compare_exchange_strong_explicit(&d->topo, &t, t + 1, memory_order_seq_cst,
+                                                     memory_order_relaxed))
+            pedaco = SEM_PEDACO;
+        atomic_store_explicit(&d->base, b + 1, memory_order_relaxed);
+    }
+    return pedaco;
+}
+
+/* Qualquer trabalhador: rouba o pedaço mais antigo */
+static int deque_rouba(DequeTrabalho *d)
+{
+    long t = atomic_load_explicit(&d->topo, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    long b = atomic_load_explicit(&d->base, memory_order_acquire);
+    if (t >= b)
+        return SEM_PEDACO;
+
+    int pedaco = atomic_load_explicit(&d->pedacos[t & d->mascara], memory_order_relaxed);
+    if (!atomic_compare_exchange_strong_explicit(&d->topo, &t, t + 1, memory_order_seq_cst,
+                                                 memory_order_relaxed))
+        return DISPUTADO;
+    return pedaco;
+}
+
+/* Filas de n trabalhadores, com a fatia [inicios[t], inicios[t + 1]) do trabalhador t */
+static EstadoEscalonador *cria_filas(int n, int tam_pedaco, const int *inicios)
+{
+    EstadoEscalonador *e = (EstadoEscalonador *) malloc(sizeof(EstadoEscalonador));
+    e->num_deques = n;
+    e->tam_pedaco = tam_pedaco;
+    e->deques = (DequeTrabalho *) aligned_alloc(sizeof(DequeTrabalho), sizeof(DequeTrabalho) * n);
+    for (int t = 0; t < n; t++) {
+        DequeTrabalho *d = &e->deques[t];
+        d->inicio = inicios[t];
+        d->fim = inicios[t + 1];
+        long capacidade = 1;
+        while (capacidade * tam_pedaco < d->fim - d->inicio)
+            capacidade *= 2;
+        d->mascara = capacidade - 1;
+        d->pedacos = (atomic_int *) malloc(sizeof(atomic_int) * capacidade);
+        atomic_init(&d->topo, 0);
+        atomic_init(&d->base, 0);
+        d->roubados = 0;
+    }
+    atomic_init(&e->pendentes, 0);
+    return e;
+}
+
+void escalonador_inicia(int n)
+{
+    int *inicios = (int *) malloc(sizeof(int) * (n + 1));
+    for (int t = 0; t <= n; t++)
+        inicios[t] = inicio_fatia(t, n);
+    sim->escalonador = cria_filas(n, ROBOS_POR_PEDACO, inicios);
+    free(inicios);
+}
+
+EstadoEscalonador *escalonador_cria(int n, int num_itens, int tam_pedaco)
+{
+    int *inicios = (int *) malloc(sizeof(int) * (n + 1));
+    for (int t = 0; t <= n; t++)
+        inicios[t] = (int) ((long) num_itens * t / n);
+    EstadoEscalonador *e = cria_filas(n, tam_pedaco, inicios);
+    free(inicios);
+    return e;
+}
+
+void escalonador_destroi(EstadoEscalonador *e)
+{
+    for (int t = 0; t < e->num_deques; t++)
+        free(e->deques[t].pedacos);
+    free(e->deques);
+    free(e);
+}
+
+void escalonador_finaliza()
+{
+    EstadoEscalonador *e = sim->escalonador;
+    for (int t = 0; t < e->num_deques; t++)
+        sim->pedacos_roubados += e->deques[t].roubados;
+    escalonador_destroi(e);
+    sim->escalonador = NULL;
+}
+
+long escalonador_roubados()
+{
+    return sim->pedacos_roubados;
+}
+
+static void executa_pedaco(const EstadoEscalonador *e, const DequeTrabalho *dono, int pedaco,
+                           void (*funcao)(int r))
+{
+    int fim = pedaco + e->tam_pedaco < dono->fim ? pedaco + e->tam_pedaco : dono->fim;
+    for (int r = pedaco; r < fim; r++)
+        funcao(r);
+}
+
+void escalonador_executa(int t, void (*funcao)(int r))
+{
+    escalonador_executa_em(sim->escalonador, t, funcao);
+}
+
+void escalonador_executa_em(EstadoEscalonador *e, int t, void (*funcao)(int i))
+{
+    DequeTrabalho *d = &e->deques[t];
+
+    // Do último pedaço para o primeiro, então o dono tira os pedaços na ordem dos robôs
+    int num_pedacos = (d->fim - d->inicio + e->tam_pedaco - 1) / e->tam_pedaco;
+    atomic_fetch_add_explicit(&e->pendentes, num_pedacos, memory_order_relaxed);
+    for (int k = num_pedacos - 1; k >= 0; k--)
+        deque_poe(d, d->inicio + k * e->tam_pedaco);
+
+    int pedaco;
+    while ((pedaco = deque_tira(d)) != SEM_PEDACO) {
+        atomic_fetch_sub_explicit(&e->pendentes, 1, memory_order_relaxed);
+        executa_pedaco(e, d, pedaco, funcao);
+    }
+
+    // Rouba dos outros, a partir do vizinho, enquanto algum pedaço não foi tirado
+    while (atomic_load_explicit(&e->pendentes, memory_order_relaxed) > 0) {
+        int achou = 0;
+        for (int k = 1; k < e->num_deques; k++) {
+            DequeTrabalho *vitima = &e->deques[(t + k) % e->num_deques];
+            do
+                pedaco = deque_rouba(vitima);
+            while (pedaco == DISPUTADO);
+            if (pedaco != SEM_PEDACO) {
+                atomic_fetch_sub_explicit(&e->pendentes, 1, memory_order_relaxed);
+                d->roubados++;
+                executa_pedaco(e, vitima, pedaco, funcao);
+                achou = 1;
+                break;
+            }
+        }
+        // Os pedaços que faltam ainda vão ser postos ou acabaram de ser levados
+        if (!achou)
+            sched_yield();
+    }
+}
@@ -0,0 +1,52 @@
+#ifndef __ESCALONADOR_H__
+#define __ESCALONADOR_H__
+
+/*
+ * Escalonamento das etapas do motor pool com roubo de trabalho.
+ *
+ * O custo de um robô varia muito de um turno para outro: um robô parado
+ * retorna na hora, e um robô numa região cheia disputa as travas das
+ * células. Com uma fatia fixa por trabalhador, o mais lento atrasa a
+ * barreira de todos. Aqui cada fatia é dividida em pedaços de
+ * ROBOS_POR_PEDACO robôs, postos numa fila de Chase-Lev do dono: o dono
+ * tira os pedaços de uma ponta, na ordem dos robôs, e quem termina a
+ * própria fila rouba pedaços da outra ponta das filas dos demais.
+ *
+ * Cada pedaço é executado por exatamente um trabalhador, e sem roubo a
+ * ordem é a mesma da fatia inteira (com um trabalhador, a mesma do laço
+ * sobre todos os robôs).
+ *
+ * As mesmas filas escalonam os cenários do modo lote (lote.h), com um
+ * cenário por pedaço, num escalonador avulso (escalonador_cria).
+ */
+
+/* Robôs por pedaço; múltiplo de ROBOS_POR_LINHA, então dois pedaços não dividem linhas de cache */
+#define ROBOS_POR_PEDACO 64
+
+/* Cria as filas para n trabalhadores, com as fatias de inicio_fatia */
+void escalonador_inicia(int n);
+
+void escalonador_finaliza();
+
+/*
+ * Executa funcao(r) para os robôs de uma etapa, chamada por todos os
+ * trabalhadores, com t o índice do chamador. Retorna quando a fila de t
+ * está vazia e não há mais pedaços a roubar; os pedaços roubados de t
+ * podem ainda estar em execução, então a etapa termina numa barreira.
+ */
+void escalonador_executa(int t, void (*funcao)(int r));
+
+/* Pedaços roubados por todos os trabalhadores, somados a cada escalonador_finaliza */
+long escalonador_roubados();
+
+/*
+ * Escalonador avulso, fora de sim, para os itens 0 a num_itens - 1 em
+ * pedaços de tam_pedaco, com fatias iguais para n trabalhadores.
+ * escalonador_executa_em é escalonador_executa com ele, e funcao é
+ * chamada uma única vez por item.
+ */
+struct EstadoEscalonador *escalonador_cria(int n, int num_itens, int tam_pedaco);
+void escalonador_destroi(struct EstadoEscalonador *e);
+void escalonador_executa_em(struct EstadoEscalonador *e, int t, void (*funcao)(int i));
+
+#endif /*__ESCALONADOR_H__*/
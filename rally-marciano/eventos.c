@@ -0,0 +1,262 @@
+/*
+ * Registro binário de eventos (eventos.h).
+ *
+ * A fila de cada thread é uma lista de blocos de tamanho fixo com um
+ * único produtor (a thread) e um único consumidor (a thread de escrita).
+ * O produtor preenche o bloco atual e publica a contagem com release;
+ * quando o bloco enche, encadeia um bloco novo. O consumidor lê até a
+ * contagem publicada e libera os blocos que já consumiu, então nenhum dos
+ * dois espera pelo outro.
+ *
+ * eventos_turno é chamada no início de cada turno, com as outras threads
+ * paradas na barreira, então todos os eventos dos turnos anteriores já
+ * foram publicados. Ela só avisa a thread de escrita com sem_post.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+
+#include "rally.h"
+#include "eventos.h"
+
+/* Eventos de cada bloco de uma fila */
+#define EVENTOS_POR_BLOCO 4096
+
+#define ORDEM_BYTES 0x01020304u
+
+/* Evento na fila, com o turno em que aconteceu */
+typedef struct {
+    int turno;
+    Evento evento;
+} EventoFila;
+
+typedef struct BlocoEventos {
+    _Atomic int n;  // Eventos publicados no bloco
+    struct BlocoEventos *_Atomic prox;
+    EventoFila v[EVENTOS_POR_BLOCO];
+} BlocoEventos;
+
+/* Fila de uma thread, registrada no primeiro evento dela */
+typedef struct FilaEventos {
+    BlocoEventos *escrita;  // Só a thread dona
+    BlocoEventos *leitura;  // Só a thread de escrita
+    int lidos;              // Eventos já consumidos do bloco de leitura
+    struct FilaEventos *prox;
+} __attribute__((aligned(64))) FilaEventos;
+
+int eventos_ativos = 0;
+
+static FILE *saida;
+static pthread_t thread_escrita;
+static sem_t aviso;
+static FilaEventos *_Atomic filas;  // Filas de todas as threads
+static __thread FilaEventos *fila_thread;
+static int turno_corrente;          // Escrito só com as outras threads paradas
+static _Atomic int turno_fechado;   // Os turnos anteriores estão completos
+static _Atomic int encerrando;
+static int prox_turno;              // Próximo turno a gravar (thread de escrita)
+
+static Evento *do_turno;            // Eventos do turno sendo gravado
+static size_t cap_turno;
+
+static BlocoEventos *novo_bloco()
+{
+    BlocoEventos *b = (BlocoEventos *) malloc(sizeof(BlocoEventos));
+    atomic_init(&b->n, 0);
+    atomic_init(&b->prox, NULL);
+    return b;
+}
+
+static FilaEventos *registra_fila()
+{
+    FilaEventos *f = (FilaEventos *) aligned_alloc(sizeof(FilaEventos), sizeof(FilaEventos));
+    f->escrita = f->leitura = novo_bloco();
+    f->lidos = 0;
+    f->prox = atomic_load_explicit(&filas, memory_order_relaxed);
+    while (!atomic_compare_exchange_weak_explicit(&filas, &f->prox, f, memory_order_release,
+                                                  memory_order_relaxed))
+        ;
+    fila_thread = f;
+    return f;
+}
+
+static void poe(const Evento *e)
+{
+    FilaEventos *f = fila_thread ? fila_thread : registra_fila();
+    BlocoEventos *b = f->escrita;
+    int n = atomic_load_explicit(&b->n, memory_order_relaxed);
+    if (n == EVENTOS_POR_BLOCO) {
+        BlocoEventos *novo = novo_bloco();
+        atomic_store_explicit(&b->prox, novo, memory_order_release);
+        f->escrita = b = novo;
+        n = 0;
+    }
+    b->v[n].turno = turno_corrente;
+    b->v[n].evento = *e;
+    atomic_store_explicit(&b->n, n + 1, memory_order_release);
+}
+
+void eventos_movimento(int robo, int64_t i, int64_t j, int direcao, char objeto)
+{
+    Evento e = { robo, EVENTO_MOVIMENTO, (uint8_t) direcao, objeto, 0,
+                 (uint64_t) i * (uint64_t) sim->arena.n_cols + (uint64_t) j };
+    poe(&e);
+}
+
+void eventos_roubo(int robo, int alvo)
+{
+    Evento e = { robo, EVENTO_ROUBO, 0, 0, 0, (uint64_t) alvo };
+    poe(&e);
+}
+
+/* Tira da fila f os eventos do turno e os acrescenta em do_turno */
+static void consome_turno(FilaEventos *f, int turno, size_t *n)
+{
+    for (;;) {
+        BlocoEventos *b = f->leitura;
+        int publicados = atomic_load_explicit(&b->n, memory_order_acquire);
+        if (f->lidos == publicados) {
+            BlocoEventos *prox = atomic_load_explicit(&b->prox, memory_order_acquire);
+            if (f->lidos < EVENTOS_POR_BLOCO || !prox)
+                return;
+            free(b);
+            f->leitura = prox;
+            f->lidos = 0;
+            continue;
+        }
+        const EventoFila *ef = &b->v[f->lidos];
+        if (ef->turno != turno)
+            return;
+        if (*n == cap_turno) {
+            cap_turno = cap_turno ? 2 * cap_turno : 1024;
+            do_turno = (Evento *) realloc(do_turno, cap_turno * sizeof(Evento));
+        }
+        do_turno[(*n)++] = ef->evento;
+        f->lidos++;
+    }
+}
+
+static int compara_eventos(const void *a, const void *b)
+{
+    const Evento *x = (const Evento *) a;
+    const Evento *y = (const Evento *) b;
+    if (x->robo != y->robo)
+        return x->robo < y->robo ? -1 : 1;
+    return (int) x->tipo - (int) y->tipo;
+}
+
+/* Grava os turnos completos ainda não gravados */
+static void grava_turnos()
+{
+    int fechado = atomic_load_explicit(&turno_fechado, memory_order_acquire);
+    for (; prox_turno < fechado; prox_turno++) {
+        size_t n = 0;
+        for (FilaEventos *f = atomic_load_explicit(&filas, memory_order_acquire); f; f = f->prox)
+            consome_turno(f, prox_turno, &n);
+        if (n == 0)
+            continue;
+        // A ordem entre as filas depende das threads; a do arquivo, não
+        qsort(do_turno, n, sizeof(Evento), compara_eventos);
+        CabecalhoTurno c = { prox_turno, (uint32_t) n };
+        fwrite(&c, sizeof(c), 1, saida);
+        fwrite(do_turno, sizeof(Evento), n, saida);
+    }
+}
+
+static void *thread_eventos(void *arg)
+{
+    (void) arg;
+    for (;;) {
+        sem_wait(&aviso);
+        int fim = atomic_load_explicit(&encerrando, memory_order_acquire);
+        grava_turnos();
+        if (fim)
+            break;
+    }
+    return NULL;
+}
+
+void eventos_inicia(const char *arquivo)
+{
+    saida = fopen(arquivo, "wb");
+    if (!saida) {
+        perror(arquivo);
+        exit(1);
+    }
+    setvbuf(saida, NULL, _IOFBF, 1 << 20);
+
+    CabecalhoEventos c;
+    memset(&c, 0, sizeof(c));
+    memcpy(c.magica, EVENTOS_MAGICA, sizeof(c.magica));
+    c.versao = EVENTOS_VERSAO;
+    c.ordem_bytes = ORDEM_BYTES;
+    c.n_lins = sim->arena.n_lins;
+    c.n_cols = sim->arena.n_cols;
+    c.num_robos = sim->num_robos;
+    c.num_total_turnos = sim->num_total_turnos;
+    c.energia_bateria = sim->energia_bateria;
+    c.turno_inicial = sim->turno_inicial;
+    c.lado_ladrilho = LADO_LADRILHO;
+    c.num_ladrilhos = arena_alocados(&sim->arena);
+    fwrite(&c, sizeof(c), 1, saida);
+
+    // Só os ladrilhos alocados, na ordem da reserva
+    for (size_t k = 0; k < c.num_ladrilhos; k++) {
+        uint64_t posicao = arena_posicao_k(&sim->arena, k);
+        const Ladrilho *l = arena_ladrilho_k(&sim->arena, k);
+        fwrite(&posicao, sizeof(posicao), 1, saida);
+        fwrite(l->id, sizeof(int), CELULAS_LADRILHO, saida);
+        fwrite(l->obj, 1, CELULAS_LADRILHO, saida);
+    }
+    fwrite(sim->robos.energia, sizeof(int), sim->num_robos, saida);
+
+    prox_turno = turno_corrente = sim->turno_inicial;
+    atomic_store_explicit(&turno_fechado, sim->turno_inicial, memory_order_relaxed);
+    atomic_store_explicit(&encerrando, 0, memory_order_relaxed);
+    sem_init(&aviso, 0, 0);
+    eventos_ativos = 1;
+    pthread_create(&thread_escrita, NULL, thread_eventos, NULL);
+}
+
+void eventos_turno(int turno)
+{
+    if (!eventos_ativos)
+        return;
+    turno_corrente = turno;
+    atomic_store_explicit(&turno_fechado, turno, memory_order_release);
+    sem_post(&aviso);
+}
+
+void eventos_finaliza()
+{
+    if (!eventos_ativos)
+        return;
+    atomic_store_explicit(&turno_fechado, sim->num_total_turnos, memory_order_release);
+    atomic_store_explicit(&encerrando, 1, memory_order_release);
+    sem_post(&aviso);
+    pthread_join(thread_escrita, NULL);
+    eventos_ativos = 0;
+
+    if (fclose(saida) != 0)
+        perror("eventos");
+    sem_destroy(&aviso);
+    FilaEventos *f = atomic_load_explicit(&filas, memory_order_relaxed);
+    while (f) {
+        FilaEventos *prox = f->prox;
+        for (BlocoEventos *b = f->leitura; b; ) {
+            BlocoEventos *seguinte = atomic_load_explicit(&b->prox, memory_order_relaxed);
+            free(b);
+            b = seguinte;
+        }
+        free(f);
+        f = prox;
+    }
+    atomic_store_explicit(&filas, NULL, memory_order_relaxed);
+    free(do_turno);
+    do_turno = NULL;
+    cap_turno = 0;
+}
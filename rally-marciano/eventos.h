@@ -0,0 +1,101 @@
+#ifndef __EVENTOS_H__
+#define __EVENTOS_H__
+
+/*
+ * Registro binário de eventos da simulação (-E arquivo).
+ *
+ * Em vez dos quadros completos, o arquivo guarda o estado inicial e, para
+ * cada turno com algum evento, os movimentos e os roubos de energia do
+ * turno. Com ele, decodifica_eventos reconstrói o quadro de qualquer
+ * turno.
+ *
+ * Cada trabalhador põe seus eventos numa fila própria, sem travas, e só
+ * ele escreve nela. Uma thread de escrita junta as filas turno a turno,
+ * ordena os eventos do turno por robô e grava o arquivo. A simulação
+ * nunca espera pela thread de escrita: as filas crescem em blocos
+ * enquanto ela estiver atrasada.
+ *
+ * Formato (ordem de bytes de quem escreveu, indicada em ordem_bytes):
+ * - CabecalhoEventos;
+ * - os num_ladrilhos ladrilhos alocados da arena (rally.h), cada um com a
+ *   sua posição (64 bits; a linha de ladrilhos vezes o número de
+ *   ladrilhos por linha, mais a coluna), o id das lado_ladrilho²
+ *   células (inteiros de 32 bits) e o obj delas (bytes), linha a linha.
+ *   As células dos demais ladrilhos estão vazias;
+ * - energia de cada robô (num_robos inteiros de 32 bits);
+ * - para cada turno com eventos, em ordem: um CabecalhoTurno seguido de
+ *   num_eventos Evento, ordenados por robô e, no mesmo robô, o movimento
+ *   antes do roubo.
+ *
+ * O estado inicial é o do início do turno turno_inicial. Os turnos sem
+ * eventos não aparecem no arquivo.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Identificação e versão do formato binário dos eventos */
+#define EVENTOS_MAGICA "RALLYEVT"
+#define EVENTOS_VERSAO 3
+
+typedef struct {
+    char magica[8];
+    uint32_t versao;
+    uint32_t ordem_bytes;      // 0x01020304 na ordem de bytes de quem escreveu
+    int64_t n_lins;
+    int64_t n_cols;
+    int32_t num_robos;
+    int32_t num_total_turnos;
+    int32_t energia_bateria;
+    int32_t turno_inicial;     // Turno cujo início é o estado inicial
+    uint32_t lado_ladrilho;    // Lado dos ladrilhos do estado inicial, em células
+    uint32_t reservado;
+    uint64_t num_ladrilhos;    // Ladrilhos gravados no estado inicial
+} CabecalhoEventos;
+
+typedef struct {
+    int32_t turno;
+    uint32_t num_eventos;
+} CabecalhoTurno;
+
+/* Tipos de evento */
+enum {
+    EVENTO_MOVIMENTO,  // O robô saiu de 'origem' para a vizinha na direção 'direcao'
+    EVENTO_ROUBO       // O robô roubou 1 de energia do robô 'origem'
+};
+
+/*
+ * Evento de um robô num turno. O destino de um movimento é a vizinha da
+ * origem na direção (0 a 3: norte, sul, leste, oeste), e a variação da
+ * energia vem do objeto coletado: -1, mais energia_bateria numa bateria.
+ * Num roubo o robô ganha 1 e o robô roubado perde 1.
+ */
+typedef struct {
+    int32_t robo;
+    uint8_t tipo;      // EVENTO_MOVIMENTO ou EVENTO_ROUBO
+    uint8_t direcao;   // Direção do movimento
+    char objeto;       // Objeto coletado no destino (VAZIO, BATERIA ou FIGURA)
+    uint8_t reservado;
+    uint64_t origem;   // Célula de origem, linha * n_cols + coluna (movimento), ou robô roubado (roubo)
+} Evento;
+
+/* 1 quando há um registro de eventos aberto */
+extern int eventos_ativos;
+
+/* Grava o cabeçalho e o estado atual no arquivo e inicia a thread de escrita */
+void eventos_inicia(const char *arquivo);
+
+/*
+ * Marca o início de 'turno': os eventos dos turnos anteriores estão
+ * completos e podem ser gravados. Chamada com as demais threads paradas.
+ */
+void eventos_turno(int turno);
+
+/* Grava os eventos restantes e encerra a thread de escrita */
+void eventos_finaliza();
+
+/* Registra, na fila da thread que chama, um evento do turno corrente */
+void eventos_movimento(int robo, int64_t i, int64_t j, int direcao, char objeto);
+void eventos_roubo(int robo, int alvo);
+
+#endif /*__EVENTOS_H__*/
@@ -0,0 +1,194 @@
+/*
+ * Gerador de cenários para o Rally dos Robôs em Marte.
+ *
+ * Escreve em stdout uma entrada no formato lido por rally_marciano. Com a
+ * mesma semente e os mesmos parâmetros, a saída é sempre a mesma, em
+ * qualquer plataforma (o gerador de números é o splitmix64, não rand()).
+ *
+ * O agrupamento controla quantos robôs nascem perto de poucos centros de
+ * aglomeração em vez de espalhados pela arena: com 0 todos os robôs são
+ * espalhados uniformemente, com 1 todos ficam nos aglomerados, o que
+ * aumenta os conflitos de movimento e os roubos de energia.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <getopt.h>
+
+/* Gerador splitmix64 */
+static uint64_t estado_aleatorio;
+
+static uint64_t aleatorio()
+{
+    uint64_t z = (estado_aleatorio += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+/* Número uniforme em [0, 1) */
+static double uniforme()
+{
+    return (aleatorio() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/* Inteiro uniforme em [0, n) */
+static long sorteia(long n)
+{
+    return (long) (uniforme() * n);
+}
+
+/* Desvio aproximadamente normal (soma de 4 uniformes), média 0 e desvio 1 */
+static double normal()
+{
+    return (uniforme() + uniforme() + uniforme() + uniforme() - 2.0) * 1.7320508;
+}
+
+static void uso(const char *prog)
+{
+    fprintf(stderr, "Uso: %s [opções] > entrada.txt\n", prog);
+    fprintf(stderr, "  -n  linhas da arena (padrão: 100)\n");
+    fprintf(stderr, "  -m  colunas da arena (padrão: 100)\n");
+    fprintf(stderr, "  -r  número de robôs (padrão: 1000)\n");
+    fprintf(stderr, "  -x  densidade de pilares, de 0 a 1 (padrão: 0.05)\n");
+    fprintf(stderr, "  -b  densidade de baterias, de 0 a 1 (padrão: 0.02)\n");
+    fprintf(stderr, "  -f  densidade de figuras, de 0 a 1 (padrão: 0.05)\n");
+    fprintf(stderr, "  -s  movimentos na sequência de cada robô (padrão: 100)\n");
+    fprintf(stderr, "  -g  agrupamento dos robôs, de 0 (espalhados) a 1 (aglomerados) (padrão: 0)\n");
+    fprintf(stderr, "  -a  número de aglomerados (padrão: 4)\n");
+    fprintf(stderr, "  -p  energia de uma bateria (padrão: 10)\n");
+    fprintf(stderr, "  -t  número de turnos (padrão: 100)\n");
+    fprintf(stderr, "  -S  semente (padrão: 1)\n");
+}
+
+int main(int argc, char *argv[])
+{
+    long N = 100, M = 100, R = 1000;
+    double dens_pilar = 0.05, dens_bateria = 0.02, dens_figura = 0.05;
+    long tam_sequencia = 100;
+    double agrupamento = 0;
+    int num_aglomerados = 4;
+    int energia = 10, turnos = 100;
+    uint64_t semente = 1;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:m:r:x:b:f:s:g:a:p:t:S:h")) != -1) {
+        switch (opt) {
+            case 'n': N = atol(optarg); break;
+            case 'm': M = atol(optarg); break;
+            case 'r': R = atol(optarg); break;
+            case 'x': dens_pilar = atof(optarg); break;
+            case 'b': dens_bateria = atof(optarg); break;
+            case 'f': dens_figura = atof(optarg); break;
+            case 's': tam_sequencia = atol(optarg); break;
+            case 'g': agrupamento = atof(optarg); break;
+            case 'a': num_aglomerados = atoi(optarg); break;
+            case 'p': energia = atoi(optarg); break;
+            case 't': turnos = atoi(optarg); break;
+            case 'S': semente = strtoull(optarg, NULL, 10); break;
+            default:
+                uso(argv[0]);
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (N < 1 || M < 1 || R < 0 || tam_sequencia < 0 || num_aglomerados < 1 ||
+        dens_pilar + dens_bateria + dens_figura > 1) {
+        uso(argv[0]);
+        return 1;
+    }
+    estado_aleatorio = semente;
+
+    size_t num_celulas = (size_t) N * M;
+    char *arena = (char *) malloc(num_celulas);
+    char *ocupada = (char *) calloc(num_celulas, 1);
+
+    /* Objetos da arena */
+    size_t livres = 0;
+    for (size_t c = 0; c < num_celulas; c++) {
+        double u = uniforme();
+        if (u < dens_pilar)
+            arena[c] = 'x';
+        else if (u < dens_pilar + dens_bateria)
+            arena[c] = 'b';
+        else if (u < dens_pilar + dens_bateria + dens_figura)
+            arena[c] = 'f';
+        else
+            arena[c] = '.';
+        livres += arena[c] != 'x';
+    }
+    if ((size_t) R > livres) {
+        fprintf(stderr, "Há só %zu células sem pilar para %ld robôs\n", livres, R);
+        return 1;
+    }
+
+    /* Centros dos aglomerados e o raio que comporta os robôs de cada um */
+    long *centro = (long *) malloc(sizeof(long) * num_aglomerados * 2);
+    for (int a = 0; a < num_aglomerados; a++) {
+        centro[2 * a] = sorteia(N);
+        centro[2 * a + 1] = sorteia(M);
+    }
+    double raio = sqrt((double) R / num_aglomerados) + 1;
+
+    /* Posições dos robôs: nunca num pilar nem numa célula já ocupada */
+    long *pos = (long *) malloc(sizeof(long) * (R > 0 ? R : 1));
+    for (long r = 0; r < R; r++) {
+        long c = -1;
+        for (int tentativa = 0; tentativa < 32 && c < 0; tentativa++) {
+            long i, j;
+            if (uniforme() < agrupamento) {
+                int a = (int) sorteia(num_aglomerados);
+                i = centro[2 * a] + lround(normal() * raio);
+                j = centro[2 * a + 1] + lround(normal() * raio);
+                if (i < 0 || i >= N || j < 0 || j >= M)
+                    continue;
+            } else {
+                i = sorteia(N);
+                j = sorteia(M);
+            }
+            long k = i * M + j;
+            if (arena[k] != 'x' && !ocupada[k])
+                c = k;
+        }
+        // Arena quase cheia: usa a próxima célula livre a partir de um ponto qualquer
+        if (c < 0) {
+            c = sorteia((long) num_celulas);
+            while (arena[c] == 'x' || ocupada[c])
+                c = (c + 1) % (long) num_celulas;
+        }
+        ocupada[c] = 1;
+        pos[r] = c;
+    }
+
+    /* Escrita da entrada */
+    printf("%ld %ld %ld %d %d\n", N, M, R, energia, turnos);
+    char *linha = (char *) malloc(M + 1);
+    for (long i = 0; i < N; i++) {
+        memcpy(linha, arena + i * M, M);
+        linha[M] = '\n';
+        fwrite(linha, 1, M + 1, stdout);
+    }
+    for (long r = 0; r < R; r++)
+        printf("%ld %ld\n", pos[r] / M, pos[r] % M);
+
+    static const char direcoes[4] = {'N', 'L', 'S', 'O'};
+    char *sequencia = (char *) malloc(tam_sequencia + 1);
+    for (long r = 0; r < R; r++) {
+        for (long k = 0; k < tam_sequencia; k++)
+            sequencia[k] = direcoes[aleatorio() >> 62];
+        sequencia[tam_sequencia] = '\n';
+        printf("%ld ", tam_sequencia);
+        fwrite(sequencia, 1, tam_sequencia + 1, stdout);
+    }
+
+    free(sequencia);
+    free(linha);
+    free(pos);
+    free(centro);
+    free(ocupada);
+    free(arena);
+    return 0;
+}
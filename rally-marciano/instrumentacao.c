@@ -0,0 +1,272 @@
+/*
+ * Instrumentação das travas e das regiões críticas do turno.
+ *
+ * Cada thread acumula seus contadores numa estrutura própria, registrada
+ * na primeira vez que é usada, então o caminho quente não escreve em
+ * nenhuma linha de cache compartilhada. A exceção é o mapa de calor das
+ * células, atualizado com um incremento atômico só quando uma trava de
+ * célula já estava ocupada. Ele fica num diretório (diretorio.h) com as
+ * posições dos ladrilhos da arena, com blocos só onde houve espera.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rally.h"
+#include "instrumentacao.h"
+#include "topologia.h"
+
+#ifdef INSTRUMENTACAO
+
+#include <stdatomic.h>
+
+/* Células mais disputadas listadas no relatório */
+#define NUM_CELULAS_QUENTES 20
+
+__thread ContadoresThread *contadores_thread;
+
+static ContadoresThread *lista_threads;
+static pthread_mutex_t mutex_lista = PTHREAD_MUTEX_INITIALIZER;
+
+/* Esperas por trava de cada célula de um ladrilho */
+typedef struct {
+    atomic_uint celulas[CELULAS_LADRILHO];
+} CalorLadrilho;
+
+static Diretorio calor;  // Esperas de cada ladrilho com alguma
+static size_t ladrilhos_calor;
+
+static const char *nomes_regiao[NUM_REGIOES] = {
+    [REGIAO_REALIZA_MOVIMENTO] = "realiza_movimento",
+    [REGIAO_REALIZA_ROUBO] = "realiza_roubo",
+};
+
+static const char *nomes_trava[NUM_TIPOS_TRAVA] = {
+    [TRAVA_ROBO] = "mutex_robo",
+    [TRAVA_CELULA] = "mutex_celula",
+};
+
+ContadoresThread *instr_registra_thread()
+{
+    ContadoresThread *c = (ContadoresThread *) aligned_alloc(sizeof(ContadoresThread),
+                                                             sizeof(ContadoresThread));
+    memset(c, 0, sizeof(ContadoresThread));
+    pthread_mutex_lock(&mutex_lista);
+    c->prox = lista_threads;
+    lista_threads = c;
+    pthread_mutex_unlock(&mutex_lista);
+    contadores_thread = c;
+    return c;
+}
+
+void instr_celula_contendida(size_t c)
+{
+    size_t posicao = c >> (2 * BITS_LADRILHO);
+    if (posicao >= ladrilhos_calor)
+        return;
+    CalorLadrilho *l = (CalorLadrilho *) diretorio_escrita(&calor, posicao);
+    atomic_fetch_add_explicit(&l->celulas[c & (CELULAS_LADRILHO - 1)], 1, memory_order_relaxed);
+}
+
+/* Esperas pela trava da célula c */
+static unsigned calor_de(size_t c)
+{
+    const CalorLadrilho *l = (const CalorLadrilho *) diretorio_bloco(&calor,
+                                                                     c >> (2 * BITS_LADRILHO));
+    return atomic_load_explicit(&l->celulas[c & (CELULAS_LADRILHO - 1)], memory_order_relaxed);
+}
+
+/* Conta um acesso ao endereço p da arena ou dos robôs como local ou de outro nó */
+void instr_acesso(const void *p)
+{
+    int no = topologia_no_do_endereco(p);
+    if (no < 0)
+        return;
+    ContadoresThread *c = instr_contadores();
+    if (no == topologia_no_atual())
+        c->acessos_locais++;
+    else
+        c->acessos_remotos++;
+}
+
+void instrumentacao_inicia(size_t num_ladrilhos)
+{
+    ladrilhos_calor = num_ladrilhos;
+    diretorio_cria(&calor, num_ladrilhos, sizeof(CalorLadrilho), NULL);
+}
+
+int instrumentacao_compilada()
+{
+    return 1;
+}
+
+/* Soma dos contadores de todas as threads */
+static ContadoresThread soma_threads()
+{
+    ContadoresThread total;
+    memset(&total, 0, sizeof(total));
+    for (ContadoresThread *c = lista_threads; c; c = c->prox) {
+        for (int r = 0; r < NUM_REGIOES; r++) {
+            total.regiao_chamadas[r] += c->regiao_chamadas[r];
+            total.regiao_ns[r] += c->regiao_ns[r];
+        }
+        for (int t = 0; t < NUM_TIPOS_TRAVA; t++) {
+            total.aquisicoes[t] += c->aquisicoes[t];
+            total.contendidas[t] += c->contendidas[t];
+            total.espera_ns[t] += c->espera_ns[t];
+        }
+        total.acessos_locais += c->acessos_locais;
+        total.acessos_remotos += c->acessos_remotos;
+    }
+    return total;
+}
+
+/* Escolhe as n células com mais esperas, em ordem decrescente. Retorna quantas há */
+static int celulas_quentes(size_t *quentes, int n)
+{
+    int achadas = 0;
+    // Só os ladrilhos com alguma espera têm bloco
+    size_t alocados = diretorio_alocados(&calor);
+    for (size_t b = 0; b < alocados; b++) {
+        size_t base = diretorio_posicao_k(&calor, b) << (2 * BITS_LADRILHO);
+        for (size_t c = base; c < base + CELULAS_LADRILHO; c++) {
+            unsigned v = calor_de(c);
+            if (v == 0 || (achadas == n && v <= calor_de(quentes[n - 1])))
+                continue;
+            // Inserção ordenada na lista das n maiores
+            int k = achadas < n ? achadas++ : n - 1;
+            while (k > 0 && calor_de(quentes[k - 1]) < v) {
+                quentes[k] = quentes[k - 1];
+                k--;
+            }
+            quentes[k] = c;
+        }
+    }
+    return achadas;
+}
+
+static void grava_csv(FILE *f, const ContadoresThread *t, const size_t *quentes, int n_quentes)
+{
+    fprintf(f, "categoria,nome,contagem,contendidas,tempo_ns,espera_ns\n");
+    for (int p = 0; p < NUM_SINC; p++)
+        if (barreira_chamadas(&sim->barreiras[p]) > 0)
+            fprintf(f, "etapa,%s,%llu,,%llu,%llu\n", nomes_sinc[p],
+                    (unsigned long long) barreira_chamadas(&sim->barreiras[p]),
+                    (unsigned long long) barreira_tempo_trabalho(&sim->barreiras[p]),
+                    (unsigned long long) barreira_tempo_espera(&sim->barreiras[p]));
+    for (int r = 0; r < NUM_REGIOES; r++)
+        fprintf(f, "regiao,%s,%llu,,%llu,\n", nomes_regiao[r],
+                (unsigned long long) t->regiao_chamadas[r], (unsigned long long) t->regiao_ns[r]);
+    for (int k = 0; k < NUM_TIPOS_TRAVA; k++)
+        fprintf(f, "trava,%s,%llu,%llu,,%llu\n", nomes_trava[k],
+                (unsigned long long) t->aquisicoes[k], (unsigned long long) t->contendidas[k],
+                (unsigned long long) t->espera_ns[k]);
+    fprintf(f, "memoria,acessos_locais,%llu,,,\n", (unsigned long long) t->acessos_locais);
+    fprintf(f, "memoria,acessos_remotos,%llu,,,\n", (unsigned long long) t->acessos_remotos);
+    for (int q = 0; q < n_quentes; q++)
+        fprintf(f, "celula,%zu:%zu,,%u,,\n", (size_t) celula_linha(quentes[q]),
+                (size_t) celula_coluna(quentes[q]), calor_de(quentes[q]));
+}
+
+static void grava_json(FILE *f, const ContadoresThread *t, const size_t *quentes, int n_quentes)
+{
+    const char *sep = "";
+    fprintf(f, "{\n  \"etapas\": [");
+    for (int p = 0; p < NUM_SINC; p++) {
+        if (barreira_chamadas(&sim->barreiras[p]) == 0)
+            continue;
+        fprintf(f, "%s\n    {\"nome\": \"%s\", \"chamadas\": %llu, \"trabalho_ns\": %llu, \"espera_ns\": %llu}",
+                sep, nomes_sinc[p], (unsigned long long) barreira_chamadas(&sim->barreiras[p]),
+                (unsigned long long) barreira_tempo_trabalho(&sim->barreiras[p]),
+                (unsigned long long) barreira_tempo_espera(&sim->barreiras[p]));
+        sep = ",";
+    }
+    fprintf(f, "\n  ],\n  \"regioes\": [");
+    for (int r = 0; r < NUM_REGIOES; r++)
+        fprintf(f, "%s\n    {\"nome\": \"%s\", \"chamadas\": %llu, \"tempo_ns\": %llu}",
+                r ? "," : "", nomes_regiao[r], (unsigned long long) t->regiao_chamadas[r],
+                (unsigned long long) t->regiao_ns[r]);
+    fprintf(f, "\n  ],\n  \"travas\": [");
+    for (int k = 0; k < NUM_TIPOS_TRAVA; k++)
+        fprintf(f, "%s\n    {\"nome\": \"%s\", \"aquisicoes\": %llu, \"contendidas\": %llu, \"espera_ns\": %llu}",
+                k ? "," : "", nomes_trava[k], (unsigned long long) t->aquisicoes[k],
+                (unsigned long long) t->contendidas[k], (unsigned long long) t->espera_ns[k]);
+    fprintf(f, "\n  ],\n  \"memoria\": {\"nos\": %d, \"acessos_locais\": %llu, \"acessos_remotos\": %llu},",
+            topologia_num_nos(), (unsigned long long) t->acessos_locais,
+            (unsigned long long) t->acessos_remotos);
+    fprintf(f, "\n  \"celulas_disputadas\": [");
+    for (int q = 0; q < n_quentes; q++)
+        fprintf(f, "%s\n    {\"i\": %zu, \"j\": %zu, \"esperas\": %u}", q ? "," : "",
+                (size_t) celula_linha(quentes[q]), (size_t) celula_coluna(quentes[q]), calor_de(quentes[q]));
+    fprintf(f, "\n  ]\n}\n");
+}
+
+void instrumentacao_relatorio(const char *arquivo, double segundos)
+{
+    ContadoresThread t = soma_threads();
+    size_t quentes[NUM_CELULAS_QUENTES];
+    int n_quentes = celulas_quentes(quentes, NUM_CELULAS_QUENTES);
+
+    fprintf(stderr, "Instrumentação (%.3f ms):\n", segundos * 1e3);
+    fprintf(stderr, "  região                 chamadas    tempo total        média\n");
+    for (int r = 0; r < NUM_REGIOES; r++)
+        fprintf(stderr, "  %-18s %12llu %11.3f ms %9.1f ns\n", nomes_regiao[r],
+                (unsigned long long) t.regiao_chamadas[r], t.regiao_ns[r] / 1e6,
+                t.regiao_chamadas[r] ? (double) t.regiao_ns[r] / t.regiao_chamadas[r] : 0.0);
+    fprintf(stderr, "  trava                aquisições  contendidas                 espera\n");
+    for (int k = 0; k < NUM_TIPOS_TRAVA; k++)
+        fprintf(stderr, "  %-18s %12llu %12llu %6.2f%% %11.3f ms\n", nomes_trava[k],
+                (unsigned long long) t.aquisicoes[k], (unsigned long long) t.contendidas[k],
+                t.aquisicoes[k] ? 100.0 * t.contendidas[k] / t.aquisicoes[k] : 0.0,
+                t.espera_ns[k] / 1e6);
+    uint64_t acessos = t.acessos_locais + t.acessos_remotos;
+    fprintf(stderr, "  acessos à memória (%d nó%s NUMA): %llu locais, %llu em outro nó (%.2f%%)\n",
+            topologia_num_nos(), topologia_num_nos() > 1 ? "s" : "",
+            (unsigned long long) t.acessos_locais, (unsigned long long) t.acessos_remotos,
+            acessos ? 100.0 * t.acessos_remotos / acessos : 0.0);
+    if (n_quentes > 0) {
+        fprintf(stderr, "  Células mais disputadas (esperas pela trava):");
+        for (int q = 0; q < n_quentes; q++)
+            fprintf(stderr, "%s(%zu, %zu) %u", q % 5 ? "  " : "\n    ",
+                    (size_t) celula_linha(quentes[q]), (size_t) celula_coluna(quentes[q]),
+                    calor_de(quentes[q]));
+        fprintf(stderr, "\n");
+    }
+
+    if (arquivo) {
+        FILE *f = fopen(arquivo, "w");
+        if (!f) {
+            perror(arquivo);
+            return;
+        }
+        size_t tam = strlen(arquivo);
+        if (tam >= 5 && strcmp(arquivo + tam - 5, ".json") == 0)
+            grava_json(f, &t, quentes, n_quentes);
+        else
+            grava_csv(f, &t, quentes, n_quentes);
+        fclose(f);
+    }
+    diretorio_destroi(&calor);
+    ladrilhos_calor = 0;
+}
+
+#else
+
+void instrumentacao_inicia(size_t num_ladrilhos)
+{
+    (void) num_ladrilhos;
+}
+
+void instrumentacao_relatorio(const char *arquivo, double segundos)
+{
+    (void) arquivo;
+    (void) segundos;
+}
+
+int instrumentacao_compilada()
+{
+    return 0;
+}
+
+#endif /*INSTRUMENTACAO*/
@@ -0,0 +1,114 @@
+#ifndef __INSTRUMENTACAO_H__
+#define __INSTRUMENTACAO_H__
+
+/*
+ * Contadores e temporizadores das travas e das regiões críticas do turno.
+ *
+ * Só existem quando o programa é compilado com -DINSTRUMENTACAO (make
+ * INSTRUMENTACAO=1 ou cmake -DRALLY_INSTRUMENTACAO=ON). Sem isso, as
+ * macros abaixo viram chamadas diretas a pthread_mutex_lock ou nada, e
+ * nenhum contador é compilado.
+ */
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Regiões de código temporizadas */
+typedef enum {
+    REGIAO_REALIZA_MOVIMENTO,
+    REGIAO_REALIZA_ROUBO,
+    NUM_REGIOES
+} Regiao;
+
+/* Tipos de trava contabilizados */
+typedef enum {
+    TRAVA_ROBO,     // mutex_robo
+    TRAVA_CELULA,   // mutex_celula (travas listradas da arena)
+    NUM_TIPOS_TRAVA
+} TipoTrava;
+
+/* Prepara o mapa de calor para uma arena com num_ladrilhos posições de ladrilho */
+void instrumentacao_inicia(size_t num_ladrilhos);
+
+/*
+ * Imprime o resumo em stderr e, se 'arquivo' não for NULL, grava os
+ * contadores em CSV ou, se o nome terminar em .json, em JSON
+ */
+void instrumentacao_relatorio(const char *arquivo, double segundos);
+
+/* Indica se o programa foi compilado com a instrumentação */
+int instrumentacao_compilada();
+
+#ifdef INSTRUMENTACAO
+
+#include <time.h>
+
+/* Contadores de uma thread; somados no relatório */
+typedef struct ContadoresThread {
+    uint64_t regiao_chamadas[NUM_REGIOES];
+    uint64_t regiao_ns[NUM_REGIOES];
+    uint64_t aquisicoes[NUM_TIPOS_TRAVA];
+    uint64_t contendidas[NUM_TIPOS_TRAVA];
+    uint64_t espera_ns[NUM_TIPOS_TRAVA];
+    uint64_t acessos_locais;   // Acessos a páginas no nó da CPU da thread
+    uint64_t acessos_remotos;  // Acessos a páginas de outro nó
+    struct ContadoresThread *prox;
+} __attribute__((aligned(64))) ContadoresThread;
+
+extern __thread ContadoresThread *contadores_thread;
+ContadoresThread *instr_registra_thread();
+void instr_celula_contendida(size_t c);
+void instr_acesso(const void *p);
+
+static inline ContadoresThread *instr_contadores()
+{
+    return contadores_thread ? contadores_thread : instr_registra_thread();
+}
+
+static inline uint64_t instr_agora()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* Trava m; se ela já estiver com outra thread, conta a espera como contenção */
+static inline void instr_trava(pthread_mutex_t *m, TipoTrava tipo, size_t celula)
+{
+    ContadoresThread *c = instr_contadores();
+    c->aquisicoes[tipo]++;
+    if (pthread_mutex_trylock(m) == 0)
+        return;
+    uint64_t inicio = instr_agora();
+    pthread_mutex_lock(m);
+    c->contendidas[tipo]++;
+    c->espera_ns[tipo] += instr_agora() - inicio;
+    if (tipo == TRAVA_CELULA)
+        instr_celula_contendida(celula);
+}
+
+static inline void instr_regiao(Regiao r, uint64_t ns)
+{
+    ContadoresThread *c = instr_contadores();
+    c->regiao_chamadas[r]++;
+    c->regiao_ns[r] += ns;
+}
+
+#define trava_robo(m)         instr_trava((m), TRAVA_ROBO, 0)
+#define trava_celula(m, c)    instr_trava((m), TRAVA_CELULA, (c))
+#define INSTR_INICIO(nome)    uint64_t instr_inicio_##nome = instr_agora()
+#define INSTR_FIM(nome, r)    instr_regiao((r), instr_agora() - instr_inicio_##nome)
+#define INSTR_ACESSO(p)       instr_acesso(p)
+
+#else
+
+#define trava_robo(m)         pthread_mutex_lock(m)
+#define trava_celula(m, c)    pthread_mutex_lock(m)
+#define INSTR_INICIO(nome)
+#define INSTR_FIM(nome, r)
+#define INSTR_ACESSO(p)
+
+#endif /*INSTRUMENTACAO*/
+
+#endif /*__INSTRUMENTACAO_H__*/
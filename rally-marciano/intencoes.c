@@ -0,0 +1,138 @@
+/*
+ * Cálculo vetorial das intenções de movimento (intencoes.h).
+ */
+
+#include <pthread.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define INTENCOES_X86
+#endif
+
+#include "rally.h"
+#include "intencoes.h"
+
+/* Código de quem fica parado; os códigos 0 a 3 são os de direcao_codigo */
+#define CODIGO_PARADO 4
+
+/* Deslocamento de cada código, na ordem de direcao_codigo (N, L, S, O) e parado */
+static const int desloc_i[8] = { -1, 0, 1,  0, 0, 0, 0, 0 };
+static const int desloc_j[8] = {  0, 1, 0, -1, 0, 0, 0, 0 };
+
+/* Intenções dos robôs [ini, fim) */
+typedef void (*CalculaIntencoes)(int ini, int fim);
+
+static void intencoes_escalar(int ini, int fim)
+{
+    for (int r = ini; r < fim; r++) {
+        int codigo = CODIGO_PARADO;
+        if (sim->robos.energia[r] > 0 && sim->robos.faltam[r] > 0) {
+            codigo = robo_proximo_codigo(&sim->robos, r);
+            if (codigo < 0)
+                codigo = CODIGO_PARADO;
+        }
+        sim->robos.move_i[r] = sim->robos.i[r] + desloc_i[codigo];
+        sim->robos.move_j[r] = sim->robos.j[r] + desloc_j[codigo];
+    }
+}
+
+#ifdef INTENCOES_X86
+__attribute__((target("avx2")))
+static void intencoes_avx2(int ini, int fim)
+{
+    // As tabelas cabem num registrador; vpermd usa cada código como índice
+    const __m256i tab_i = _mm256_loadu_si256((const __m256i *) desloc_i);
+    const __m256i tab_j = _mm256_loadu_si256((const __m256i *) desloc_j);
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i tres = _mm256_set1_epi32(3);
+    const __m256i parado = _mm256_set1_epi32(CODIGO_PARADO);
+    // Em variáveis locais, os ponteiros não são relidos de robos depois de cada escrita
+    const int *energia_robo = sim->robos.energia;
+    const Coordenada *ri = sim->robos.i, *rj = sim->robos.j;
+    int *falta = sim->robos.faltam, *na_janela = sim->robos.na_janela;
+    uint32_t *janelas = sim->robos.janela;
+    Coordenada *mi = sim->robos.move_i, *mj = sim->robos.move_j;
+    RoboFrio *frio = sim->robos.frio;
+
+    int r = ini;
+    for (; r + 8 <= fim; r += 8) {
+        __m256i energia = _mm256_loadu_si256((const __m256i *) (energia_robo + r));
+        __m256i faltam = _mm256_loadu_si256((const __m256i *) (falta + r));
+        __m256i n = _mm256_loadu_si256((const __m256i *) (na_janela + r));
+        __m256i ativo = _mm256_and_si256(_mm256_cmpgt_epi32(energia, zero),
+                                         _mm256_cmpgt_epi32(faltam, zero));
+
+        // Janelas vazias de robôs ativos: só aqui o robô volta à sequência
+        int vazias = _mm256_movemask_ps(_mm256_castsi256_ps(
+            _mm256_and_si256(ativo, _mm256_cmpeq_epi32(n, zero))));
+        if (vazias) {
+            do {
+                int k = r + __builtin_ctz(vazias);
+                vazias &= vazias - 1;
+                sequencia_recarrega(frio[k].sequencia_movimentos, &frio[k].cursor, &janelas[k],
+                                    &na_janela[k]);
+                // A leitura de uma janela avança 4 bytes: traz a linha de algumas janelas adiante
+                __builtin_prefetch(frio[k].sequencia_movimentos + frio[k].cursor.pos + 64);
+            } while (vazias);
+            n = _mm256_loadu_si256((const __m256i *) (na_janela + r));
+        }
+        __m256i janela = _mm256_loadu_si256((const __m256i *) (janelas + r));
+
+        // Com janela positiva, o código é o do par de bits mais baixo, e a janela gira 2 bits
+        __m256i usa_janela = _mm256_and_si256(ativo, _mm256_cmpgt_epi32(n, zero));
+        __m256i fica_parado = _mm256_and_si256(ativo, _mm256_cmpgt_epi32(zero, n));
+        __m256i codigo = _mm256_blendv_epi8(parado, _mm256_and_si256(janela, tres), usa_janela);
+        __m256i girada = _mm256_or_si256(_mm256_srli_epi32(janela, 2), _mm256_slli_epi32(janela, 30));
+
+        // As máscaras valem -1: somá-las conta um movimento
+        _mm256_storeu_si256((__m256i *) (janelas + r),
+                            _mm256_blendv_epi8(janela, girada, usa_janela));
+        _mm256_storeu_si256((__m256i *) (na_janela + r),
+                            _mm256_sub_epi32(_mm256_add_epi32(n, usa_janela), fica_parado));
+        _mm256_storeu_si256((__m256i *) (falta + r), _mm256_add_epi32(faltam, ativo));
+
+        // Os deslocamentos saem em 32 bits e são estendidos para as coordenadas de 64
+        __m256i d_i = _mm256_permutevar8x32_epi32(tab_i, codigo);
+        __m256i d_j = _mm256_permutevar8x32_epi32(tab_j, codigo);
+        for (int h = 0; h < 2; h++) {
+            __m256i di = _mm256_cvtepi32_epi64(h ? _mm256_extracti128_si256(d_i, 1)
+                                                 : _mm256_castsi256_si128(d_i));
+            __m256i dj = _mm256_cvtepi32_epi64(h ? _mm256_extracti128_si256(d_j, 1)
+                                                 : _mm256_castsi256_si128(d_j));
+            __m256i i = _mm256_loadu_si256((const __m256i *) (ri + r + 4 * h));
+            __m256i j = _mm256_loadu_si256((const __m256i *) (rj + r + 4 * h));
+            _mm256_storeu_si256((__m256i *) (mi + r + 4 * h), _mm256_add_epi64(i, di));
+            _mm256_storeu_si256((__m256i *) (mj + r + 4 * h), _mm256_add_epi64(j, dj));
+        }
+    }
+    if (r < fim)
+        intencoes_escalar(r, fim);
+}
+#endif
+
+static pthread_once_t implementacao_escolhida = PTHREAD_ONCE_INIT;
+static CalculaIntencoes calcula = intencoes_escalar;
+static const char *nome_implementacao = "escalar";
+
+static void escolhe_implementacao()
+{
+#ifdef INTENCOES_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        calcula = intencoes_avx2;
+        nome_implementacao = "avx2";
+    }
+#endif
+}
+
+const char *intencoes_implementacao()
+{
+    pthread_once(&implementacao_escolhida, escolhe_implementacao);
+    return nome_implementacao;
+}
+
+void calcula_intencoes(int ini, int fim)
+{
+    pthread_once(&implementacao_escolhida, escolhe_implementacao);
+    calcula(ini, fim);
+}
@@ -0,0 +1,31 @@
+#ifndef __INTENCOES_H__
+#define __INTENCOES_H__
+
+/*
+ * Cálculo das intenções de movimento de uma faixa contígua de robôs.
+ *
+ * Em vez de um switch por robô, como em calcula_movimento, a faixa é
+ * percorrida só pelos vetores quentes de Robos: energia, movimentos que
+ * faltam, a janela de códigos já lidos da sequência (sequencia_recarrega)
+ * e a posição. Com AVX2, 8 robôs por vez: o próximo código sai dos 2
+ * bits mais baixos da janela, que gira, e move_i e move_j saem de uma
+ * tabela de deslocamentos indexada pelo código (vpermd), somada a i e j.
+ *
+ * Só quando a janela de um robô ativo acaba o robô volta à sequência
+ * compactada, no cursor frio, e lê a próxima janela: até 16 movimentos
+ * de um bloco literal, ou um bloco de repetição inteiro. Sem AVX2, o
+ * mesmo cálculo é feito robô a robô. A implementação é escolhida uma
+ * vez, em tempo de execução, pelo que a CPU suporta.
+ */
+
+/*
+ * Calcula move_i e move_j dos robôs [ini, fim) e avança a sequência dos
+ * que têm energia e movimentos restantes; os demais ficam onde estão. O
+ * resultado é o de chamar calcula_movimento para cada robô com energia.
+ */
+void calcula_intencoes(int ini, int fim);
+
+/* Nome da implementação em uso: "avx2" ou "escalar" */
+const char *intencoes_implementacao();
+
+#endif /*__INTENCOES_H__*/
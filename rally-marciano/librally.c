@@ -0,0 +1,176 @@
+/*
+ * librally: contextos de simulação sobre os motores (librally.h).
+ *
+ * Os motores trabalham sobre a simulação apontada por sim (rally.h). Cada
+ * contexto tem a sua Simulacao, com a arena, os robôs, os parâmetros e o
+ * estado dos motores; rally_cria e rally_passo apontam sim para ela
+ * durante a chamada, e os trabalhadores criados herdam o apontamento.
+ * Assim contextos diferentes executam ao mesmo tempo sem compartilhar
+ * estado, e as consultas leem só o contexto.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "rally.h"
+#include "librally.h"
+
+struct RallyContexto {
+    Simulacao sim;
+    int turno;              // Turnos já executados
+    int num_turnos;         // Número total de turnos da entrada
+};
+
+static RallyContexto *cria(const char *entrada, size_t tam, int fd, const char *nome_motor,
+                           int trabalhadores)
+{
+    Motor m = MOTOR_PLANO;
+    if (nome_motor && !motor_de_nome(nome_motor, &m)) {
+        fprintf(stderr, "Motor desconhecido: %s\n", nome_motor);
+        return NULL;
+    }
+
+    // Sem quadros, checkpoint nem diferencial
+    RallyContexto *ctx = (RallyContexto *) calloc(1, sizeof(RallyContexto));
+    ctx->sim.motor = m;
+    ctx->sim.num_trabalhadores = trabalhadores >= 1 ? trabalhadores :
+                                 (int) sysconf(_SC_NPROCESSORS_ONLN);
+    ctx->sim.tipo_barreira = BARREIRA_CONDVAR;
+    ctx->sim.sem_saida = 1;
+
+    Simulacao *anterior = sim;
+    sim = &ctx->sim;
+    int ok = fd >= 0 ? le_entrada_fd(fd) : le_entrada_dados(entrada, tam);
+    if (ok)
+        for (int r = 0; r < sim->num_robos; r++)
+            pthread_mutex_init(&sim->robos.travas[r].mutex, NULL);
+    sim = anterior;
+
+    if (!ok) {
+        free(ctx);
+        return NULL;
+    }
+    ctx->num_turnos = ctx->sim.num_total_turnos;
+    return ctx;
+}
+
+RallyContexto *rally_cria(const char *entrada, size_t tam, const char *motor, int trabalhadores)
+{
+    return cria(entrada, tam, -1, motor, trabalhadores);
+}
+
+RallyContexto *rally_cria_arquivo(const char *caminho, const char *motor, int trabalhadores)
+{
+    int fd = open(caminho, O_RDONLY);
+    if (fd < 0) {
+        perror(caminho);
+        return NULL;
+    }
+    RallyContexto *ctx = cria(NULL, 0, fd, motor, trabalhadores);
+    close(fd);
+    return ctx;
+}
+
+int rally_passo(RallyContexto *ctx, int turnos)
+{
+    int restantes = ctx->num_turnos - ctx->turno;
+    if (turnos <= 0 || restantes <= 0)
+        return 0;
+    if (turnos > restantes)
+        turnos = restantes;
+
+    // Os motores executam [turno_inicial, num_total_turnos), como ao retomar um checkpoint
+    Simulacao *anterior = sim;
+    sim = &ctx->sim;
+    sim->turno_inicial = ctx->turno;
+    sim->num_total_turnos = ctx->turno + turnos;
+    sim->turnos_adiantados = 0;
+    executa_motor();
+    destroi_barreiras();
+    sim = anterior;
+
+    ctx->turno += turnos;
+    return turnos;
+}
+
+int rally_turno(const RallyContexto *ctx)
+{
+    return ctx->turno;
+}
+
+int rally_num_turnos(const RallyContexto *ctx)
+{
+    return ctx->num_turnos;
+}
+
+int64_t rally_linhas(const RallyContexto *ctx)
+{
+    return ctx->sim.arena.n_lins;
+}
+
+int64_t rally_colunas(const RallyContexto *ctx)
+{
+    return ctx->sim.arena.n_cols;
+}
+
+int rally_num_robos(const RallyContexto *ctx)
+{
+    return ctx->sim.num_robos;
+}
+
+int rally_robo(const RallyContexto *ctx, int r, RallyRobo *robo)
+{
+    if (r < 0 || r >= ctx->sim.num_robos)
+        return 0;
+    const RoboFrio *frio = &ctx->sim.robos.frio[r];
+    robo->linha = ctx->sim.robos.i[r];
+    robo->coluna = ctx->sim.robos.j[r];
+    robo->energia = ctx->sim.robos.energia[r];
+    robo->figuras = frio->figuras_coletadas;
+    robo->movimento = robo_movimento(&ctx->sim.robos, r);
+    robo->tamanho_sequencia = frio->tamanho_sequencia;
+    return 1;
+}
+
+/* Ladrilho da célula (i, j) do contexto em *l e índice dela no ladrilho. Retorna 0 fora da arena */
+static int localiza_celula(const RallyContexto *ctx, int64_t i, int64_t j, const Ladrilho **l,
+                           size_t *k)
+{
+    if (i < 0 || i >= ctx->sim.arena.n_lins || j < 0 || j >= ctx->sim.arena.n_cols)
+        return 0;
+    size_t c = celula_em(&ctx->sim.arena, i, j);
+    *l = ladrilho_em(&ctx->sim.arena, c);
+    *k = c & (CELULAS_LADRILHO - 1);
+    return 1;
+}
+
+char rally_objeto(const RallyContexto *ctx, int64_t i, int64_t j)
+{
+    const Ladrilho *l;
+    size_t k;
+    if (!localiza_celula(ctx, i, j, &l, &k))
+        return '\0';
+    return l->obj[k];
+}
+
+int rally_ocupante(const RallyContexto *ctx, int64_t i, int64_t j)
+{
+    const Ladrilho *l;
+    size_t k;
+    if (!localiza_celula(ctx, i, j, &l, &k))
+        return -1;
+    return l->id[k];
+}
+
+void rally_destroi(RallyContexto *ctx)
+{
+    if (!ctx)
+        return;
+    destroi_arena(&ctx->sim.arena);
+    destroi_robos(&ctx->sim.robos, ctx->sim.num_robos);
+    free(ctx);
+}
@@ -0,0 +1,73 @@
+#ifndef __LIBRALLY_H__
+#define __LIBRALLY_H__
+
+/*
+ * librally: a simulação do Rally dos Robôs em Marte como biblioteca.
+ *
+ * Cada simulação é um contexto opaco, criado a partir de uma entrada no
+ * formato de rally_marciano (em memória ou num arquivo) e avançado com
+ * rally_passo, sem quadros nem saída em stdout. As consultas leem o
+ * estado do contexto entre os passos.
+ *
+ * Vários contextos podem existir no mesmo processo e ser usados de
+ * threads diferentes; cada um guarda o próprio estado, inclusive o dos
+ * motores, então rally_cria e rally_passo de contextos diferentes
+ * executam ao mesmo tempo, cada passo com os trabalhadores do seu
+ * contexto. Um mesmo contexto não deve ser usado por duas threads ao
+ * mesmo tempo. Só os nomes rally_* são exportados pela biblioteca.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct RallyContexto RallyContexto;
+
+/* Estado de um robô entre os turnos */
+typedef struct {
+    int64_t linha;
+    int64_t coluna;
+    int energia;
+    int figuras;            // Figuras coletadas
+    int movimento;          // Índice do próximo movimento da sequência
+    int tamanho_sequencia;  // Número total de movimentos programados
+} RallyRobo;
+
+/*
+ * Cria um contexto com a entrada em entrada[0, tam). 'motor' é um dos
+ * nomes de -e (NULL: plano) e 'trabalhadores' o de -w (menor que 1: os
+ * núcleos online). Retorna NULL, com o motivo em stderr, se a entrada ou
+ * o motor forem inválidos.
+ */
+RallyContexto *rally_cria(const char *entrada, size_t tam, const char *motor, int trabalhadores);
+
+/* Como rally_cria, com a entrada lida do arquivo */
+RallyContexto *rally_cria_arquivo(const char *caminho, const char *motor, int trabalhadores);
+
+/*
+ * Executa até 'turnos' turnos, sem passar do número de turnos da entrada.
+ * Retorna quantos foram executados (0 quando a simulação já terminou).
+ */
+int rally_passo(RallyContexto *ctx, int turnos);
+
+/* Turno atual (os executados até agora) e número total de turnos */
+int rally_turno(const RallyContexto *ctx);
+int rally_num_turnos(const RallyContexto *ctx);
+
+/* Dimensões da arena e número de robôs */
+int64_t rally_linhas(const RallyContexto *ctx);
+int64_t rally_colunas(const RallyContexto *ctx);
+int rally_num_robos(const RallyContexto *ctx);
+
+/* Preenche o estado do robô r. Retorna 0 se r não existe */
+int rally_robo(const RallyContexto *ctx, int r, RallyRobo *robo);
+
+/* Objeto da célula (i, j) ('.', 'x', 'b' ou 'f'), ou '\0' fora da arena */
+char rally_objeto(const RallyContexto *ctx, int64_t i, int64_t j);
+
+/* Robô na célula (i, j), ou -1 se ela estiver vazia ou fora da arena */
+int rally_ocupante(const RallyContexto *ctx, int64_t i, int64_t j);
+
+/* Libera o contexto e todo o seu estado */
+void rally_destroi(RallyContexto *ctx);
+
+#endif /*__LIBRALLY_H__*/
@@ -0,0 +1,286 @@
+/*
+ * Interface de linha de comando do Rally dos Robôs em Marte.
+ *
+ * Lê as opções, a entrada (ou o checkpoint) e executa a simulação com o
+ * motor escolhido, imprimindo os quadros, os resultados e as medições.
+ * A simulação em si está em librally (rally_marciano.c e os motores);
+ * librally.h a expõe para uso embutido, sem esta interface.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <time.h>
+
+#include "rally.h"
+#include "renderizador.h"
+#include "checkpoint.h"
+#include "referencia.h"
+#include "instrumentacao.h"
+#include "lote.h"
+#include "topologia.h"
+#include "eventos.h"
+#include "escalonador.h"
+#include "intencoes.h"
+
+ModoQuadro modo_quadro = QUADRO_COMPLETO;  // Forma de imprimir cada turno
+int intervalo_quadros = 1;  // Imprime um quadro a cada intervalo_quadros turnos
+
+/* Imprime o nome alinhado em 'largura' colunas (os nomes têm acentos em UTF-8) */
+static void imprime_nome_etapa(const char *nome, int largura)
+{
+    int colunas = 0;
+    for (const char *c = nome; *c; c++)
+        if ((*c & 0xC0) != 0x80)
+            colunas++;
+    fprintf(stderr, "  %s%*s", nome, largura - colunas, "");
+}
+
+/*
+ * Imprime em stderr, para cada etapa do turno, o tempo gasto na etapa e
+ * esperando na barreira que a encerra, e a vazão da simulação
+ */
+void imprime_tempos_barreiras(double segundos)
+{
+    int n = sim->barreiras[0].num_threads;
+    int turnos = sim->num_total_turnos - sim->turno_inicial;
+    double total_trabalho = 0, total_espera = 0;
+
+    fprintf(stderr, "Sincronização: barreira %s, %d threads, %d turnos, %.3f ms\n",
+            barreira_nome(sim->barreiras[0].tipo), n, turnos, segundos * 1e3);
+    imprime_nome_etapa("etapa", 10);
+    fprintf(stderr, " %13s %13s  %6s  %13s\n", "trabalho", "espera", "espera", "espera/turno");
+    for (int p = 0; p < NUM_SINC; p++) {
+        // Cada motor usa só alguns dos pontos de sincronização
+        if (barreira_chamadas(&sim->barreiras[p]) == 0)
+            continue;
+        // Média por thread: cada thread trabalha e espera em paralelo com as demais
+        double trabalho = barreira_tempo_trabalho(&sim->barreiras[p]) / 1e9 / n;
+        double espera = barreira_tempo_espera(&sim->barreiras[p]) / 1e9 / n;
+        total_trabalho += trabalho;
+        total_espera += espera;
+        imprime_nome_etapa(nomes_sinc[p], 10);
+        fprintf(stderr, " %10.3f ms %10.3f ms  %5.1f%%  %10.2f us\n", trabalho * 1e3, espera * 1e3, segundos > 0 ? 100.0 * espera / segundos : 0.0,
+                turnos > 0 ? espera * 1e6 / turnos : 0.0);
+    }
+    imprime_nome_etapa("total", 10);
+    fprintf(stderr, " %10.3f ms %10.3f ms  %5.1f%%\n", total_trabalho * 1e3,
+            total_espera * 1e3, segundos > 0 ? 100.0 * total_espera / segundos : 0.0);
+
+    double robo_turnos = (double) turnos * sim->num_robos;
+    fprintf(stderr, "Vazão: %.1f turnos/s, %.1f ns por robô-turno\n",
+            segundos > 0 ? turnos / segundos : 0.0,
+            robo_turnos > 0 ? segundos * 1e9 / robo_turnos : 0.0);
+    if (sim->turnos_adiantados > 0)
+        fprintf(stderr, "Sem robôs ativos: %d turnos finais adiantados\n", sim->turnos_adiantados);
+    if (sim->motor == MOTOR_PLANO || sim->motor == MOTOR_BLOCOS || sim->motor == MOTOR_OMP)
+        fprintf(stderr, "Intenções de movimento: %s\n", intencoes_implementacao());
+    if (sim->motor == MOTOR_POOL)
+        fprintf(stderr, "Roubo de trabalho: %ld pedaços de %d robôs roubados\n",
+                escalonador_roubados(), ROBOS_POR_PEDACO);
+}
+
+/* Imprime as opções de linha de comando */
+void uso(const char *prog)
+{
+#ifdef _OPENMP
+    const char *motores = "threads|pool|plano|blocos|sequencial|omp";
+#else
+    const char *motores = "threads|pool|plano|blocos|sequencial";
+#endif
+    fprintf(stderr, "Uso: %s [-e %s] [-w trabalhadores] [-b barreira] [-T] [-k k] [-d] [-q] [-D] [-I arquivo] [-c arquivo [-C n]] [-r arquivo] [-L lote] [-N] [-E arquivo] < entrada.txt\n", prog, motores);
+    fprintf(stderr, "  -e  motor de execução (padrão: threads, uma thread por robô)\n");
+    fprintf(stderr, "  -w  número de trabalhadores dos motores pool, plano, blocos e omp (padrão: núcleos online)\n");
+    fprintf(stderr, "  -b  barreira: condvar (padrão), central, disseminacao ou pthread\n");
+    fprintf(stderr, "  -T  imprime em stderr o tempo de espera em cada barreira do turno\n");
+    fprintf(stderr, "  -k  imprime só um quadro a cada k turnos (o último é sempre impresso)\n");
+    fprintf(stderr, "  -d  imprime só as células alteradas desde o quadro anterior\n");
+    fprintf(stderr, "  -q  não imprime os quadros nem os resultados (medições com -T)\n");
+    fprintf(stderr, "  -D  confere o estado no início de cada turno com o motor sequencial de referência\n");
+    fprintf(stderr, "  -I  grava os contadores da instrumentação em CSV (ou JSON, se terminar em .json)\n");
+    fprintf(stderr, "  -c  grava um checkpoint da simulação no arquivo\n");
+    fprintf(stderr, "  -C  intervalo em turnos entre checkpoints (padrão: %d)\n", PERIODO_CHECKPOINT);
+    fprintf(stderr, "  -r  retoma a simulação do checkpoint no arquivo, sem ler a entrada\n");
+    fprintf(stderr, "  -L  executa os cenários do arquivo de lote sobre a entrada, até -w ao mesmo tempo\n");
+    fprintf(stderr, "  -E  grava os movimentos e roubos de cada turno no arquivo binário (motores plano, blocos e omp)\n");
+    fprintf(stderr, "  -N  fixa os trabalhadores em CPUs e põe a parte de cada um da arena e dos robôs no seu nó NUMA\n");
+}
+
+int main(int argc, char *argv[])
+{
+    sim->num_trabalhadores = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    sim->saida = stdout;
+
+    const char *arquivo_checkpoint = NULL;
+    const char *arquivo_retomada = NULL;
+    const char *arquivo_instrumentacao = NULL;
+    const char *arquivo_lote = NULL;
+    const char *arquivo_eventos = NULL;
+    int periodo_checkpoint = PERIODO_CHECKPOINT;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "e:w:b:Tk:dqDI:c:C:r:L:NE:h")) != -1) {
+        switch (opt) {
+            case 'e':
+                if (!motor_de_nome(optarg, &sim->motor)) {
+                    uso(argv[0]);
+                    return 1;
+                }
+                break;
+            case 'w':
+                sim->num_trabalhadores = atoi(optarg);
+                if (sim->num_trabalhadores < 1) {
+                    uso(argv[0]);
+                    return 1;
+                }
+                break;
+            case 'b':
+                if (!barreira_tipo_de_nome(optarg, &sim->tipo_barreira)) {
+                    uso(argv[0]);
+                    return 1;
+                }
+                break;
+            case 'T':
+                sim->mostra_tempos = 1;
+                break;
+            case 'k':
+                intervalo_quadros = atoi(optarg);
+                if (intervalo_quadros < 1) {
+                    uso(argv[0]);
+                    return 1;
+                }
+                break;
+            case 'd':
+                modo_quadro = QUADRO_ALTERACOES;
+                break;
+            case 'q':
+                sim->sem_saida = 1;
+                break;
+            case 'D':
+                sim->diferencial = 1;
+                break;
+            case 'I':
+                arquivo_instrumentacao = optarg;
+                break;
+            case 'c':
+                arquivo_checkpoint = optarg;
+                break;
+            case 'C':
+                periodo_checkpoint = atoi(optarg);
+                if (periodo_checkpoint < 1) {
+                    uso(argv[0]);
+                    return 1;
+                }
+                break;
+            case 'r':
+                arquivo_retomada = optarg;
+                break;
+            case 'L':
+                arquivo_lote = optarg;
+                break;
+            case 'N':
+                modo_numa = 1;
+                break;
+            case 'E':
+                arquivo_eventos = optarg;
+                break;
+            default:
+                uso(argv[0]);
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+
+    // Um lote sempre parte da entrada, os cenários gravariam no mesmo checkpoint, e as
+    // arenas deles compartilham a reserva de ladrilhos da base, que -N redistribuiria
+    if (arquivo_lote && (arquivo_checkpoint || arquivo_retomada || arquivo_eventos || modo_numa)) {
+        fprintf(stderr, "-L não pode ser usado com -c, -r, -E ou -N\n");
+        return 1;
+    }
+
+    /* Leitura da entrada (ou do checkpoint) e inicialização da arena e dos robôs */
+    if (arquivo_retomada)
+        sim->turno_inicial = checkpoint_restaura(arquivo_retomada);
+    else
+        le_entrada();
+    if (arquivo_checkpoint)
+        checkpoint_configura(arquivo_checkpoint, periodo_checkpoint);
+
+    // Na versão instrumentada as barreiras sempre medem o tempo de cada etapa
+    if (instrumentacao_compilada())
+        sim->mostra_tempos = 1;
+    else if (arquivo_instrumentacao)
+        fprintf(stderr, "-I ignorado: compile com INSTRUMENTACAO=1 para ter os contadores\n");
+    instrumentacao_inicia(sim->arena.num_ladrilhos);
+
+    for (int i = 0; i < sim->num_robos; i++) {
+        pthread_mutex_init(&sim->robos.travas[i].mutex, NULL);
+    }
+
+    struct timespec inicio, fim;
+    double segundos;
+
+    // No modo lote a simulação lida é só a base dos cenários, que imprimem a própria saída
+    if (arquivo_lote) {
+        clock_gettime(CLOCK_MONOTONIC, &inicio);
+        int codigo = executa_lote(arquivo_lote, modo_quadro, intervalo_quadros);
+        clock_gettime(CLOCK_MONOTONIC, &fim);
+        segundos = (fim.tv_sec - inicio.tv_sec) + (fim.tv_nsec - inicio.tv_nsec) / 1e9;
+        if (instrumentacao_compilada())
+            instrumentacao_relatorio(arquivo_instrumentacao, segundos);
+        destroi_arena(&sim->arena);
+        destroi_robos(&sim->robos, sim->num_robos);
+        return codigo;
+    }
+
+    if (!sim->sem_saida)
+        renderizador_inicia(sim->arena.n_lins, sim->arena.n_cols, sim->num_robos, modo_quadro,
+                            intervalo_quadros, STDOUT_FILENO);
+
+    // Só os motores plano, blocos e omp registram os eventos
+    if (arquivo_eventos && sim->motor != MOTOR_PLANO && sim->motor != MOTOR_BLOCOS && sim->motor != MOTOR_OMP)
+        fprintf(stderr, "-E ignorado: só os motores plano, blocos e omp registram eventos\n");
+    else if (arquivo_eventos)
+        eventos_inicia(arquivo_eventos);
+
+    clock_gettime(CLOCK_MONOTONIC, &inicio);
+
+    executa_motor();
+
+    clock_gettime(CLOCK_MONOTONIC, &fim);
+    segundos = (fim.tv_sec - inicio.tv_sec) + (fim.tv_nsec - inicio.tv_nsec) / 1e9;
+    if (sim->mostra_tempos)
+        imprime_tempos_barreiras(segundos);
+    if (instrumentacao_compilada())
+        instrumentacao_relatorio(arquivo_instrumentacao, segundos);
+    destroi_barreiras();
+    checkpoint_finaliza();
+    eventos_finaliza();
+    int divergiu = sim->diferencial && !diferencial_finaliza();
+
+    /* Imprime os resultados da simulação */
+    if (!sim->sem_saida) {
+        renderizador_quadro(sim->num_total_turnos, arena_copia, 1);
+        renderizador_finaliza();
+        imprime_resultados();
+    }
+
+    /* Liberação de memória alocada */
+    destroi_arena(&sim->arena);
+    destroi_robos(&sim->robos, sim->num_robos);
+
+    return divergiu ? 2 : 0;
+}
+
+void imprime_resultados()
+{
+    for (int i = 0; i < sim->num_robos; i++)
+    {
+        fprintf(sim->saida, "Robô %d:\n", sim->robos.frio[i].id);
+        fprintf(sim->saida, "  Figuras coletadas: %d\n", sim->robos.frio[i].figuras_coletadas);
+        fprintf(sim->saida, "  Energia restante: %d\n", sim->robos.energia[i]);
+        fprintf(sim->saida, "  Posição final: (%lld, %lld)\n", (long long) sim->robos.i[i],
+                (long long) sim->robos.j[i]);
+    }
+}
@@ -0,0 +1,260 @@
+/*
+ * Modo lote: vários cenários sobre uma única leitura da entrada.
+ *
+ * A entrada é lida uma vez, na simulação do programa, que serve de base
+ * e não muda mais. Cada cenário é uma Simulacao própria no mesmo
+ * processo: a arena dele é uma cópia da base (cria_arena_copia), que
+ * compartilha os ladrilhos da base até a primeira escrita em cada um,
+ * então a disposição dos pilares e as células que o cenário não altera
+ * nunca são copiadas; os robôs são copiados com as sequências de
+ * movimentos compartilhadas. Os cenários são escalonados com as filas de
+ * escalonador.h, um por pedaço, entre num_trabalhadores threads, e cada
+ * um executa com um único trabalhador na thread que o pegou.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <time.h>
+
+#include "rally.h"
+#include "lote.h"
+#include "escalonador.h"
+#include "referencia.h"
+
+typedef struct {
+    char *saida;   // Arquivo da saída do cenário, ou NULL para descartá-la
+    int energia;   // Energia de uma bateria, ou -1 para manter a da entrada
+    int turnos;    // Número de turnos, ou -1 para manter o da entrada
+    char *robos;   // Arquivo com os robôs do cenário, ou NULL
+} Cenario;
+
+/* Lote em execução, compartilhado pelas threads */
+typedef struct {
+    Cenario *cenarios;
+    const Simulacao *base;  // Simulação lida da entrada
+    struct EstadoEscalonador *filas;
+    ModoQuadro modo;
+    int intervalo;
+    atomic_int falhas;
+} Lote;
+
+static Lote lote;
+
+static void lote_invalido(const char *arquivo, int linha, const char *msg)
+{
+    fprintf(stderr, "%s:%d: %s\n", arquivo, linha, msg);
+    exit(1);
+}
+
+/* Lê um campo numérico do lote: "-" vale -1 */
+static int campo_numero(const char *campo, int *v)
+{
+    if (strcmp(campo, "-") == 0) {
+        *v = -1;
+        return 1;
+    }
+    char *fim;
+    long x = strtol(campo, &fim, 10);
+    if (*campo == '\0' || *fim != '\0' || x < 0 || x > 0x7fffffffL)
+        return 0;
+    *v = (int) x;
+    return 1;
+}
+
+static Cenario *le_lote(const char *arquivo, int *num_cenarios)
+{
+    FILE *f = fopen(arquivo, "r");
+    if (!f) {
+        perror(arquivo);
+        exit(1);
+    }
+
+    Cenario *cenarios = NULL;
+    int n = 0, cap = 0;
+    char *linha = NULL;
+    size_t tam_linha = 0;
+    for (int num_linha = 1; getline(&linha, &tam_linha, f) >= 0; num_linha++) {
+        char *resto;
+        char *campos[5];
+        int num_campos = 0;
+        for (char *c = strtok_r(linha, " \t\r\n", &resto); c && num_campos < 5;
+             c = strtok_r(NULL, " \t\r\n", &resto))
+            campos[num_campos++] = c;
+        if (num_campos == 0 || campos[0][0] == '#')
+            continue;
+        if (num_campos < 3 || num_campos > 4)
+            lote_invalido(arquivo, num_linha, "esperado: saida energia turnos [robos]");
+
+        if (n == cap) {
+            cap = cap ? cap * 2 : 16;
+            cenarios = (Cenario *) realloc(cenarios, sizeof(Cenario) * cap);
+        }
+        Cenario *c = &cenarios[n++];
+        memset(c, 0, sizeof(Cenario));
+        if (!campo_numero(campos[1], &c->energia))
+            lote_invalido(arquivo, num_linha, "energia inválida");
+        if (!campo_numero(campos[2], &c->turnos))
+            lote_invalido(arquivo, num_linha, "número de turnos inválido");
+        c->saida = strcmp(campos[0], "-") == 0 ? NULL : strdup(campos[0]);
+        c->robos = num_campos == 4 ? strdup(campos[3]) : NULL;
+    }
+    free(linha);
+    fclose(f);
+
+    *num_cenarios = n;
+    return cenarios;
+}
+
+static double segundos_desde(const struct timespec *inicio)
+{
+    struct timespec agora;
+    clock_gettime(CLOCK_MONOTONIC, &agora);
+    return (agora.tv_sec - inicio->tv_sec) + (agora.tv_nsec - inicio->tv_nsec) / 1e9;
+}
+
+/* Simulação do cenário sobre a base: parâmetros, arena e robôs. Retorna 0 se os robôs forem inválidos */
+static int monta_cenario(Simulacao *s, const Cenario *c)
+{
+    const Simulacao *base = lote.base;
+    s->num_total_turnos = c->turnos >= 0 ? c->turnos : base->num_total_turnos;
+    s->energia_bateria = c->energia >= 0 ? c->energia : base->energia_bateria;
+    s->motor = base->motor;
+    s->tipo_barreira = base->tipo_barreira;
+    s->mostra_tempos = base->mostra_tempos;
+    s->diferencial = base->diferencial;
+    s->sem_saida = base->sem_saida || !c->saida;
+    // O paralelismo do lote está nos cenários
+    s->num_trabalhadores = 1;
+
+    cria_arena_copia(&s->arena, &base->arena);
+    if (c->robos) {
+        // Os robôs da entrada saem da cópia da arena
+        for (int r = 0; r < base->num_robos; r++)
+            arena_poe_id(celula(base->robos.i[r], base->robos.j[r]), -1);
+        if (!le_robos(c->robos))
+            return 0;
+    } else {
+        copia_robos(&s->robos, &base->robos, base->num_robos);
+        s->num_robos = base->num_robos;
+        size_t n = s->num_robos > 0 ? (size_t) s->num_robos : 1;
+        s->robos.travas = (TravaRobo *) aligned_alloc(sizeof(TravaRobo), n * sizeof(TravaRobo));
+        if (c->energia >= 0)
+            for (int r = 0; r < s->num_robos; r++)
+                s->robos.energia[r] = s->energia_bateria;
+    }
+    for (int r = 0; r < s->num_robos; r++)
+        pthread_mutex_init(&s->robos.travas[r].mutex, NULL);
+    return 1;
+}
+
+/* Executa o cenário k numa simulação própria, apontada por sim durante a execução */
+static void executa_cenario(int k)
+{
+    const Cenario *c = &lote.cenarios[k];
+    const char *nome = c->saida ? c->saida : "-";
+    Simulacao *s = (Simulacao *) calloc(1, sizeof(Simulacao));
+    Simulacao *anterior = sim;
+    sim = s;
+
+    struct timespec inicio;
+    clock_gettime(CLOCK_MONOTONIC, &inicio);
+    int ok = monta_cenario(s, c);
+    int montado = ok;
+    if (ok && !s->sem_saida) {
+        s->saida = fopen(c->saida, "w");
+        if (!s->saida) {
+            perror(c->saida);
+            ok = 0;
+        }
+    }
+
+    if (ok) {
+        if (!s->sem_saida)
+            renderizador_inicia(s->arena.n_lins, s->arena.n_cols, s->num_robos, lote.modo,
+                                lote.intervalo, fileno(s->saida));
+        struct timespec inicio_motor;
+        clock_gettime(CLOCK_MONOTONIC, &inicio_motor);
+        executa_motor();
+        if (s->mostra_tempos) {
+            // As tabelas dos cenários não se misturam em stderr
+            flockfile(stderr);
+            fprintf(stderr, "Cenário %d (%s):\n", k, nome);
+            imprime_tempos_barreiras(segundos_desde(&inicio_motor));
+            funlockfile(stderr);
+        }
+        destroi_barreiras();
+        ok = !s->diferencial || diferencial_finaliza();
+        if (!s->sem_saida) {
+            renderizador_quadro(s->num_total_turnos, arena_copia, 1);
+            renderizador_finaliza();
+            imprime_resultados();
+        }
+    }
+    if (s->saida)
+        fclose(s->saida);
+
+    // As sequências dos robôs copiados são as da base
+    if (montado && c->robos) {
+        destroi_robos(&s->robos, s->num_robos);
+    } else if (montado) {
+        for (int r = 0; r < s->num_robos; r++)
+            pthread_mutex_destroy(&s->robos.travas[r].mutex);
+        libera_robos(&s->robos);
+    }
+    destroi_arena(&s->arena);
+    sim = anterior;
+    free(s);
+
+    if (ok) {
+        fprintf(stderr, "Cenário %d (%s): %.3f ms\n", k, nome, segundos_desde(&inicio) * 1e3);
+    } else {
+        atomic_fetch_add_explicit(&lote.falhas, 1, memory_order_relaxed);
+        fprintf(stderr, "Cenário %d (%s): falhou\n", k, nome);
+    }
+}
+
+static void *trabalhador_lote(void *arg)
+{
+    escalonador_executa_em(lote.filas, (int) (intptr_t) arg, executa_cenario);
+    return NULL;
+}
+
+int executa_lote(const char *arquivo, ModoQuadro modo, int intervalo)
+{
+    int n;
+    lote.cenarios = le_lote(arquivo, &n);
+    lote.base = sim;
+    lote.modo = modo;
+    lote.intervalo = intervalo;
+    atomic_init(&lote.falhas, 0);
+
+    struct timespec inicio;
+    clock_gettime(CLOCK_MONOTONIC, &inicio);
+
+    // Um cenário por pedaço; quem esvazia a própria fila rouba cenários das outras
+    int num_threads = sim->num_trabalhadores < n ? sim->num_trabalhadores : n;
+    if (num_threads > 0) {
+        lote.filas = escalonador_cria(num_threads, n, 1);
+        pthread_t *threads = (pthread_t *) malloc(sizeof(pthread_t) * num_threads);
+        for (int t = 1; t < num_threads; t++)
+            cria_thread_simulacao(&threads[t], NULL, trabalhador_lote, (void *) (intptr_t) t);
+        trabalhador_lote((void *) (intptr_t) 0);
+        for (int t = 1; t < num_threads; t++)
+            pthread_join(threads[t], NULL);
+        free(threads);
+        escalonador_destroi(lote.filas);
+    }
+
+    int falhas = atomic_load(&lote.falhas);
+    fprintf(stderr, "Lote: %d cenários em %.3f ms, %d falhas\n", n,
+            segundos_desde(&inicio) * 1e3, falhas);
+    for (int k = 0; k < n; k++) {
+        free(lote.cenarios[k].saida);
+        free(lote.cenarios[k].robos);
+    }
+    free(lote.cenarios);
+    return falhas > 0 ? 1 : 0;
+}
@@ -0,0 +1,32 @@
+#ifndef __LOTE_H__
+#define __LOTE_H__
+
+#include "renderizador.h"
+
+/*
+ * Modo lote: vários cenários sobre a arena já lida da entrada.
+ *
+ * Cada linha não vazia do arquivo de lote (linhas começando com # são
+ * comentários) descreve um cenário:
+ *
+ *     saida energia turnos [robos]
+ *
+ * - saida: arquivo que recebe os quadros e os resultados do cenário, ou
+ *   "-" para descartá-los;
+ * - energia: energia de uma bateria (e inicial dos robôs), ou "-" para
+ *   manter a da entrada;
+ * - turnos: número de turnos, ou "-" para manter o da entrada;
+ * - robos: arquivo com outros robôs (número de robôs, posições e
+ *   sequências, no formato da entrada); sem ele ficam os da entrada.
+ */
+
+/*
+ * Executa os cenários do arquivo sobre a simulação lida da entrada (sim),
+ * que não muda, com num_trabalhadores threads e os quadros no modo e no
+ * intervalo dados. Cada cenário executa com um único trabalhador. Com -D,
+ * uma divergência encerra o programa, como fora do lote. Retorna 0 se
+ * todos os cenários terminaram, ou 1 se algum falhou.
+ */
+int executa_lote(const char *arquivo, ModoQuadro modo, int intervalo);
+
+#endif /*__LOTE_H__*/
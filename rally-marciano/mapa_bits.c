@@ -0,0 +1,47 @@
+/*
+ * Montagem dos mapas de bits da arena (mapa_bits.h).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mapa_bits.h"
+
+void mapa_inicia(int num_threads)
+{
+    sim->mapa.concorrente = num_threads > 1;
+    // Os blocos saem de páginas novas, já zeradas
+    diretorio_cria(&sim->mapa.ladrilhos, sim->arena.num_ladrilhos, sizeof(MapaLadrilho), NULL);
+
+    // Só os ladrilhos alocados podem ter pilares
+    const Arena *arena = &sim->arena;
+    size_t alocados = arena_alocados(arena);
+    for (size_t k = 0; k < alocados; k++) {
+        const Ladrilho *l = arena_ladrilho_k(arena, k);
+        MapaLadrilho *m = NULL;
+        for (int a = 0; a < LADO_LADRILHO; a++) {
+            uint64_t pilares = 0;
+            for (int b = 0; b < LADO_LADRILHO; b++)
+                if (l->obj[a * LADO_LADRILHO + b] == PILAR)
+                    pilares |= mapa_mascara(b);
+            if (!pilares)
+                continue;
+            if (!m)
+                m = (MapaLadrilho *) diretorio_escrita(&sim->mapa.ladrilhos,
+                                                       arena_posicao_k(arena, k));
+            atomic_store_explicit(&m->palavras[a][MAPA_PILAR], pilares, memory_order_relaxed);
+        }
+    }
+
+    for (int r = 0; r < sim->num_robos; r++) {
+        mapa_liga(MAPA_OCUPADO, sim->robos.i[r], sim->robos.j[r]);
+        mapa_energia(r);
+    }
+}
+
+void mapa_finaliza()
+{
+    diretorio_destroi(&sim->mapa.ladrilhos);
+    memset(&sim->mapa, 0, sizeof(sim->mapa));
+}
@@ -0,0 +1,231 @@
+#ifndef __MAPA_BITS_H__
+#define __MAPA_BITS_H__
+
+/*
+ * Mapas de bits da arena usados pelos motores plano, de blocos e omp.
+ *
+ * Os motores threads e pool não os usam: o movimento deles, com travas
+ * por célula e pelas regras de processa_robo, pode pôr um robô na célula
+ * de outro que ficou parado, e manter os mapas fiéis à arena exigiria
+ * operações atômicas dentro das travas de cada movimento. O roubo deles
+ * continua lendo as quatro células vizinhas (calcula_roubo_energia).
+ *
+ * Cada mapa guarda um bit por célula, ladrilho a ladrilho: uma palavra de
+ * 64 bits por linha de cada ladrilho, na mesma posição do ladrilho no
+ * diretório da arena, então a palavra de uma célula sai direto do índice
+ * de celula(). As palavras de mesma linha dos três mapas são vizinhas na
+ * memória, então os bits de uma célula em todos os mapas caem na mesma
+ * linha de cache.
+ *
+ * Os mapas de cada ladrilho ficam num diretório (diretorio.h) como o dos
+ * ladrilhos da arena, e só são alocados na primeira escrita: os bits
+ * ligados ficam em ladrilhos com pilar ou robô, então a memória dos mapas
+ * cresce com o conteúdo da arena, não com a área. Ler um ladrilho que
+ * nunca foi escrito dá o bloco vazio do diretório, todo zero.
+ *
+ * Fora da arena, o mapa de pilares vale 1 e os demais, 0, então um
+ * vizinho fora da arena se comporta como um pilar.
+ *
+ * Os mapas são atualizados a cada movimento e a cada roubo. Várias
+ * threads podem escrever na mesma palavra numa etapa, cada uma em
+ * células diferentes, então com mais de uma thread as escritas são
+ * operações atômicas de bits. Com uma só, são leituras e escritas
+ * simples, bem mais baratas.
+ */
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "rally.h"
+
+_Static_assert(LADO_LADRILHO == 64, "uma linha de ladrilho por palavra de cada mapa");
+
+/* Palavras de cada linha de ladrilho (três mapas e uma de alinhamento) */
+#define MAPA_CAMADAS 4
+
+/* Mapas, na ordem das palavras de cada linha */
+enum {
+    MAPA_PILAR,    // Pilares, e tudo fora da arena
+    MAPA_OCUPADO,  // Células com robô
+    MAPA_FORTE     // Células com robô com mais de 1 de energia
+};
+
+/* Mapas de um ladrilho: uma linha de cache a cada duas linhas do ladrilho */
+typedef struct MapaLadrilho {
+    _Atomic uint64_t palavras[LADO_LADRILHO][MAPA_CAMADAS];
+} MapaLadrilho;
+
+/* Direções das máscaras de vizinhança, na ordem dos vetores di e dj */
+enum {
+    VIZ_NORTE = 1,
+    VIZ_SUL = 2,
+    VIZ_LESTE = 4,
+    VIZ_OESTE = 8
+};
+
+/* Monta os mapas a partir da arena e dos robôs, para num_threads escritoras */
+void mapa_inicia(int num_threads);
+void mapa_finaliza();
+
+static inline int mapa_dentro_em(const Simulacao *s, Coordenada i, Coordenada j)
+{
+    return (uint64_t) i < (uint64_t) s->arena.n_lins && (uint64_t) j < (uint64_t) s->arena.n_cols;
+}
+
+static inline int mapa_dentro(Coordenada i, Coordenada j)
+{
+    return mapa_dentro_em(sim, i, j);
+}
+
+/* Palavra do mapa m da simulação s que contém a célula (i, j) da arena, para leitura */
+static inline const _Atomic uint64_t *mapa_palavra_em(const Simulacao *s, int m, Coordenada i,
+                                                      Coordenada j)
+{
+    size_t c = celula_em(&s->arena, i, j);
+    const MapaLadrilho *l = (const MapaLadrilho *) diretorio_bloco(&s->mapa.ladrilhos,
+                                                                   c >> (2 * BITS_LADRILHO));
+    return &l->palavras[i & (LADO_LADRILHO - 1)][m];
+}
+
+/* Palavra do mapa m que contém a célula (i, j), para escrita: aloca os mapas do ladrilho */
+static inline _Atomic uint64_t *mapa_escrita_em(Simulacao *s, int m, Coordenada i, Coordenada j)
+{
+    size_t c = celula_em(&s->arena, i, j);
+    MapaLadrilho *l = (MapaLadrilho *) diretorio_escrita(&s->mapa.ladrilhos,
+                                                         c >> (2 * BITS_LADRILHO));
+    return &l->palavras[i & (LADO_LADRILHO - 1)][m];
+}
+
+static inline _Atomic uint64_t *mapa_escrita(int m, Coordenada i, Coordenada j)
+{
+    return mapa_escrita_em(sim, m, i, j);
+}
+
+static inline uint64_t mapa_mascara(Coordenada j)
+{
+    return (uint64_t) 1 << (j & (LADO_LADRILHO - 1));
+}
+
+static inline uint64_t mapa_le(const _Atomic uint64_t *w)
+{
+    return atomic_load_explicit(w, memory_order_relaxed);
+}
+
+/* Bit da célula (i, j) no mapa m; i e j podem estar uma célula fora da arena */
+static inline int mapa_tem_em(const Simulacao *s, int m, Coordenada i, Coordenada j)
+{
+    if (!mapa_dentro_em(s, i, j))
+        return m == MAPA_PILAR;
+    return (mapa_le(mapa_palavra_em(s, m, i, j)) >> (j & (LADO_LADRILHO - 1))) & 1;
+}
+
+static inline int mapa_tem(int m, Coordenada i, Coordenada j)
+{
+    return mapa_tem_em(sim, m, i, j);
+}
+
+/*
+ * Vizinhos de (i, j), uma célula da arena, com o bit ligado no mapa m,
+ * como máscara de VIZ_*. sim é lida uma só vez: as leituras atômicas
+ * obrigariam a relê-la.
+ */
+static inline int mapa_vizinhos(int m, Coordenada i, Coordenada j)
+{
+    const Simulacao *s = sim;
+    unsigned li = (unsigned) i & (LADO_LADRILHO - 1), lj = (unsigned) j & (LADO_LADRILHO - 1);
+    // Longe da borda do ladrilho, os quatro vizinhos estão no mesmo ladrilho
+    if (li - 1 < LADO_LADRILHO - 2 && lj - 1 < LADO_LADRILHO - 2) {
+        const _Atomic uint64_t *w = mapa_palavra_em(s, m, i, j);
+        uint64_t linha = mapa_le(w);
+        int viz = (int) ((mapa_le(w - MAPA_CAMADAS) >> lj) & 1) |
+                  (int) ((mapa_le(w + MAPA_CAMADAS) >> lj) & 1) << 1 |
+                  (int) ((linha >> (lj + 1)) & 1) << 2 | (int) ((linha >> (lj - 1)) & 1) << 3;
+        // Com li e lj positivos, o norte e o oeste estão na arena. No último
+        // ladrilho de uma linha ou coluna, o sul e o leste podem ficar fora
+        // dela e valem como pilar: comparações e máscaras, sem desvio
+        int fora = ((uint64_t) (i + 1) >= (uint64_t) s->arena.n_lins) << 1 |
+                   ((uint64_t) (j + 1) >= (uint64_t) s->arena.n_cols) << 2;
+        return (viz & ~fora) | (fora & -(m == MAPA_PILAR));
+    }
+    return mapa_tem_em(s, m, i - 1, j) | mapa_tem_em(s, m, i + 1, j) << 1 |
+           mapa_tem_em(s, m, i, j + 1) << 2 | mapa_tem_em(s, m, i, j - 1) << 3;
+}
+
+/* Inverte os bits de 'mascara' na palavra w dos mapas de s */
+static inline void mapa_inverte(const Simulacao *s, _Atomic uint64_t *w, uint64_t mascara)
+{
+    if (s->mapa.concorrente)
+        atomic_fetch_xor_explicit(w, mascara, memory_order_relaxed);
+    else
+        atomic_store_explicit(w, atomic_load_explicit(w, memory_order_relaxed) ^ mascara,
+                              memory_order_relaxed);
+}
+
+/*
+ * Um robô saiu de (i, j), que fica vazia, e entrou na vizinha (ni, nj),
+ * que estava vazia: move o bit de ocupação e, conforme a energia antes e
+ * depois do movimento, o de energia. Quando as duas células caem na mesma
+ * palavra, cada mapa é atualizado com uma única operação.
+ */
+static inline void mapa_move_robo(Coordenada i, Coordenada j, Coordenada ni, Coordenada nj,
+                                  int era_forte, int forte)
+{
+    Simulacao *s = sim;
+    _Atomic uint64_t *p = mapa_escrita_em(s, MAPA_OCUPADO, i, j);
+    _Atomic uint64_t *np = mapa_escrita_em(s, MAPA_OCUPADO, ni, nj);
+    uint64_t sai = mapa_mascara(j);
+    uint64_t entra = mapa_mascara(nj);
+    uint64_t sai_forte = sai & -(uint64_t) era_forte;
+    uint64_t entra_forte = entra & -(uint64_t) forte;
+
+    // A palavra de forte fica logo depois da de ocupado
+    if (p == np) {
+        mapa_inverte(s, p, sai | entra);
+        if (sai_forte | entra_forte)
+            mapa_inverte(s, p + (MAPA_FORTE - MAPA_OCUPADO), sai_forte | entra_forte);
+        return;
+    }
+    mapa_inverte(s, p, sai);
+    mapa_inverte(s, np, entra);
+    if (sai_forte)
+        mapa_inverte(s, p + (MAPA_FORTE - MAPA_OCUPADO), sai_forte);
+    if (entra_forte)
+        mapa_inverte(s, np + (MAPA_FORTE - MAPA_OCUPADO), entra_forte);
+}
+
+static inline void mapa_liga(int m, Coordenada i, Coordenada j)
+{
+    _Atomic uint64_t *w = mapa_escrita(m, i, j);
+    if (sim->mapa.concorrente)
+        atomic_fetch_or_explicit(w, mapa_mascara(j), memory_order_relaxed);
+    else
+        atomic_store_explicit(w, atomic_load_explicit(w, memory_order_relaxed) | mapa_mascara(j),
+                              memory_order_relaxed);
+}
+
+static inline void mapa_desliga(int m, Coordenada i, Coordenada j)
+{
+    _Atomic uint64_t *w = mapa_escrita(m, i, j);
+    if (sim->mapa.concorrente)
+        atomic_fetch_and_explicit(w, ~mapa_mascara(j), memory_order_relaxed);
+    else
+        atomic_store_explicit(w, atomic_load_explicit(w, memory_order_relaxed) & ~mapa_mascara(j),
+                              memory_order_relaxed);
+}
+
+static inline void mapa_define(int m, Coordenada i, Coordenada j, int valor)
+{
+    if (valor)
+        mapa_liga(m, i, j);
+    else
+        mapa_desliga(m, i, j);
+}
+
+/* Atualiza o bit de energia da célula do robô depois de a energia mudar */
+static inline void mapa_energia(int r)
+{
+    mapa_define(MAPA_FORTE, sim->robos.i[r], sim->robos.j[r], sim->robos.energia[r] > 1);
+}
+
+#endif /*__MAPA_BITS_H__*/
@@ -0,0 +1,371 @@
+/*
+ * Motor de blocos: decomposição espacial da arena.
+ *
+ * A arena é dividida em blocos retangulares, um por trabalhador, e cada
+ * trabalhador processa os robôs que estão no seu bloco. As etapas são as
+ * mesmas do motor plano (motor_plano.c). Cada reivindicação e cada robô
+ * só são escritos pelo dono do bloco em que estão:
+ *
+ * - Reivindicações de células do próprio bloco são gravadas diretamente,
+ *   sem CAS. As de células de outro bloco vão para a caixa de saída do
+ *   vizinho e são aplicadas por ele na troca de halo, após uma barreira.
+ * - Robôs que saem do bloco migram pela caixa de saída para o bloco de
+ *   destino.
+ * - O desconto de energia de um alvo de roubo em outro bloco também vai
+ *   pela caixa de saída e é aplicado pelo dono do alvo no turno seguinte,
+ *   antes do plano.
+ *
+ * As células da arena não seguem essa regra: na confirmação, um robô que
+ * sai do bloco escreve a célula de destino, que é do vizinho. Cada célula
+ * tem, ainda assim, um único escritor na etapa: o robô que venceu a
+ * reivindicação dela, ou, se nenhum vencedor entra, o robô que sai dela.
+ * Os dois decidem lendo só a tabela de reivindicações e a situação dos
+ * movimentos, que não mudam mais depois da última barreira da resolução,
+ * e ninguém lê a arena antes da barreira seguinte (SINC_MOVIMENTO). Os
+ * bits dos mapas (mapa_bits.h) são atualizados com operações atômicas,
+ * porque uma palavra pode ter células de dois blocos.
+ *
+ * As intenções de movimento são calculadas antes, em lote (intencoes.h),
+ * por fatias contíguas de IDs, que são as partes dos vetores dos robôs
+ * que -N põe no nó de cada trabalhador; depois de uma barreira, cada
+ * bloco valida e reivindica os destinos dos seus robôs.
+ *
+ * Um movimento e um roubo só alcançam a célula vizinha ao norte, ao sul,
+ * a leste ou a oeste, então as mensagens só vão para os (até) quatro
+ * blocos vizinhos na grade: cada bloco tem uma caixa de saída por
+ * direção, e cada etapa de troca lê só as caixas dos vizinhos.
+ *
+ * Robôs no interior de um bloco não tocam em nenhum estado compartilhado
+ * além das leituras da arena. Como as decisões são as do motor plano, o
+ * resultado é o mesmo para qualquer número de blocos.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rally.h"
+#include "topologia.h"
+#include "intencoes.h"
+
+/* Mensagens de um bloco para outro durante o turno */
+typedef struct {
+    Vetor reivindicacoes;  // IDs de robôs que querem entrar numa célula do bloco
+    Vetor migrantes;       // IDs de robôs que entraram no bloco
+    Vetor debitos;         // Pares (ID do alvo, energia roubada)
+} Caixa;
+
+/* Região da arena de um bloco e os robôs que estão nela */
+typedef struct {
+    Coordenada lin_ini, lin_fim;  // Linhas [lin_ini, lin_fim)
+    Coordenada col_ini, col_fim;  // Colunas [col_ini, col_fim)
+    Vetor robos;
+} Bloco;
+
+/* Direções dos vizinhos de um bloco na grade (norte, sul, leste, oeste): a oposta de d é d ^ 1 */
+#define NUM_VIZINHOS 4
+
+/* Estado do motor de blocos numa execução (sim->blocos) */
+typedef struct EstadoBlocos {
+    int num_blocos;
+    int blocos_por_linha;  // Blocos em cada faixa horizontal
+    Bloco *blocos;
+    Caixa *caixas;       // caixas[origem * NUM_VIZINHOS + d], para o vizinho na direção d
+    int *vizinhos;       // vizinhos[b * NUM_VIZINHOS + d]: vizinho de b na direção d, ou -1
+} EstadoBlocos;
+
+/* Faixa de x entre as 'faixas' faixas de [0, n), a f-ésima começando em n * f / faixas */
+static inline int faixa_de(Coordenada x, Coordenada n, int faixas)
+{
+    return (int) (((x + 1) * faixas - 1) / n);
+}
+
+static inline Coordenada inicio_faixa(Coordenada n, int f, int faixas)
+{
+    return n * f / faixas;
+}
+
+/*
+ * Bloco da célula (i, j), que é do bloco b ou vizinha de uma célula dele:
+ * um movimento ou um roubo só alcança a célula vizinha. Os blocos têm ao
+ * menos uma linha e uma coluna, então basta comparar com os limites de b.
+ */
+static inline int bloco_de(const EstadoBlocos *eb, int b, Coordenada i, Coordenada j)
+{
+    const Bloco *bloco = &eb->blocos[b];
+    if (i < bloco->lin_ini)
+        return b - eb->blocos_por_linha;
+    if (i >= bloco->lin_fim)
+        return b + eb->blocos_por_linha;
+    if (j < bloco->col_ini)
+        return b - 1;
+    if (j >= bloco->col_fim)
+        return b + 1;
+    return b;
+}
+
+/* Caixa de saída de 'origem' para o bloco vizinho 'destino' */
+static inline Caixa *caixa_para(const EstadoBlocos *eb, int origem, int destino)
+{
+    int df = destino / eb->blocos_por_linha - origem / eb->blocos_por_linha;
+    int d = df != 0 ? (df < 0 ? 0 : 1) : (destino > origem ? 2 : 3);
+    return &eb->caixas[origem * NUM_VIZINHOS + d];
+}
+
+/* Caixa que o vizinho de b na direção d manda para b, ou NULL se não há vizinho */
+static inline Caixa *caixa_de(const EstadoBlocos *eb, int b, int d)
+{
+    int origem = eb->vizinhos[b * NUM_VIZINHOS + d];
+    return origem < 0 ? NULL : &eb->caixas[origem * NUM_VIZINHOS + (d ^ 1)];
+}
+
+/* Razão entre o lado maior e o menor dos blocos de uma grade faixas x colunas */
+static double razao_blocos(int faixas, int colunas)
+{
+    double altura = (double) sim->arena.n_lins / faixas;
+    double largura = (double) sim->arena.n_cols / colunas;
+    return altura > largura ? altura / largura : largura / altura;
+}
+
+/*
+ * Divide a arena numa grade de no máximo n blocos. Entre as grades que
+ * cabem na arena, fica a de mais blocos cuja razão entre os lados dos
+ * blocos não passa de 2 (ou da menor razão possível, se nenhuma chega a
+ * 2) e, entre essas, a de blocos mais quadrados. A borda, e com ela a
+ * troca de halo, cresce com o lado dos blocos, então com n primo uma
+ * grade quase quadrada de menos blocos ganha das n faixas finas: os
+ * trabalhadores que sobram ficam sem bloco.
+ */
+static void divide_arena(int n)
+{
+    EstadoBlocos *eb = sim->blocos;
+    double limite = -1;
+    for (int f = 1; f <= n && f <= sim->arena.n_lins; f++)
+        for (int c = 1; f * c <= n && c <= sim->arena.n_cols; c++)
+            if (limite < 0 || razao_blocos(f, c) < limite)
+                limite = razao_blocos(f, c);
+    if (limite < 2)
+        limite = 2;
+
+    int faixas = 1, colunas = 1;
+    for (int f = 1; f <= n && f <= sim->arena.n_lins; f++)
+        for (int c = 1; f * c <= n && c <= sim->arena.n_cols; c++) {
+            double razao = razao_blocos(f, c);
+            if (razao > limite)
+                continue;
+            if (f * c > faixas * colunas ||
+                (f * c == faixas * colunas && razao < razao_blocos(faixas, colunas))) {
+                faixas = f;
+                colunas = c;
+            }
+        }
+
+    eb->num_blocos = faixas * colunas;
+    eb->blocos_por_linha = colunas;
+
+    eb->blocos = (Bloco *) calloc(eb->num_blocos, sizeof(Bloco));
+    eb->caixas = (Caixa *) calloc((size_t) eb->num_blocos * NUM_VIZINHOS, sizeof(Caixa));
+    eb->vizinhos = (int *) malloc(sizeof(int) * eb->num_blocos * NUM_VIZINHOS);
+    for (int b = 0; b < eb->num_blocos; b++) {
+        int f = b / colunas, c = b % colunas;
+        eb->vizinhos[b * NUM_VIZINHOS + 0] = f > 0 ? b - colunas : -1;
+        eb->vizinhos[b * NUM_VIZINHOS + 1] = f < faixas - 1 ? b + colunas : -1;
+        eb->vizinhos[b * NUM_VIZINHOS + 2] = c < colunas - 1 ? b + 1 : -1;
+        eb->vizinhos[b * NUM_VIZINHOS + 3] = c > 0 ? b - 1 : -1;
+    }
+    for (int b = 0; b < eb->num_blocos; b++) {
+        int f = b / colunas, c = b % colunas;
+        eb->blocos[b].lin_ini = inicio_faixa(sim->arena.n_lins, f, faixas);
+        eb->blocos[b].lin_fim = inicio_faixa(sim->arena.n_lins, f + 1, faixas);
+        eb->blocos[b].col_ini = inicio_faixa(sim->arena.n_cols, c, colunas);
+        eb->blocos[b].col_fim = inicio_faixa(sim->arena.n_cols, c + 1, colunas);
+    }
+
+    // Distribui os robôs pelos blocos de acordo com a posição inicial
+    for (int r = 0; r < sim->num_robos; r++) {
+        int f = faixa_de(sim->robos.i[r], sim->arena.n_lins, faixas);
+        int c = faixa_de(sim->robos.j[r], sim->arena.n_cols, colunas);
+        vetor_poe(&eb->blocos[f * colunas + c].robos, r);
+    }
+}
+
+/* Aplica os descontos de energia enviados pelos blocos vizinhos */
+static void recebe_debitos(int b)
+{
+    EstadoBlocos *eb = sim->blocos;
+    for (int d = 0; d < NUM_VIZINHOS; d++) {
+        Caixa *cx = caixa_de(eb, b, d);
+        if (!cx)
+            continue;
+        Vetor *deb = &cx->debitos;
+        for (int k = 0; k < deb->n; k += 2)
+            desconta_energia(deb->v[k], deb->v[k + 1]);
+        deb->n = 0;
+    }
+}
+
+static void *thread_bloco(void *arg)
+{
+    EstadoBlocos *eb = sim->blocos;
+    Robos *rb = &sim->robos;
+    Trabalhador *trab = (Trabalhador *)arg;
+    int b = trab->id;
+    Bloco *bloco = &eb->blocos[b];
+    Vetor *meus = &bloco->robos;
+
+    for (int turno = sim->turno_inicial; turno < sim->num_total_turnos; turno++) {
+        recebe_debitos(b);
+        // O checkpoint e o diferencial precisam dos descontos de todos os blocos aplicados
+        if (turno_precisa_estado(turno))
+            barreira_espera(&sim->barreiras[SINC_IMPRESSAO], b);
+
+        // Imprime o estado atual da arena
+        if (trab->id == 0)
+            imprime_turno(turno);
+        barreira_espera(&sim->barreiras[SINC_IMPRESSAO], b);
+
+        calcula_intencoes(trab->inicio, trab->fim);
+        barreira_espera(&sim->barreiras[SINC_INTENCOES], b);
+
+        // Plano: reivindicações locais direto, as de outros blocos pela caixa
+        for (int k = 0; k < meus->n; k++) {
+            int r = meus->v[k];
+            if (!valida_intencao(r))
+                continue;
+            int destino = bloco_de(eb, b, rb->move_i[r], rb->move_j[r]);
+            if (destino == b)
+                reivindica_local(celula(rb->move_i[r], rb->move_j[r]), r);
+            else
+                vetor_poe(&caixa_para(eb, b, destino)->reivindicacoes, r);
+        }
+        barreira_espera(&sim->barreiras[SINC_PLANO], b);
+
+        // Troca de halo: aplica as reivindicações de borda recebidas dos vizinhos
+        for (int d = 0; d < NUM_VIZINHOS; d++) {
+            Caixa *cx = caixa_de(eb, b, d);
+            if (!cx)
+                continue;
+            Vetor *reiv = &cx->reivindicacoes;
+            for (int k = 0; k < reiv->n; k++) {
+                int r = reiv->v[k];
+                reivindica_local(celula(rb->move_i[r], rb->move_j[r]), r);
+            }
+            reiv->n = 0;
+        }
+        barreira_espera(&sim->barreiras[SINC_HALO], b);
+
+        resolve_movimentos(meus, b, turno);
+
+        // Confirmação: robôs que saem do bloco migram para o vizinho
+        int fica = 0;
+        for (int k = 0; k < meus->n; k++) {
+            int r = meus->v[k];
+            int destino = b;
+            if (confirma_movimento(r))
+                destino = bloco_de(eb, b, rb->i[r], rb->j[r]);
+            if (destino == b)
+                meus->v[fica++] = r;
+            else
+                vetor_poe(&caixa_para(eb, b, destino)->migrantes, r);
+        }
+        meus->n = fica;
+        barreira_espera(&sim->barreiras[SINC_MOVIMENTO], b);
+
+        for (int d = 0; d < NUM_VIZINHOS; d++) {
+            Caixa *cx = caixa_de(eb, b, d);
+            if (!cx)
+                continue;
+            Vetor *mig = &cx->migrantes;
+            for (int k = 0; k < mig->n; k++)
+                vetor_poe(meus, mig->v[k]);
+            mig->n = 0;
+        }
+        for (int k = 0; k < meus->n; k++)
+            escolhe_alvo_roubo(meus->v[k]);
+        barreira_espera(&sim->barreiras[SINC_ALVO_ROUBO], b);
+
+        // Roubo: o desconto de um alvo de outro bloco vai pela caixa
+        for (int k = 0; k < meus->n; k++) {
+            int r = meus->v[k];
+            int debito = realiza_roubo_planejado(r);
+            if (debito == 0)
+                continue;
+            int alvo = rb->id_roubo_energia[r];
+            int destino = bloco_de(eb, b, rb->i[alvo], rb->j[alvo]);
+            if (destino == b) {
+                desconta_energia(alvo, debito);
+            } else {
+                Caixa *cx = caixa_para(eb, b, destino);
+                vetor_poe(&cx->debitos, alvo);
+                vetor_poe(&cx->debitos, debito);
+            }
+        }
+        barreira_espera(&sim->barreiras[SINC_ROUBO], b);
+    }
+
+    // Descontos do último turno
+    recebe_debitos(b);
+    return NULL;
+}
+
+/* Executa a simulação com a arena dividida em blocos, um por trabalhador */
+void executa_blocos()
+{
+    int n = sim->num_trabalhadores;
+    if ((size_t) n > (size_t) sim->arena.n_lins * sim->arena.n_cols)
+        n = (int) (sim->arena.n_lins * sim->arena.n_cols);
+    if (n < 1)
+        n = 1;
+
+    EstadoBlocos *eb = (EstadoBlocos *) calloc(1, sizeof(EstadoBlocos));
+    sim->blocos = eb;
+    divide_arena(n);
+
+    // Com -N, cada trabalhador toca primeiro as células do seu bloco; os robôs
+    // de um bloco não são contíguos, então os vetores vão em fatias de IDs
+    Posse *posses = (Posse *) malloc(sizeof(Posse) * eb->num_blocos);
+    for (int b = 0; b < eb->num_blocos; b++) {
+        posses[b].lin_ini = eb->blocos[b].lin_ini;
+        posses[b].lin_fim = eb->blocos[b].lin_fim;
+        posses[b].col_ini = eb->blocos[b].col_ini;
+        posses[b].col_fim = eb->blocos[b].col_fim;
+        posses[b].robo_ini = inicio_fatia(b, eb->num_blocos);
+        posses[b].robo_fim = inicio_fatia(b + 1, eb->num_blocos);
+    }
+    topologia_distribui(posses, eb->num_blocos);
+    free(posses);
+
+    plano_inicia(eb->num_blocos);
+    inicia_barreiras(eb->num_blocos);
+
+    pthread_t *threads = (pthread_t *) malloc(sizeof(pthread_t) * eb->num_blocos);
+    Trabalhador *trabs = (Trabalhador *) malloc(sizeof(Trabalhador) * eb->num_blocos);
+    for (int b = 0; b < eb->num_blocos; b++) {
+        trabs[b].id = b;
+        trabs[b].inicio = inicio_fatia(b, eb->num_blocos);
+        trabs[b].fim = inicio_fatia(b + 1, eb->num_blocos);
+        pthread_attr_t attr;
+        pthread_attr_t *a = topologia_atributos(&attr, b, eb->num_blocos);
+        cria_thread_simulacao(&threads[b], a, thread_bloco, (void *)&trabs[b]);
+        if (a)
+            pthread_attr_destroy(a);
+    }
+    for (int b = 0; b < eb->num_blocos; b++)
+        pthread_join(threads[b], NULL);
+
+    plano_finaliza();
+    for (int b = 0; b < eb->num_blocos; b++)
+        free(eb->blocos[b].robos.v);
+    for (int c = 0; c < eb->num_blocos * NUM_VIZINHOS; c++) {
+        free(eb->caixas[c].reivindicacoes.v);
+        free(eb->caixas[c].migrantes.v);
+        free(eb->caixas[c].debitos.v);
+    }
+    free(eb->blocos);
+    free(eb->caixas);
+    free(eb->vizinhos);
+    free(eb);
+    sim->blocos = NULL;
+    free(trabs);
+    free(threads);
+}
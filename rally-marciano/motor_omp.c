@@ -0,0 +1,110 @@
+/*
+ * Motor OpenMP.
+ *
+ * As mesmas etapas do motor plano (motor_plano.c), com as mesmas funções,
+ * numa única região paralela que dura toda a simulação. Em vez de fatias
+ * e listas de ativos por trabalhador, o plano, a confirmação, a escolha
+ * dos alvos e o roubo são laços "omp for" sobre todos os robôs, e as
+ * barreiras entre as etapas são barreiras OpenMP (BARREIRA_OMP), com a
+ * mesma contabilização de -T dos outros motores.
+ *
+ * O escalonamento é estático, em pedaços múltiplos de ROBOS_POR_LINHA:
+ * com o mesmo número de iterações e de threads, cada thread recebe os
+ * mesmos robôs em todos os laços, então a lista de robôs que ela planejou
+ * serve para a resolução (etapa 2), e duas threads nunca escrevem na
+ * mesma linha de cache dos campos quentes. Há no máximo um pedaço por
+ * thread, então o plano usa o pedaço da thread diretamente, com as
+ * intenções calculadas em lote (planeja_fatia), como no motor plano.
+ *
+ * Nenhuma decisão depende da ordem das threads, então a saída é a mesma
+ * do motor plano. Só é compilado com OpenMP (make OPENMP=1 ou
+ * cmake -DRALLY_OPENMP=ON).
+ */
+
+#ifdef _OPENMP
+
+#include <stdlib.h>
+#include <omp.h>
+
+#include "rally.h"
+
+/* Robôs por pedaço do escalonamento: uma fatia por thread, arredondada para linhas de cache */
+static int tamanho_pedaco(int n)
+{
+    int pedaco = (sim->num_robos + n - 1) / n;
+    pedaco = (pedaco + ROBOS_POR_LINHA - 1) / ROBOS_POR_LINHA * ROBOS_POR_LINHA;
+    return pedaco > 0 ? pedaco : ROBOS_POR_LINHA;
+}
+
+/* Trabalho de cada thread da região; 'planejados' tem os robôs que cada thread planejou mover */
+static void simula(Simulacao *s, Vetor *planejados, int pedaco)
+{
+    // As threads da região não passam por cria_thread_simulacao
+    sim = s;
+    barreira_inicia_thread();
+    int id = omp_get_thread_num();
+    Vetor *lista = &planejados[id];
+    long ini_pedaco = (long) id * pedaco;
+    int ini = ini_pedaco < sim->num_robos ? (int) ini_pedaco : sim->num_robos;
+    int fim = sim->num_robos - ini > pedaco ? ini + pedaco : sim->num_robos;
+
+    for (int turno = sim->turno_inicial; turno < sim->num_total_turnos; turno++) {
+        // Imprime o estado atual da arena
+        #pragma omp master
+        imprime_turno(turno);
+        barreira_espera(&sim->barreiras[SINC_IMPRESSAO], id);
+
+        // O pedaço que o escalonamento estático dá a esta thread nos outros laços
+        lista->n = 0;
+        planeja_fatia(ini, fim, lista);
+        barreira_espera(&sim->barreiras[SINC_PLANO], id);
+
+        resolve_movimentos(lista, id, turno);
+
+        #pragma omp for schedule(static, pedaco) nowait
+        for (int r = 0; r < sim->num_robos; r++)
+            confirma_movimento(r);
+        barreira_espera(&sim->barreiras[SINC_MOVIMENTO], id);
+
+        #pragma omp for schedule(static, pedaco) nowait
+        for (int r = 0; r < sim->num_robos; r++)
+            escolhe_alvo_roubo(r);
+        barreira_espera(&sim->barreiras[SINC_ALVO_ROUBO], id);
+
+        #pragma omp for schedule(static, pedaco) nowait
+        for (int r = 0; r < sim->num_robos; r++) {
+            int debito = realiza_roubo_planejado(r);
+            if (debito > 0)
+                desconta_energia(sim->robos.id_roubo_energia[r], debito);
+        }
+        barreira_espera(&sim->barreiras[SINC_ROUBO], id);
+    }
+}
+
+/* Executa a simulação com o motor OpenMP */
+void executa_omp()
+{
+    int n = trabalhadores_efetivos();
+    plano_inicia(n);
+    Vetor *planejados = (Vetor *) calloc(n, sizeof(Vetor));
+
+    // -b vale para os outros motores; aqui as threads são as da região paralela
+    TipoBarreira escolhida = sim->tipo_barreira;
+    sim->tipo_barreira = BARREIRA_OMP;
+    inicia_barreiras(n);
+    sim->tipo_barreira = escolhida;
+
+    // Sem ajuste dinâmico, a região tem exatamente n threads (IDs de 0 a n - 1)
+    omp_set_dynamic(0);
+    Simulacao *s = sim;
+    int pedaco = tamanho_pedaco(n);
+    #pragma omp parallel num_threads(n)
+    simula(s, planejados, pedaco);
+
+    for (int t = 0; t < n; t++)
+        free(planejados[t].v);
+    free(planejados);
+    plano_finaliza();
+}
+
+#endif /*_OPENMP*/
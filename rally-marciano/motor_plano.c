@@ -0,0 +1,680 @@
+/*
+ * Motor de plano e confirmação.
+ *
+ * Cada turno é dividido em etapas paralelas separadas por barreiras, sem
+ * nenhuma trava de célula ou de robô:
+ *
+ * 1. Plano: cada robô com energia calcula o movimento e, se o destino for
+ *    válido, reivindica a célula de destino na tabela de reivindicações.
+ *    A reivindicação guarda o menor ID entre os candidatos.
+ * 2. Resolução: um robô só se move se venceu a reivindicação do destino e
+ *    se a célula de destino estiver vazia ou o ocupante também se mover.
+ *    Cadeias de robôs que seguem uns aos outros terminam numa célula
+ *    vazia (sucesso), num robô parado (falha) ou fecham um ciclo
+ *    (rotação, sucesso), e são resolvidas em paralelo por saltos de
+ *    ponteiros, em rodadas separadas por barreiras.
+ * 3. Confirmação: os robôs que se movem atualizam a arena. Cada célula tem
+ *    no máximo um robô entrando, então não há escritas concorrentes.
+ * 4. Alvo do roubo: cada robô sem energia escolhe o vizinho de menor ID
+ *    com mais de 1 de energia e guarda a energia que o alvo tinha.
+ * 5. Roubo: os ladrões de um mesmo alvo são atendidos em ordem de ID
+ *    enquanto o alvo tiver mais de 1 de energia.
+ *
+ * Nenhuma decisão depende da ordem em que as threads executam, então o
+ * resultado é idêntico para qualquer número de trabalhadores.
+ *
+ * Cada trabalhador só percorre os seus robôs ativos: os que ainda podem
+ * se mover e os sem energia com algum vizinho de quem roubar. Um robô
+ * sai da lista na etapa 4, quando fica sem movimentos ou sem energia e
+ * sem alvo. Ele só volta a ter o que fazer se chegar ao lado dele um
+ * robô com mais de 1 de energia, e esse robô acabou de se mover, então é
+ * quem se move que acorda os vizinhos. Quando nenhum robô está ativo o
+ * estado não muda mais, e os turnos restantes só repetem o quadro.
+ * Enquanto pelo menos metade dos robôs está ativa, a etapa 1 percorre a
+ * fatia inteira do trabalhador, com as intenções calculadas em lote
+ * (intencoes.h); os robôs fora das listas simplesmente ficam parados.
+ *
+ * As consultas de vizinhança usam os mapas de bits de mapa_bits.h, que
+ * as etapas 3 e 5 mantêm a cada movimento e a cada roubo.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <stdatomic.h>
+
+#include "rally.h"
+#include "mapa_bits.h"
+#include "instrumentacao.h"
+#include "eventos.h"
+#include "intencoes.h"
+
+/* Célula sem reivindicação no turno */
+#define SEM_REIVINDICACAO INT_MAX
+
+/* Situação do movimento de cada robô no turno */
+enum {
+    MOV_PARADO,    // Robô não tenta se mover
+    MOV_PENDENTE,  // Tenta se mover, resultado ainda não conhecido
+    MOV_SUCESSO,   // Movimento confirmado
+    MOV_FALHA      // Movimento bloqueado
+};
+
+/* Estado do motor de plano numa execução (sim->plano) */
+typedef struct EstadoPlano {
+    /*
+     * Reivindicações de cada ladrilho, num diretório (diretorio.h) com as
+     * posições do da arena. Cada célula guarda SEM_REIVINDICACAO - id do
+     * menor ID que quer entrar nela, então 0 é "sem reivindicação" e os
+     * blocos novos, zerados pelo sistema, não precisam ser iniciados. Só os
+     * ladrilhos onde algum robô quis entrar recebem um bloco.
+     */
+    Diretorio reivindicacoes;
+    _Atomic unsigned char *situacao;  // Situação do movimento de cada robô
+    atomic_int *proximo;  // Próximo robô da cadeia de cada robô pendente (etapa 2)
+    Vetor *cadeias;       // Robôs ainda pendentes de cada trabalhador na etapa 2
+    int num_cadeias;
+    _Atomic long long ha_pendente[2];      // Marca da última rodada que deixou robôs pendentes
+    _Atomic long long houve_resolucao[2];  // Marca da última rodada que resolveu algum robô
+
+    Vetor *ativos;  // Robôs ativos de cada trabalhador
+    int num_listas;
+    _Atomic unsigned char *ativo;  // 1 se o robô está na lista de algum trabalhador
+    int sem_ativos;  // Decidido pela thread 0 no início do turno
+    int por_fatias;  // Etapa 1 sobre as fatias inteiras; decidido junto com sem_ativos
+} EstadoPlano;
+
+/* Reivindicações de um ladrilho */
+typedef struct {
+    atomic_int celulas[CELULAS_LADRILHO];
+} ReivindicacoesLadrilho;
+
+/* Deslocamentos de cada direção das máscaras de vizinhança (VIZ_*) */
+static const int di[] = {-1, 1, 0, 0};
+static const int dj[] = { 0, 0, 1,-1};
+
+/* Menor ID que reivindicou a célula c, ou SEM_REIVINDICACAO */
+static inline int reivindicante(const EstadoPlano *p, size_t c)
+{
+    const ReivindicacoesLadrilho *l = (const ReivindicacoesLadrilho *)
+        diretorio_bloco(&p->reivindicacoes, c >> (2 * BITS_LADRILHO));
+    return SEM_REIVINDICACAO - atomic_load_explicit(&l->celulas[c & (CELULAS_LADRILHO - 1)],
+                                                    memory_order_relaxed);
+}
+
+/* Reivindicação da célula c para escrita: aloca o bloco do ladrilho */
+static inline atomic_int *reivindicacao_escrita(EstadoPlano *p, size_t c)
+{
+    ReivindicacoesLadrilho *l = (ReivindicacoesLadrilho *)
+        diretorio_escrita(&p->reivindicacoes, c >> (2 * BITS_LADRILHO));
+    return &l->celulas[c & (CELULAS_LADRILHO - 1)];
+}
+
+/* Registra que o robô 'id' quer entrar na célula c, mantendo o menor ID */
+void reivindica(size_t c, int id)
+{
+    atomic_int *celula_c = reivindicacao_escrita(sim->plano, c);
+    int valor = SEM_REIVINDICACAO - id;
+    int atual = atomic_load_explicit(celula_c, memory_order_relaxed);
+    while (valor > atual &&
+           !atomic_compare_exchange_weak_explicit(celula_c, &atual, valor,
+                                                  memory_order_relaxed, memory_order_relaxed))
+        ;
+}
+
+/*
+ * Igual a reivindica, para quando uma única thread escreve as
+ * reivindicações da célula c (motor de blocos): dispensa o CAS.
+ */
+void reivindica_local(size_t c, int id)
+{
+    EstadoPlano *p = sim->plano;
+    if (id < reivindicante(p, c))
+        atomic_store_explicit(reivindicacao_escrita(p, c), SEM_REIVINDICACAO - id,
+                              memory_order_relaxed);
+}
+
+static inline int situacao_de(const EstadoPlano *p, int r)
+{
+    return atomic_load_explicit(&p->situacao[r], memory_order_relaxed);
+}
+
+static inline void define_situacao(const EstadoPlano *p, int r, int s)
+{
+    atomic_store_explicit(&p->situacao[r], s, memory_order_relaxed);
+}
+
+/*
+ * Etapa 1: calcula a intenção do robô. Retorna 1 se o robô tenta entrar
+ * em celula(move_i, move_j), que o chamador deve reivindicar.
+ */
+int planeja_movimento(int r)
+{
+    EstadoPlano *p = sim->plano;
+    Robos *rb = &sim->robos;
+    INSTR_ACESSO(&rb->energia[r]);
+    rb->move_i[r] = rb->i[r];
+    rb->move_j[r] = rb->j[r];
+
+    if (rb->energia[r] > 0)
+        calcula_movimento(r);
+
+    // Destinos fora da arena ou com pilar equivalem a ficar parado (a borda do mapa é de pilares)
+    if ((rb->move_i[r] == rb->i[r] && rb->move_j[r] == rb->j[r]) ||
+        mapa_tem(MAPA_PILAR, rb->move_i[r], rb->move_j[r]))
+    {
+        rb->move_i[r] = rb->i[r];
+        rb->move_j[r] = rb->j[r];
+        define_situacao(p, r, MOV_PARADO);
+        return 0;
+    }
+
+    define_situacao(p, r, MOV_PENDENTE);
+    return 1;
+}
+
+/* Etapa 1 depois de calcula_intencoes: a validação do destino de planeja_movimento */
+static inline int valida_intencao_em(const EstadoPlano *p, Robos *rb, int r)
+{
+    INSTR_ACESSO(&rb->energia[r]);
+    Coordenada i = rb->i[r], j = rb->j[r];
+    Coordenada mi = rb->move_i[r], mj = rb->move_j[r];
+    if ((mi == i && mj == j) || mapa_tem(MAPA_PILAR, mi, mj)) {
+        rb->move_i[r] = i;
+        rb->move_j[r] = j;
+        define_situacao(p, r, MOV_PARADO);
+        return 0;
+    }
+    define_situacao(p, r, MOV_PENDENTE);
+    return 1;
+}
+
+int valida_intencao(int r)
+{
+    return valida_intencao_em(sim->plano, &sim->robos, r);
+}
+
+/*
+ * Etapa 1 sobre a fatia [ini, fim) inteira: as intenções saem de
+ * calcula_intencoes, em lote, e só a validação do destino e a
+ * reivindicação ficam por robô. Os robôs fora das listas de ativos não
+ * têm movimento a fazer e ficam parados, como em planeja_movimento.
+ */
+void planeja_fatia(int ini, int fim, Vetor *planejados)
+{
+    EstadoPlano *p = sim->plano;
+    Robos *rb = &sim->robos;
+    Arena *a = &sim->arena;
+    calcula_intencoes(ini, fim);
+    for (int r = ini; r < fim; r++) {
+        if (!valida_intencao_em(p, rb, r))
+            continue;
+        reivindica(celula_em(a, rb->move_i[r], rb->move_j[r]), r);
+        if (planejados)
+            vetor_poe(planejados, r);
+    }
+}
+
+/*
+ * Etapa 2: decide quais robôs se movem.
+ *
+ * Cada robô pendente que venceu a reivindicação do destino quer entrar na
+ * célula de outro robô (o ocupante) ou numa célula vazia. Como cada
+ * célula tem um único vencedor e cada robô ocupa uma única célula, o
+ * grafo "entra na célula de" é formado por caminhos e ciclos disjuntos.
+ * Um robô se move se o fim do seu caminho se move (célula vazia) e fica
+ * se o fim fica (ocupante parado ou que perdeu a própria reivindicação);
+ * num ciclo todos giram juntos.
+ *
+ * Em vez de uma thread seguir cada cadeia até o fim, todos os robôs
+ * pendentes avançam juntos por saltos de ponteiros: a cada rodada, quem
+ * aponta para um robô já resolvido copia o resultado dele, e os demais
+ * passam a apontar para o sucessor do sucessor. Uma cadeia de n robôs se
+ * resolve em cerca de log2(n) rodadas, cada uma seguida de uma barreira.
+ * Uma rodada sem nenhuma resolução significa que só restam ciclos.
+ */
+
+/* Rodada k do turno, distinta de todas as rodadas dos outros turnos */
+static inline long long marca_rodada(int turno, int k)
+{
+    return (long long) turno * 64 + k;
+}
+
+/* Início da etapa 2: resolve o que não depende do ocupante e liga os demais a ele */
+static void inicia_resolucao(const Vetor *lista, Vetor *pendentes)
+{
+    EstadoPlano *p = sim->plano;
+    Robos *rb = &sim->robos;
+    Arena *a = &sim->arena;
+    pendentes->n = 0;
+    for (int k = 0; k < lista->n; k++) {
+        int r = lista->v[k];
+        if (situacao_de(p, r) != MOV_PENDENTE)
+            continue;
+        size_t destino = celula_em(a, rb->move_i[r], rb->move_j[r]);
+        int ocupante = arena_id_em(a, destino);
+        if (reivindicante(p, destino) != r) {
+            define_situacao(p, r, MOV_FALHA);  // Um robô de ID menor ficou com a célula
+        } else if (ocupante < 0) {
+            define_situacao(p, r, MOV_SUCESSO);
+        } else {
+            atomic_store_explicit(&p->proximo[r], ocupante, memory_order_relaxed);
+            vetor_poe(pendentes, r);
+        }
+    }
+}
+
+/* Uma rodada de saltos sobre os robôs ainda pendentes. Retorna 1 se algum se resolveu */
+static int salta_ponteiros(Vetor *pendentes)
+{
+    EstadoPlano *p = sim->plano;
+    int resolveu = 0;
+    int fica = 0;
+    for (int k = 0; k < pendentes->n; k++) {
+        int r = pendentes->v[k];
+        int prox = atomic_load_explicit(&p->proximo[r], memory_order_relaxed);
+        int s = situacao_de(p, prox);
+        if (s == MOV_PENDENTE) {
+            atomic_store_explicit(&p->proximo[r],
+                                  atomic_load_explicit(&p->proximo[prox], memory_order_relaxed),
+                                  memory_order_relaxed);
+            pendentes->v[fica++] = r;
+        } else {
+            define_situacao(p, r, s == MOV_SUCESSO ? MOV_SUCESSO : MOV_FALHA);
+            resolveu = 1;
+        }
+    }
+    pendentes->n = fica;
+    return resolveu;
+}
+
+/*
+ * Etapa 2 para os robôs de 'lista', executada ao mesmo tempo por todos os
+ * trabalhadores, com 'id' o índice do trabalhador nas barreiras. Termina
+ * com todos os robôs resolvidos e depois de uma barreira.
+ */
+void resolve_movimentos(const Vetor *lista, int id, int turno)
+{
+    EstadoPlano *p = sim->plano;
+    Vetor *pendentes = &p->cadeias[id];
+    inicia_resolucao(lista, pendentes);
+    if (pendentes->n > 0)
+        atomic_store_explicit(&p->ha_pendente[0], marca_rodada(turno, 0), memory_order_relaxed);
+    barreira_espera(&sim->barreiras[SINC_RESOLUCAO], id);
+
+    // A rodada k usa os indicadores k % 2; a k + 2 só os reescreve depois de todos lerem
+    int k = 0;
+    while (atomic_load_explicit(&p->ha_pendente[k % 2], memory_order_relaxed) == marca_rodada(turno, k) &&
+           (k == 0 ||
+            atomic_load_explicit(&p->houve_resolucao[k % 2], memory_order_relaxed) == marca_rodada(turno, k))) {
+        k++;
+        if (salta_ponteiros(pendentes))
+            atomic_store_explicit(&p->houve_resolucao[k % 2], marca_rodada(turno, k), memory_order_relaxed);
+        if (pendentes->n > 0)
+            atomic_store_explicit(&p->ha_pendente[k % 2], marca_rodada(turno, k), memory_order_relaxed);
+        barreira_espera(&sim->barreiras[SINC_RESOLUCAO], id);
+    }
+
+    // Os que restam estão em ciclos, e os robôs de um ciclo giram juntos. Os outros
+    // trabalhadores leem a situação deles na etapa 3, então há mais uma barreira
+    if (atomic_load_explicit(&p->ha_pendente[k % 2], memory_order_relaxed) == marca_rodada(turno, k)) {
+        for (int q = 0; q < pendentes->n; q++)
+            define_situacao(p, pendentes->v[q], MOV_SUCESSO);
+        barreira_espera(&sim->barreiras[SINC_RESOLUCAO], id);
+    }
+}
+
+/* Índice em di e dj do movimento planejado do robô r */
+static inline int direcao_de(int r)
+{
+    Robos *rb = &sim->robos;
+    if (rb->move_i[r] != rb->i[r])
+        return rb->move_i[r] < rb->i[r] ? 0 : 1;
+    return rb->move_j[r] > rb->j[r] ? 2 : 3;
+}
+
+/* Etapa 3: aplica o movimento confirmado do robô na arena. Retorna 1 se ele se moveu */
+int confirma_movimento(int r)
+{
+    EstadoPlano *p = sim->plano;
+    Robos *rb = &sim->robos;
+    Arena *a = &sim->arena;
+    if (situacao_de(p, r) != MOV_SUCESSO)
+        return 0;
+
+    size_t destino = celula_em(a, rb->move_i[r], rb->move_j[r]);
+    size_t origem = celula_em(a, rb->i[r], rb->j[r]);
+    INSTR_ACESSO(arena_endereco_id(destino));
+    int era_forte = rb->energia[r] > 1;
+    int saindo = arena_id_em(a, destino);  // Ocupante que sai do destino neste turno, ou -1
+    char objeto = arena_obj_em(a, destino);
+
+    // Coleta o objeto presente na célula de destino (se houver)
+    switch (objeto)
+    {
+        case BATERIA:
+            rb->energia[r] += sim->energia_bateria;
+            break;
+        case FIGURA:
+            rb->frio[r].figuras_coletadas++;
+            break;
+    }
+    if (eventos_ativos)
+        eventos_movimento(r, rb->i[r], rb->j[r], direcao_de(r), objeto);
+    arena_poe_obj_em(a, destino, VAZIO);
+    arena_poe_id_em(a, destino, r);
+
+    // Libera a origem, a menos que outro robô esteja entrando nela
+    int entrando = reivindicante(p, origem);
+    int libera = entrando == SEM_REIVINDICACAO || situacao_de(p, entrando) != MOV_SUCESSO;
+    if (libera)
+        arena_poe_id_em(a, origem, -1);
+
+    Coordenada i = rb->i[r];
+    Coordenada j = rb->j[r];
+    rb->i[r] = rb->move_i[r];
+    rb->j[r] = rb->move_j[r];
+    rb->energia[r]--;
+    int forte = rb->energia[r] > 1;
+
+    // Uma célula vazia tem os bits desligados, e quem entra na célula de outro reescreve os bits dela
+    if (libera && saindo < 0) {
+        mapa_move_robo(i, j, rb->i[r], rb->j[r], era_forte, forte);
+        return 1;
+    }
+    if (libera) {
+        mapa_desliga(MAPA_OCUPADO, i, j);
+        mapa_desliga(MAPA_FORTE, i, j);
+    }
+    if (saindo < 0)
+        mapa_liga(MAPA_OCUPADO, rb->i[r], rb->j[r]);
+    mapa_energia(r);
+    return 1;
+}
+
+/*
+ * Vizinho de menor ID com mais de 1 de energia, ou -1. Só os vizinhos
+ * marcados no mapa de energia são lidos da arena.
+ */
+static int alvo_roubo(int r)
+{
+    Robos *rb = &sim->robos;
+    Arena *a = &sim->arena;
+    int alvo = -1;
+    int viz = mapa_vizinhos(MAPA_FORTE, rb->i[r], rb->j[r]);
+    while (viz) {
+        int d = __builtin_ctz(viz);
+        viz &= viz - 1;
+        int vizinho = arena_id_em(a, celula_em(a, rb->i[r] + di[d], rb->j[r] + dj[d]));
+        if (alvo < 0 || vizinho < alvo)
+            alvo = vizinho;
+    }
+    return alvo;
+}
+
+/* Etapa 4: limpa a reivindicação do turno e escolhe o alvo do roubo */
+void escolhe_alvo_roubo(int r)
+{
+    EstadoPlano *p = sim->plano;
+    Robos *rb = &sim->robos;
+    Arena *a = &sim->arena;
+    if (situacao_de(p, r) != MOV_PARADO)
+        atomic_store_explicit(reivindicacao_escrita(p, celula_em(a, rb->move_i[r], rb->move_j[r])),
+                              0, memory_order_relaxed);
+
+    rb->id_roubo_energia[r] = -1;
+    if (rb->energia[r] == 0) {
+        rb->id_roubo_energia[r] = alvo_roubo(r);
+        if (rb->id_roubo_energia[r] >= 0)
+            rb->energia_alvo[r] = rb->energia[rb->id_roubo_energia[r]];
+    }
+}
+
+/*
+ * Etapa 5: o ladrão conta quantos ladrões de ID menor têm o mesmo alvo
+ * (todos são vizinhos do alvo) e só recebe energia se o alvo ainda tiver
+ * mais de 1 depois de atendê-los. Retorna quanto deve ser descontado do
+ * alvo: o total roubado para o ladrão de menor ID e 0 para os demais,
+ * então cada robô é escrito por uma única thread.
+ */
+int realiza_roubo_planejado(int r)
+{
+    Robos *rb = &sim->robos;
+    Arena *a = &sim->arena;
+    int alvo = rb->id_roubo_energia[r];
+    if (alvo < 0)
+        return 0;
+
+    int antes = 0;   // Ladrões do mesmo alvo com ID menor
+    int total = 0;   // Todos os ladrões do alvo
+
+    int viz = mapa_vizinhos(MAPA_OCUPADO, rb->i[alvo], rb->j[alvo]);
+    while (viz) {
+        int d = __builtin_ctz(viz);
+        viz &= viz - 1;
+        int vizinho = arena_id_em(a, celula_em(a, rb->i[alvo] + di[d], rb->j[alvo] + dj[d]));
+        if (rb->id_roubo_energia[vizinho] == alvo) {
+            total++;
+            if (vizinho < r)
+                antes++;
+        }
+    }
+
+    int disponivel = rb->energia_alvo[r] - 1;
+    if (antes < disponivel) {
+        rb->energia[r]++;
+        if (eventos_ativos)
+            eventos_roubo(r, alvo);
+    }
+    if (antes == 0)
+        return (total < disponivel) ? total : disponivel;
+    return 0;
+}
+
+/* Desconta do alvo a energia roubada na etapa 5 */
+void desconta_energia(int alvo, int debito)
+{
+    sim->robos.energia[alvo] -= debito;
+    mapa_energia(alvo);
+}
+
+/*
+ * Indica, na etapa 4, se o robô fica sem nada a fazer: sem energia e sem
+ * alvo de roubo, ou com energia e sem movimentos. Roubos nunca deixam o
+ * alvo com menos de 1, então um robô com energia e sem movimentos nunca
+ * mais volta a ser ativo.
+ */
+static int robo_ocioso(int r)
+{
+    Robos *rb = &sim->robos;
+    if (rb->energia[r] == 0)
+        return rb->id_roubo_energia[r] < 0;
+    return rb->faltam[r] == 0;
+}
+
+/*
+ * O robô acabou de se mover e tem mais de 1 de energia: os vizinhos
+ * ociosos sem energia passam a ter de quem roubar. Cada um é acordado
+ * por um único robô, que escolhe o alvo dele e o põe na própria lista.
+ */
+static void acorda_vizinhos(int r, Vetor *lista)
+{
+    EstadoPlano *p = sim->plano;
+    Robos *rb = &sim->robos;
+    Arena *a = &sim->arena;
+    // Vizinhos com no máximo 1 de energia; só os com 0 interessam
+    int viz = mapa_vizinhos(MAPA_OCUPADO, rb->i[r], rb->j[r]) &
+              ~mapa_vizinhos(MAPA_FORTE, rb->i[r], rb->j[r]);
+    while (viz) {
+        int d = __builtin_ctz(viz);
+        viz &= viz - 1;
+        int vizinho = arena_id_em(a, celula_em(a, rb->i[r] + di[d], rb->j[r] + dj[d]));
+        if (rb->energia[vizinho] != 0 ||
+            atomic_load_explicit(&p->ativo[vizinho], memory_order_relaxed) ||
+            atomic_exchange_explicit(&p->ativo[vizinho], 1, memory_order_relaxed))
+            continue;
+        escolhe_alvo_roubo(vizinho);
+        vetor_poe(lista, vizinho);
+    }
+}
+
+/* Etapa 4 de uma lista de ativos: escolhe os alvos e retira os robôs ociosos */
+static void escolhe_alvos_lista(Vetor *lista)
+{
+    EstadoPlano *p = sim->plano;
+    int n = lista->n;
+    int fica = 0;
+
+    for (int k = 0; k < n; k++) {
+        int r = lista->v[k];
+        int moveu = situacao_de(p, r) == MOV_SUCESSO;
+
+        escolhe_alvo_roubo(r);
+        if (moveu && sim->robos.energia[r] > 1)
+            acorda_vizinhos(r, lista);
+        if (robo_ocioso(r)) {
+            define_situacao(p, r, MOV_PARADO);
+            atomic_store_explicit(&p->ativo[r], 0, memory_order_relaxed);
+        } else {
+            lista->v[fica++] = r;
+        }
+    }
+    // Os acordados nesta etapa foram postos depois dos n originais (a lista
+    // pode nunca ter sido alocada, então só move se houver acordados)
+    if (lista->n > n)
+        memmove(&lista->v[fica], &lista->v[n], sizeof(int) * (lista->n - n));
+    lista->n = fica + (lista->n - n);
+}
+
+static int conta_ativos()
+{
+    EstadoPlano *p = sim->plano;
+    int total = 0;
+    for (int t = 0; t < p->num_listas; t++)
+        total += p->ativos[t].n;
+    return total;
+}
+
+/* Emite os quadros dos turnos restantes, em que nada mais muda */
+static void adianta_turnos(int turno)
+{
+    sim->turnos_adiantados = sim->num_total_turnos - turno;
+    for (; turno < sim->num_total_turnos; turno++)
+        imprime_turno(turno);
+}
+
+static void *thread_plano(void *arg)
+{
+    Trabalhador *trab = (Trabalhador *)arg;
+    Vetor *lista = &sim->plano->ativos[trab->id];
+
+    // No início todos os robôs da fatia estão ativos
+    for (int r = trab->inicio; r < trab->fim; r++)
+        vetor_poe(lista, r);
+
+    for (int turno = sim->turno_inicial; turno < sim->num_total_turnos; turno++) {
+        // Imprime o estado atual da arena
+        // No primeiro turno as outras listas podem ainda estar sendo preenchidas
+        if (trab->id == 0) {
+            imprime_turno(turno);
+            int num_ativos = turno > sim->turno_inicial ? conta_ativos() : sim->num_robos;
+            sim->plano->sem_ativos = turno > sim->turno_inicial && num_ativos == 0;
+            // Com a maioria dos robôs ativa, percorrer as fatias sai mais barato que as listas
+            sim->plano->por_fatias = 2 * num_ativos >= sim->num_robos;
+        }
+        barreira_espera(&sim->barreiras[SINC_IMPRESSAO], trab->id);
+        if (sim->plano->sem_ativos) {
+            if (trab->id == 0)
+                adianta_turnos(turno + 1);
+            break;
+        }
+
+        if (sim->plano->por_fatias) {
+            planeja_fatia(trab->inicio, trab->fim, NULL);
+        } else {
+            for (int k = 0; k < lista->n; k++) {
+                int r = lista->v[k];
+                if (planeja_movimento(r))
+                    reivindica(celula(sim->robos.move_i[r], sim->robos.move_j[r]), r);
+            }
+        }
+        barreira_espera(&sim->barreiras[SINC_PLANO], trab->id);
+
+        resolve_movimentos(lista, trab->id, turno);
+
+        for (int k = 0; k < lista->n; k++)
+            confirma_movimento(lista->v[k]);
+        barreira_espera(&sim->barreiras[SINC_MOVIMENTO], trab->id);
+
+        escolhe_alvos_lista(lista);
+        barreira_espera(&sim->barreiras[SINC_ALVO_ROUBO], trab->id);
+
+        for (int k = 0; k < lista->n; k++) {
+            int r = lista->v[k];
+            int debito = realiza_roubo_planejado(r);
+            if (debito > 0)
+                desconta_energia(sim->robos.id_roubo_energia[r], debito);
+        }
+        barreira_espera(&sim->barreiras[SINC_ROUBO], trab->id);
+    }
+    return NULL;
+}
+
+/*
+ * Aloca o diretório de reivindicações, a situação dos robôs e os mapas de
+ * bits, para num_threads trabalhadores. O diretório começa sem blocos.
+ */
+void plano_inicia(int num_threads)
+{
+    EstadoPlano *p = (EstadoPlano *) calloc(1, sizeof(EstadoPlano));
+    sim->plano = p;
+
+    diretorio_cria(&p->reivindicacoes, sim->arena.num_ladrilhos, sizeof(ReivindicacoesLadrilho),
+                   NULL);
+
+    p->situacao = calloc(sim->num_robos > 0 ? sim->num_robos : 1, sizeof(*p->situacao));
+    p->proximo = calloc(sim->num_robos > 0 ? sim->num_robos : 1, sizeof(*p->proximo));
+    p->num_cadeias = num_threads;
+    p->cadeias = (Vetor *) calloc(num_threads, sizeof(Vetor));
+    // Nenhuma rodada tem marca negativa
+    for (int k = 0; k < 2; k++) {
+        atomic_store_explicit(&p->ha_pendente[k], -1, memory_order_relaxed);
+        atomic_store_explicit(&p->houve_resolucao[k], -1, memory_order_relaxed);
+    }
+    mapa_inicia(num_threads);
+}
+
+void plano_finaliza()
+{
+    EstadoPlano *p = sim->plano;
+    mapa_finaliza();
+    for (int t = 0; t < p->num_cadeias; t++)
+        free(p->cadeias[t].v);
+    free(p->cadeias);
+    free((void *) p->proximo);
+    free((void *) p->situacao);
+    diretorio_destroi(&p->reivindicacoes);
+    free(p);
+    sim->plano = NULL;
+}
+
+/* Executa a simulação com o motor de plano e confirmação */
+void executa_plano()
+{
+    int num_listas = trabalhadores_efetivos();
+    plano_inicia(num_listas);
+    EstadoPlano *p = sim->plano;
+    p->num_listas = num_listas;
+    p->ativos = (Vetor *) calloc(num_listas, sizeof(Vetor));
+    p->ativo = malloc(sim->num_robos > 0 ? sim->num_robos : 1);
+    memset((void *) p->ativo, 1, sim->num_robos);
+
+    executa_trabalhadores(thread_plano);
+
+    for (int t = 0; t < num_listas; t++)
+        free(p->ativos[t].v);
+    free(p->ativos);
+    free((void *) p->ativo);
+    plano_finaliza();
+}
@@ -0,0 +1,499 @@
+#ifndef __RALLY_H__
+#define __RALLY_H__
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "barreira.h"
+#include "diretorio.h"
+#include "sequencia.h"
+
+/* Tipos de objetos que podem estar presentes nas células da arena */
+#define VAZIO '.'     // Célula vazia
+#define PILAR 'x'     // Célula contendo um pilar (obstáculo fixo)
+#define BATERIA 'b'   // Célula com uma bateria (recarrega energia do robô)
+#define FIGURA 'f'    // Célula com uma figura (objetivo que deve ser coletado pelos robôs)
+
+/* Direções de movimento */
+#define NORTE 'N'     // Movimento para o Norte
+#define LESTE 'L'     // Movimento para o Leste
+#define SUL 'S'       // Movimento para o Sul
+#define OESTE 'O'     // Movimento para o Oeste
+
+/* Linha ou coluna da arena, ou uma dimensão dela: arenas podem passar de 2^31 células de lado */
+typedef int64_t Coordenada;
+
+/* Maior linha ou coluna lida da entrada (2^40) */
+#define MAX_COORDENADA ((Coordenada) 1 << 40)
+
+/* Número máximo de travas listradas da arena (potência de 2) */
+#define MAX_TRAVAS 4096
+
+/* Trava de um grupo de células, alinhada para não dividir linha de cache */
+typedef struct
+{
+    pthread_mutex_t mutex;
+} __attribute__((aligned(64))) TravaArena;
+
+/* Lado de um ladrilho da arena, em células (2^BITS_LADRILHO) */
+#define BITS_LADRILHO 6
+#define LADO_LADRILHO (1 << BITS_LADRILHO)
+#define CELULAS_LADRILHO (LADO_LADRILHO * LADO_LADRILHO)
+
+/* Máximo de posições de ladrilho de uma arena (arena_dimensoes_validas) */
+#define MAX_LADRILHOS ((size_t) 1 << 36)
+
+/* Células de um ladrilho, linha a linha; ocupa um número inteiro de páginas */
+typedef struct
+{
+    int id[CELULAS_LADRILHO];    // ID do robô presente em cada célula ou -1 se estiver vazia
+    char obj[CELULAS_LADRILHO];  // Objeto presente em cada célula (VAZIO, PILAR, BATERIA, FIGURA)
+} Ladrilho;
+
+/*
+ * Estrutura para representar a arena.
+ *
+ * A arena é dividida em ladrilhos de LADO_LADRILHO x LADO_LADRILHO
+ * células. Um ladrilho só é alocado na primeira escrita de um objeto ou
+ * de um robô numa célula dele; antes disso a posição dele no diretório
+ * tem um ladrilho vazio, então as suas células são lidas como vazias
+ * sem nenhum teste. O diretório e a
+ * reserva de onde os ladrilhos saem são os de diretorio.h, então a
+ * memória da arena cresce com o conteúdo, não com a área.
+ *
+ * As células são acessadas pelo índice de celula() com arena_obj,
+ * arena_id, arena_poe_obj e arena_poe_id. Em vez de um mutex por célula,
+ * a arena tem uma tabela pequena de travas listradas, e cada célula usa a
+ * trava escolhida por mutex_celula().
+ */
+typedef struct
+{
+    Diretorio ladrilhos;  // Ladrilho de cada posição, ou NULL se vazio
+    size_t num_ladrilhos;         // Posições do diretório
+    size_t ladrilhos_por_linha;   // Ladrilhos em cada faixa de LADO_LADRILHO linhas
+    TravaArena *travas;  // Tabela de travas listradas
+    int num_travas;  // Número de travas (potência de 2)
+    Coordenada n_lins;  // Número de linhas da arena
+    Coordenada n_cols;  // Número de colunas da arena
+} Arena;
+
+/*
+ * Robôs de cada pedaço que não divide linhas de cache: uma linha por
+ * vetor de int, duas pelos de Coordenada
+ */
+#define ROBOS_POR_LINHA (64 / (int) sizeof(int))
+
+/* Campos de um robô usados só por quem processa o robô, ou fora dos turnos */
+typedef struct
+{
+    int id;  // ID único do robô
+    int figuras_coletadas;  // Quantidade de figuras coletadas pelo robô
+    unsigned char *sequencia_movimentos;  // Sequência de movimentos programados, compactada (sequencia.h)
+    int tamanho_sequencia;  // Número total de movimentos programados
+    CursorSequencia cursor;  // Posição na sequência compactada depois da janela (Robos.janela)
+} RoboFrio;
+
+/* Trava de um robô (motores threads e pool), alinhada para não dividir linha de cache */
+typedef struct
+{
+    pthread_mutex_t mutex;
+} __attribute__((aligned(64))) TravaRobo;
+
+/* Número de vetores de campos quentes em Robos */
+#define NUM_CAMPOS_QUENTES 10
+
+/* Tamanho do elemento de cada vetor de campos quentes (rally_marciano.c) */
+extern const size_t tam_campos_quentes[NUM_CAMPOS_QUENTES];
+
+/*
+ * Estrutura para representar os robôs, como estrutura de vetores.
+ *
+ * Os campos lidos e escritos a cada turno, inclusive nos vizinhos, ficam
+ * cada um num vetor próprio indexado pelo ID do robô, todos numa única
+ * região e cada um começando numa linha de cache. A região começa em i e
+ * segue a ordem dos campos abaixo. Os demais ficam juntos em frio[], e as
+ * travas, uma por linha de cache, em travas[].
+ */
+typedef struct
+{
+    Coordenada *i;        // Linha atual de cada robô na arena
+    Coordenada *j;        // Coluna atual de cada robô na arena
+    int *energia;  // Energia restante de cada robô
+    Coordenada *move_i;   // Linha destino onde o robô pretende se mover
+    Coordenada *move_j;   // Coluna destino onde o robô pretende se mover
+    int *id_roubo_energia;  // ID do robô do qual o robô tentará roubar energia
+    int *energia_alvo;  // Energia do alvo do roubo no início da etapa
+    int *faltam;        // Movimentos que ainda faltam na sequência
+    uint32_t *janela;   // Próximos códigos de movimento já lidos da sequência (sequencia_recarrega)
+    int *na_janela;     // Códigos que faltam usar da janela; negativo: movimentos parados
+    RoboFrio *frio;     // Campos frios de cada robô
+    TravaRobo *travas;  // Trava de cada robô, ou NULL numa cópia
+    size_t tam_mapeado;  // Tamanho da região mapeada para os campos quentes
+} Robos;
+
+/* Motores de execução da simulação */
+typedef enum {
+    MOTOR_THREADS,  // Uma thread por robô (implementação original)
+    MOTOR_POOL,     // Pool fixo de trabalhadores, cada um dono de uma fatia de robos[]
+    MOTOR_PLANO,    // Pool com etapas de plano e confirmação determinísticas, sem travas
+    MOTOR_BLOCOS,   // Etapas do motor plano com a arena dividida em blocos por trabalhador
+    MOTOR_SEQUENCIAL,  // Referência numa única thread, com as mesmas regras do motor plano
+    MOTOR_OMP       // Etapas do motor plano numa região paralela OpenMP (compilado com OpenMP)
+} Motor;
+
+/* Pontos de sincronização de cada turno, cada um com sua barreira */
+typedef enum {
+    SINC_IMPRESSAO,   // Após a impressão do estado da arena (e do checkpoint)
+    SINC_INTENCOES,   // Após as intenções calculadas por fatias de IDs (motor de blocos)
+    SINC_PLANO,       // Após o plano dos movimentos (motor plano)
+    SINC_HALO,        // Após a troca das reivindicações de borda (motor de blocos)
+    SINC_RESOLUCAO,   // Após cada rodada da resolução dos conflitos (motor plano)
+    SINC_MOVIMENTO,   // Após a etapa de movimentação
+    SINC_ALVO_ROUBO,  // Após a escolha dos alvos de roubo (motor plano)
+    SINC_ROUBO,       // Após a etapa de roubo de energia
+    NUM_SINC
+} PontoSinc;
+
+/* Vetor dinâmico de inteiros */
+typedef struct {
+    int *v;
+    int n;
+    int cap;
+} Vetor;
+
+/* Trabalhador do pool: processa os robôs de índice [inicio, fim) */
+typedef struct {
+    int id;
+    int inicio;
+    int fim;
+} Trabalhador;
+
+/* Mapas de bits da arena dos motores de plano (mapa_bits.h) */
+typedef struct {
+    Diretorio ladrilhos;  // Mapas de cada posição do diretório da arena
+    int concorrente;  // 1 se mais de uma thread escreve nos mapas
+} MapaBits;
+
+/*
+ * Estado de uma simulação: a arena, os robôs, os parâmetros da execução e
+ * o estado dos motores enquanto executam.
+ *
+ * Os motores trabalham sobre a simulação apontada por sim, que é de cada
+ * thread. Uma thread criada com cria_thread_simulacao aponta para a
+ * simulação de quem a criou, então os trabalhadores de uma execução
+ * compartilham a simulação, e simulações diferentes (os contextos de
+ * librally.h) podem executar ao mesmo tempo, cada uma com as suas
+ * threads.
+ */
+typedef struct {
+    Arena arena;  // Estrutura representando a arena
+    Robos robos;  // Todos os robôs da simulação
+    int num_robos;  // Número total de robôs
+    int num_total_turnos;  // Número total de turnos da simulação
+    int turno_inicial;  // Turno em que a simulação começa (diferente de 0 ao retomar um checkpoint)
+    int energia_bateria;  // Quantidade de energia fornecida por uma bateria
+    Motor motor;  // Motor de execução escolhido na linha de comando
+    int num_trabalhadores;  // Número de trabalhadores do pool (padrão: núcleos online)
+    TipoBarreira tipo_barreira;  // Implementação das barreiras do turno
+    int mostra_tempos;  // Se diferente de 0, imprime o tempo gasto em cada barreira
+    int sem_saida;  // Se diferente de 0, não imprime os quadros nem os resultados
+    FILE *saida;    // Onde imprime_resultados escreve (stdout no programa)
+    int turnos_adiantados;  // Turnos finais pulados por não haver robôs ativos (motor plano)
+    int diferencial;  // Se diferente de 0, confere cada turno com o motor de referência
+    Barreira barreiras[NUM_SINC];
+
+    /* Estado dos motores durante uma execução */
+    MapaBits mapa;  // Motores de plano
+    struct EstadoPlano *plano;  // Motor plano e as etapas reaproveitadas (motor_plano.c)
+    struct EstadoBlocos *blocos;  // motor_blocos.c
+    struct EstadoEscalonador *escalonador;  // Filas do motor pool (escalonador.c)
+    struct Renderizador *renderizador;  // Quadros em impressão (renderizador.c), ou NULL
+    long pedacos_roubados;  // Pedaços roubados no motor pool, das execuções já finalizadas
+    struct EstadoReferencia *gabarito;  // Referência do modo diferencial, ou NULL
+} Simulacao;
+
+/* Simulação da thread, definida em rally_marciano.c; começa na do programa */
+extern __thread Simulacao *sim;
+
+extern const char *nomes_sinc[NUM_SINC];
+
+/* Declaração das funções auxiliares */
+void le_entrada();
+int le_entrada_dados(const char *dados, size_t tam);
+int le_entrada_fd(int fd);
+int le_robos(const char *arquivo);
+void imprime_turno(int turno);
+int turno_precisa_estado(int turno);
+void processa_robo(int r);
+void fase_movimento(int r);
+void fase_alvo_roubo(int r);
+void fase_roubo(int r);
+void calcula_roubo_energia(int r);
+void calcula_movimento(int r);
+void realiza_movimento(int r);
+void realiza_roubo_energia(int r);
+int eh_posicao_valida(Coordenada i, Coordenada j);
+void imprime_resultados();
+void imprime_tempos_barreiras(double segundos);
+
+void *thread_robo(void*arg);
+void *thread_trabalhador(void *arg);
+void executa_threads();
+void executa_pool();
+void executa_trabalhadores(void *(*funcao)(void *));
+int cria_thread_simulacao(pthread_t *thread, const pthread_attr_t *attr, void *(*funcao)(void *),
+                          void *arg);
+void executa_plano();
+void executa_omp();
+void executa_blocos();
+void executa_sequencial();
+void executa_motor();
+int motor_de_nome(const char *nome, Motor *m);
+int trabalhadores_efetivos();
+int inicio_fatia(int t, int n);
+void inicia_barreiras(int num_threads);
+void destroi_barreiras();
+
+/* Etapas do motor plano (motor_plano.c), reaproveitadas pelo motor de blocos */
+void plano_inicia(int num_threads);
+void plano_finaliza();
+int planeja_movimento(int r);
+/*
+ * Etapa 1 em lote: calcula_intencoes para [ini, fim), depois valida e
+ * reivindica cada destino; os robôs que tentam se mover vão para
+ * 'planejados', se não for NULL. valida_intencao é só a validação, para
+ * quem calculou as intenções antes.
+ */
+void planeja_fatia(int ini, int fim, Vetor *planejados);
+int valida_intencao(int r);
+void reivindica(size_t c, int id);
+void reivindica_local(size_t c, int id);
+void resolve_movimentos(const Vetor *lista, int id, int turno);
+int confirma_movimento(int r);
+void escolhe_alvo_roubo(int r);
+int realiza_roubo_planejado(int r);
+void desconta_energia(int alvo, int debito);
+
+/* Funções para alocação e destruição de memória */
+int arena_dimensoes_validas(Coordenada linhas, Coordenada colunas);
+void cria_arena(Arena *a, Coordenada linhas, Coordenada colunas);
+void cria_arena_copia(Arena *a, const Arena *base);
+void destroi_arena(Arena *a);
+Ladrilho *aloca_ladrilho_em(Arena *a, size_t posicao);
+Ladrilho *aloca_ladrilho(size_t posicao);
+void arena_poe_linha(Coordenada i, const char *obj);
+size_t arena_copia(Ladrilho **ladrilhos, size_t **posicoes, size_t *cap);
+void cria_robos(Robos *rb, int total);
+void aponta_robos(Robos *rb, char *regiao);
+void copia_robos(Robos *destino, const Robos *origem, int total);
+void libera_robos(Robos *rb);
+void destroi_robos(Robos *rb, int total);
+
+/*
+ * Índice da célula (i, j) da arena a: a posição do ladrilho nos bits
+ * altos e a célula dentro do ladrilho nos CELULAS_LADRILHO bits baixos.
+ */
+static inline size_t celula_em(const Arena *a, Coordenada i, Coordenada j)
+{
+    size_t l = (size_t) (i >> BITS_LADRILHO) * a->ladrilhos_por_linha +
+               (size_t) (j >> BITS_LADRILHO);
+    return l << (2 * BITS_LADRILHO) | (size_t) (i & (LADO_LADRILHO - 1)) << BITS_LADRILHO |
+           (size_t) (j & (LADO_LADRILHO - 1));
+}
+
+static inline size_t celula(Coordenada i, Coordenada j)
+{
+    return celula_em(&sim->arena, i, j);
+}
+
+/* Linha e coluna da célula de índice c */
+static inline Coordenada celula_linha(size_t c)
+{
+    size_t l = c >> (2 * BITS_LADRILHO);
+    return (Coordenada) (l / sim->arena.ladrilhos_por_linha) << BITS_LADRILHO |
+           (Coordenada) ((c >> BITS_LADRILHO) & (LADO_LADRILHO - 1));
+}
+
+static inline Coordenada celula_coluna(size_t c)
+{
+    size_t l = c >> (2 * BITS_LADRILHO);
+    return (Coordenada) (l % sim->arena.ladrilhos_por_linha) << BITS_LADRILHO |
+           (Coordenada) (c & (LADO_LADRILHO - 1));
+}
+
+/* Ladrilho da célula c da arena a para leitura: um ladrilho vazio se ele ainda não foi alocado */
+static inline const Ladrilho *ladrilho_em(const Arena *a, size_t c)
+{
+    return (const Ladrilho *) diretorio_bloco(&a->ladrilhos, c >> (2 * BITS_LADRILHO));
+}
+
+static inline const Ladrilho *ladrilho_de(size_t c)
+{
+    return ladrilho_em(&sim->arena, c);
+}
+
+/* 1 se o ladrilho da célula c de a já foi alocado */
+static inline int ladrilho_alocado_em(const Arena *a, size_t c)
+{
+    return diretorio_alocado(&a->ladrilhos, ladrilho_em(a, c));
+}
+
+/*
+ * Ladrilho da célula c de a para escrita. Se ele ainda não existe, ou
+ * está sendo iniciado por outra thread, espera por ele ou o aloca.
+ */
+static inline Ladrilho *ladrilho_escrita_em(Arena *a, size_t c)
+{
+    return (Ladrilho *) diretorio_escrita(&a->ladrilhos, c >> (2 * BITS_LADRILHO));
+}
+
+static inline Ladrilho *ladrilho_escrita(size_t c)
+{
+    return ladrilho_escrita_em(&sim->arena, c);
+}
+
+static inline char arena_obj_em(const Arena *a, size_t c)
+{
+    return ladrilho_em(a, c)->obj[c & (CELULAS_LADRILHO - 1)];
+}
+
+static inline int arena_id_em(const Arena *a, size_t c)
+{
+    return ladrilho_em(a, c)->id[c & (CELULAS_LADRILHO - 1)];
+}
+
+static inline char arena_obj(size_t c)
+{
+    return arena_obj_em(&sim->arena, c);
+}
+
+static inline int arena_id(size_t c)
+{
+    return arena_id_em(&sim->arena, c);
+}
+
+/* Endereço do ID da célula c, ou NULL se o ladrilho não existe (instrumentação) */
+static inline const int *arena_endereco_id(size_t c)
+{
+    if (!ladrilho_alocado_em(&sim->arena, c))
+        return NULL;
+    return &ladrilho_de(c)->id[c & (CELULAS_LADRILHO - 1)];
+}
+
+/*
+ * Escritas: esvaziar uma célula de um ladrilho que não existe não o
+ * aloca, e um ladrilho em criação ainda está todo vazio. Numa cópia
+ * (cria_arena_copia), a primeira escrita num ladrilho compartilhado o copia.
+ */
+static inline void arena_poe_obj_em(Arena *a, size_t c, char obj)
+{
+    size_t posicao = c >> (2 * BITS_LADRILHO);
+    Ladrilho *l = (Ladrilho *) ladrilho_em(a, c);
+    if (!diretorio_proprio(&a->ladrilhos, posicao, l)) {
+        if (obj == VAZIO && !diretorio_alocado(&a->ladrilhos, l))
+            return;
+        l = aloca_ladrilho_em(a, posicao);
+    }
+    l->obj[c & (CELULAS_LADRILHO - 1)] = obj;
+}
+
+static inline void arena_poe_id_em(Arena *a, size_t c, int id)
+{
+    size_t posicao = c >> (2 * BITS_LADRILHO);
+    Ladrilho *l = (Ladrilho *) ladrilho_em(a, c);
+    if (!diretorio_proprio(&a->ladrilhos, posicao, l)) {
+        if (id < 0 && !diretorio_alocado(&a->ladrilhos, l))
+            return;
+        l = aloca_ladrilho_em(a, posicao);
+    }
+    l->id[c & (CELULAS_LADRILHO - 1)] = id;
+}
+
+/* Ladrilhos alocados da arena a, em ordem de alocação, e a posição de cada um no diretório */
+static inline size_t arena_alocados(const Arena *a)
+{
+    return diretorio_alocados(&a->ladrilhos);
+}
+
+static inline const Ladrilho *arena_ladrilho_k(const Arena *a, size_t k)
+{
+    return (const Ladrilho *) diretorio_bloco_k(&a->ladrilhos, k);
+}
+
+static inline size_t arena_posicao_k(const Arena *a, size_t k)
+{
+    return diretorio_posicao_k(&a->ladrilhos, k);
+}
+
+static inline void arena_poe_obj(size_t c, char obj)
+{
+    arena_poe_obj_em(&sim->arena, c, obj);
+}
+
+static inline void arena_poe_id(size_t c, int id)
+{
+    arena_poe_id_em(&sim->arena, c, id);
+}
+
+/*
+ * Código do próximo movimento do robô r de rb (índice em direcao_codigo),
+ * ou -1 se ele fica parado neste movimento. Avança a sequência; só pode
+ * ser chamada enquanto rb->faltam[r] > 0.
+ */
+static inline int robo_proximo_codigo(Robos *rb, int r)
+{
+    if (rb->na_janela[r] == 0)
+        sequencia_recarrega(rb->frio[r].sequencia_movimentos, &rb->frio[r].cursor,
+                            &rb->janela[r], &rb->na_janela[r]);
+    rb->faltam[r]--;
+    if (rb->na_janela[r] < 0) {
+        rb->na_janela[r]++;
+        return -1;
+    }
+    rb->na_janela[r]--;
+    uint32_t janela = rb->janela[r];
+    rb->janela[r] = janela >> 2 | janela << 30;
+    return (int) (janela & 3);
+}
+
+/* Índice do próximo movimento do robô r na sequência */
+static inline int robo_movimento(const Robos *rb, int r)
+{
+    return rb->frio[r].tamanho_sequencia - rb->faltam[r];
+}
+
+/* Põe a sequência do robô r no movimento de índice 'movimento', com a janela vazia */
+static inline void robo_posiciona_sequencia(Robos *rb, int r, int movimento)
+{
+    RoboFrio *frio = &rb->frio[r];
+    memset(&frio->cursor, 0, sizeof(frio->cursor));
+    sequencia_avanca(frio->sequencia_movimentos, &frio->cursor, movimento);
+    rb->faltam[r] = frio->tamanho_sequencia - movimento;
+    rb->janela[r] = 0;
+    rb->na_janela[r] = 0;
+}
+
+static inline void vetor_poe(Vetor *vet, int x)
+{
+    if (vet->n == vet->cap) {
+        vet->cap = vet->cap ? vet->cap * 2 : 16;
+        vet->v = (int *) realloc(vet->v, sizeof(int) * vet->cap);
+    }
+    vet->v[vet->n++] = x;
+}
+
+/* Trava listrada responsável pela célula de índice c */
+static inline pthread_mutex_t *mutex_celula(size_t c)
+{
+    // Hash multiplicativo: vizinhos verticais não caem na mesma trava
+    uint64_t h = (uint64_t) c * 0x9E3779B97F4A7C15ULL;
+    return &sim->arena.travas[(h >> 32) & (sim->arena.num_travas - 1)].mutex;
+}
+
+
+#endif /*__RALLY_H__*/
@@ -16,290 +16,363 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <pthread.h>
-#include <semaphore.h>
 #include <string.h>
-#include <unistd.h>
-
-/* Tipos de objetos que podem estar presentes nas células da arena */
-#define VAZIO '.'     // Célula vazia
-#define PILAR 'x'     // Célula contendo um pilar (obstáculo fixo)
-#define BATERIA 'b'   // Célula com uma bateria (recarrega energia do robô)
-#define FIGURA 'f'    // Célula com uma figura (objetivo que deve ser coletado pelos robôs)
-
-/* Direções de movimento */
-#define NORTE 'N'     // Movimento para o Norte
-#define LESTE 'L'     // Movimento para o Leste
-#define SUL 'S'       // Movimento para o Sul
-#define OESTE 'O'     // Movimento para o Oeste
-
-/* Estrutura para representar uma célula da arena */
-typedef struct
-{
-    char obj;  // Objeto presente na célula (VAZIO, PILAR, BATERIA, FIGURA)
-    int id;    // ID do robô presente na célula ou -1 se estiver vazia
-    pthread_mutex_t mutex_celula;
-} CelulaArena;
-
-/* Estrutura para representar a arena */
-typedef struct
-{
-    CelulaArena **cel;  // Matriz que representa as células da arena
-    int n_lins;  // Número de linhas da arena
-    int n_cols;  // Número de colunas da arena
-} Arena;
-
-/* Estrutura para representar um robô */
-typedef struct
-{
-    int id;  // ID único do robô
-    int i;   // Linha atual do robô na arena
-    int j;   // Coluna atual do robô na arena
-    int energia;  // Energia restante do robô
-    int figuras_coletadas;  // Quantidade de figuras coletadas pelo robô
-    char *sequencia_movimentos;  // Sequência de movimentos programados para o robô
-    int tamanho_sequencia;  // Número total de movimentos programados
-    int id_movimento;  // Índice do movimento atual na sequência
-
-    int move_i;  // Linha destino onde o robô pretende se mover
-    int move_j;  // Coluna destino onde o robô pretende se mover
-    int id_roubo_energia;  // ID do robô do qual o robô tentará roubar energia
-    int id_antigo;
-
-    pthread_mutex_t mutex_robo; // mutex para cada robô
-} Robo;
-
-typedef struct {
-    pthread_mutex_t mutex;
-    pthread_cond_t cond;
-    int contador;
-    int num_threads;
-} barrier_t;
-
-typedef enum {
-    false, true
-} bool;
-
-/* Variáveis globais */
-Arena arena;  // Estrutura representando a arena
-Robo *robos;  // Array contendo todos os robôs da simulação
-int num_robos;  // Número total de robôs
-int num_total_turnos;  // Número total de turnos da simulação
-int energia_bateria;  // Quantidade de energia fornecida por uma bateria
-
-
-/* Declaração das funções auxiliares */
-void le_entrada();
-void imprime_estado();
-void processa_robo(Robo *robo);
-void calcula_roubo_energia(Robo *robot);
-void calcula_movimento(Robo *robo);
-void realiza_movimento(Robo *robo);
-void realiza_roubo_energia(Robo *robot);
-int eh_posicao_valida(int i, int j);
-void imprime_resultados();
-
-void *thread_robo(void*arg);
-
-/* Funções para alocação e destruição de memória */
-void cria_arena(Arena *a, int linhas, int colunas);
-void destroi_arena(Arena *arena);
-void destroi_robos(Robo *robos, int num_robos);
-
-bool movimento (int id) {
-    if (robos[id].move_i == robos[id].i && robos[id].move_j == robos[id].j) {
+#include <stdint.h>
+#include <stdbool.h>
+#include <sys/mman.h>
+
+#include "rally.h"
+#include "renderizador.h"
+#include "checkpoint.h"
+#include "referencia.h"
+#include "instrumentacao.h"
+#include "topologia.h"
+#include "eventos.h"
+#include "escalonador.h"
+
+/* Simulação do programa; os contextos de librally.h têm cada um a sua */
+static Simulacao simulacao_principal = {
+    .motor = MOTOR_THREADS,
+    .tipo_barreira = BARREIRA_CONDVAR,
+};
+
+__thread Simulacao *sim = &simulacao_principal;
+
+static bool movimento (int id) {
+    if (sim->robos.move_i[id] == sim->robos.i[id] && sim->robos.move_j[id] == sim->robos.j[id]) {
         return false;
     }
     return true;
 }
 
-barrier_t barrier;
+const char *nomes_sinc[NUM_SINC] = {
+    [SINC_IMPRESSAO] = "impressão",
+    [SINC_INTENCOES] = "intenções",
+    [SINC_PLANO] = "plano",
+    [SINC_HALO] = "halo",
+    [SINC_RESOLUCAO] = "resolução",
+    [SINC_MOVIMENTO] = "movimento",
+    [SINC_ALVO_ROUBO] = "alvo roubo",
+    [SINC_ROUBO] = "roubo",
+};
 
-void barrier_init(barrier_t *barrier, int num_threads) {
-    pthread_mutex_init(&barrier->mutex, NULL);
-    pthread_cond_init(&barrier->cond, NULL);
-    barrier->contador = 0;
-    barrier->num_threads = num_threads;
+/*
+ * Cria as barreiras do turno para num_threads threads. A thread chamadora
+ * pode ter medido outra execução, então a sua última saída é esquecida.
+ */
+void inicia_barreiras(int num_threads)
+{
+    barreira_inicia_thread();
+    for (int p = 0; p < NUM_SINC; p++)
+        barreira_init(&sim->barreiras[p], sim->tipo_barreira, num_threads, sim->mostra_tempos);
 }
 
-void barrier_wait(barrier_t *barrier) {
-    pthread_mutex_lock(&barrier->mutex);
+void destroi_barreiras()
+{
+    for (int p = 0; p < NUM_SINC; p++)
+        barreira_destroi(&sim->barreiras[p]);
+}
 
-    barrier->contador++;
+/* Início de uma thread de cria_thread_simulacao */
+typedef struct {
+    Simulacao *sim;
+    void *(*funcao)(void *);
+    void *arg;
+} InicioThread;
 
-    if (barrier->contador == barrier->num_threads) {
-        barrier->contador = 0;
-        pthread_cond_broadcast(&barrier->cond);
-    } else {
-        pthread_cond_wait(&barrier->cond, &barrier->mutex);
-    }
-    pthread_mutex_unlock(&barrier->mutex);
+static void *inicia_thread_simulacao(void *arg)
+{
+    InicioThread inicio = *(InicioThread *) arg;
+    free(arg);
+    sim = inicio.sim;
+    return inicio.funcao(inicio.arg);
 }
 
-void barrier_destroy(barrier_t *barrier) {
-    pthread_mutex_destroy(&barrier->mutex);
-    pthread_cond_destroy(&barrier->cond);
+/* Como pthread_create, mas a nova thread trabalha na simulação de quem a cria */
+int cria_thread_simulacao(pthread_t *thread, const pthread_attr_t *attr, void *(*funcao)(void *),
+                          void *arg)
+{
+    InicioThread *inicio = (InicioThread *) malloc(sizeof(InicioThread));
+    *inicio = (InicioThread) { sim, funcao, arg };
+    int erro = pthread_create(thread, attr, inicia_thread_simulacao, inicio);
+    if (erro)
+        free(inicio);
+    return erro;
 }
 
 void *thread_robo(void*arg) {
     
-    Robo *robo = (Robo *)arg;
+    int r = (int) (intptr_t) arg;
 
-    for (int turno = 0; turno < num_total_turnos; turno++) {
+    for (int turno = sim->turno_inicial; turno < sim->num_total_turnos; turno++) {
         // Imprime o estado atual da arena
-        if (robo->id == 0) {
-            printf("Turno %d:\n", turno);
-            imprime_estado();
-        }
-        barrier_wait(&barrier);
+        if (r == 0)
+            imprime_turno(turno);
+        barreira_espera(&sim->barreiras[SINC_IMPRESSAO], r);
         // Processameno do robô com seu mutex
-        processa_robo(robo);
+        processa_robo(r);
     }
     pthread_exit(NULL);
 }
 
-int main()
+/*
+ * Thread do pool: executa as mesmas etapas de processa_robo, mas para todos
+ * os robôs da sua fatia, com as barreiras entre as etapas valendo para o
+ * pool inteiro. Assim o turno mantém a mesma semântica do motor original.
+ * A fatia é dividida em pedaços, e quem termina a sua rouba pedaços das
+ * fatias dos outros (escalonador.h).
+ */
+void *thread_trabalhador(void *arg)
 {
-    /* Leitura da entrada e inicialização da arena e dos robôs */
-    le_entrada();
+    Trabalhador *trab = (Trabalhador *)arg;
+
+    for (int turno = sim->turno_inicial; turno < sim->num_total_turnos; turno++) {
+        // Imprime o estado atual da arena
+        if (trab->id == 0)
+            imprime_turno(turno);
+        barreira_espera(&sim->barreiras[SINC_IMPRESSAO], trab->id);
+
+        // Etapa de movimentação da fatia
+        escalonador_executa(trab->id, fase_movimento);
+        barreira_espera(&sim->barreiras[SINC_MOVIMENTO], trab->id);
+
+        // Etapa de roubo de energia da fatia: primeiro os alvos, depois o roubo
+        escalonador_executa(trab->id, fase_alvo_roubo);
+        barreira_espera(&sim->barreiras[SINC_ALVO_ROUBO], trab->id);
+        escalonador_executa(trab->id, fase_roubo);
+        barreira_espera(&sim->barreiras[SINC_ROUBO], trab->id);
+    }
+    return NULL;
+}
 
-    barrier_init(&barrier, num_robos);
+/* Executa a simulação com uma thread por robô */
+void executa_threads()
+{
+    inicia_barreiras(sim->num_robos);
 
-    pthread_t threads[num_robos];
+    pthread_t *threads = (pthread_t *) malloc(sizeof(pthread_t) * sim->num_robos);
 
-    for (int i = 0; i < num_robos; i++) {
-        pthread_mutex_init(&robos[i].mutex_robo, NULL);
-    }
-   
-    for (int r = 0; r < num_robos; r++)
+    for (int r = 0; r < sim->num_robos; r++)
     {
-        pthread_create(&threads[r], NULL, thread_robo, (void *)&robos[r]);
+        cria_thread_simulacao(&threads[r], NULL, thread_robo, (void *) (intptr_t) r);
     }
         
-    for (int r = 0; r < num_robos; r++)
+    for (int r = 0; r < sim->num_robos; r++)
     {
         pthread_join(threads[r], NULL);
     }
-    
-
-    /* Imprime os resultados da simulação */
-    printf("Turno %d:\n", num_total_turnos);
-    imprime_estado();
-    imprime_resultados();
-
-    barrier_destroy(&barrier);
 
-    /* Liberação de memória alocada */
-    destroi_arena(&arena);
-    destroi_robos(robos, num_robos);
-
-    return 0;
+    free(threads);
 }
 
-/* Função para ler a entrada e configurar a arena e os robôs */
-void le_entrada()
+/* Número de trabalhadores que o pool realmente usa */
+int trabalhadores_efetivos()
 {
-    int N, M, R, T;
-
-    /* Lê as dimensões da arena, número de robôs, energia por bateria e o número de turnos */
-    scanf("%d %d %d %d %d", &N, &M, &R, &energia_bateria, &T);
+    // Não faz sentido ter mais trabalhadores do que robôs
+    int n = sim->num_trabalhadores;
+    if (n > sim->num_robos)
+        n = sim->num_robos;
+    if (n < 1)
+        n = 1;
+    return n;
+}
 
-    /* Cria a arena */
-    cria_arena(&arena, N, M);
+/*
+ * Início da fatia do trabalhador t entre n. As fatias começam em múltiplos
+ * de ROBOS_POR_LINHA, então dois trabalhadores nunca escrevem na mesma
+ * linha de cache dos vetores de campos quentes.
+ */
+int inicio_fatia(int t, int n)
+{
+    if (t == n)
+        return sim->num_robos;
+    int inicio = (int) ((long) sim->num_robos * t / n);
+    return inicio - inicio % ROBOS_POR_LINHA;
+}
 
-    /* Cria os robôs */
-    robos = (Robo *) malloc(sizeof(Robo) * R);
+/*
+ * Cria um pool fixo de trabalhadores executando 'funcao', cada um dono de
+ * uma fatia contígua dos robôs, e espera todos terminarem.
+ */
+void executa_trabalhadores(void *(*funcao)(void *))
+{
+    int n = trabalhadores_efetivos();
+
+    inicia_barreiras(n);
+
+    // Com -N, cada trabalhador toca primeiro uma faixa de linhas da arena e a sua fatia
+    Posse *posses = (Posse *) malloc(sizeof(Posse) * n);
+    for (int t = 0; t < n; t++) {
+        posses[t].lin_ini = sim->arena.n_lins * t / n;
+        posses[t].lin_fim = sim->arena.n_lins * (t + 1) / n;
+        posses[t].col_ini = 0;
+        posses[t].col_fim = sim->arena.n_cols;
+        posses[t].robo_ini = inicio_fatia(t, n);
+        posses[t].robo_fim = inicio_fatia(t + 1, n);
+    }
+    topologia_distribui(posses, n);
+    free(posses);
 
-    arena.n_lins = N;
-    arena.n_cols = M;
-    num_robos = R;
-    num_total_turnos = T;
+    pthread_t *threads = (pthread_t *) malloc(sizeof(pthread_t) * n);
+    Trabalhador *trabs = (Trabalhador *) malloc(sizeof(Trabalhador) * n);
 
-    /* Lê a configuração da arena */
-    char line[102];
-    for (int i = 0; i < N; i++)
+    // Divide os robôs em fatias contíguas de tamanho quase igual
+    for (int t = 0; t < n; t++)
     {
-        scanf("%s", line);
-        for (int j = 0; j < M; j++)
-        {
-            arena.cel[i][j].obj = line[j];
-            arena.cel[i][j].id = -1;  // Inicialmente, nenhuma célula contém robôs
-        }
+        trabs[t].id = t;
+        trabs[t].inicio = inicio_fatia(t, n);
+        trabs[t].fim = inicio_fatia(t + 1, n);
+        pthread_attr_t attr;
+        pthread_attr_t *a = topologia_atributos(&attr, t, n);
+        cria_thread_simulacao(&threads[t], a, funcao, (void *)&trabs[t]);
+        if (a)
+            pthread_attr_destroy(a);
     }
 
-    /* Lê as posições iniciais dos robôs */
-    for (int i = 0; i < R; i++)
+    for (int t = 0; t < n; t++)
     {
-        scanf("%d %d", &robos[i].i, &robos[i].j);  // Posição inicial do robô
-        robos[i].id = i;
-        robos[i].energia = energia_bateria;
-        robos[i].figuras_coletadas = 0;
-        robos[i].id_movimento = 0;
-        arena.cel[robos[i].i][robos[i].j].id = robos[i].id;  // Atualiza a posição na arena
+        pthread_join(threads[t], NULL);
     }
 
-    char format[20];
+    free(trabs);
+    free(threads);
+}
 
-    /* Lê a sequência de movimentos de cada robô */
-    for (int i = 0; i < R; i++)
-    {
-        int n_mov = 0;
-        scanf("%d", &n_mov);
-        robos[i].tamanho_sequencia = n_mov;
+/* Executa a simulação com um pool fixo de trabalhadores */
+void executa_pool()
+{
+    escalonador_inicia(trabalhadores_efetivos());
+    executa_trabalhadores(thread_trabalhador);
+    escalonador_finaliza();
+}
 
-        /* Aloca memória para armazenar a sequência de movimentos */
-        robos[i].sequencia_movimentos = (char *) malloc(sizeof(char) * (n_mov + 1));
+/*
+ * Converte o nome de um motor (threads, pool, plano, blocos, sequencial e,
+ * compilado com OpenMP, omp). Retorna 0 se inválido
+ */
+int motor_de_nome(const char *nome, Motor *m)
+{
+    static const char *nomes[] = {
+        [MOTOR_THREADS] = "threads",
+        [MOTOR_POOL] = "pool",
+        [MOTOR_PLANO] = "plano",
+        [MOTOR_BLOCOS] = "blocos",
+        [MOTOR_SEQUENCIAL] = "sequencial",
+#ifdef _OPENMP
+        [MOTOR_OMP] = "omp",
+#endif
+    };
+    for (int k = 0; k < (int) (sizeof(nomes) / sizeof(nomes[0])); k++)
+        if (nomes[k] && strcmp(nome, nomes[k]) == 0) {
+            *m = (Motor) k;
+            return 1;
+        }
+    return 0;
+}
 
-        /* Lê a sequência de movimentos */
-        sprintf(format, "%%%ds", n_mov);
-        scanf(format, robos[i].sequencia_movimentos);
-    }
+/* Executa os turnos [turno_inicial, num_total_turnos) com o motor escolhido */
+void executa_motor()
+{
+    if (sim->motor == MOTOR_POOL)
+        executa_pool();
+    else if (sim->motor == MOTOR_PLANO)
+        executa_plano();
+    else if (sim->motor == MOTOR_BLOCOS)
+        executa_blocos();
+    else if (sim->motor == MOTOR_SEQUENCIAL)
+        executa_sequencial();
+#ifdef _OPENMP
+    else if (sim->motor == MOTOR_OMP)
+        executa_omp();
+#endif
+    else
+        executa_threads();
+}
+
+/*
+ * Indica se o estado da simulação precisa estar completo no início do turno
+ * (checkpoint ou diferencial), o que o motor de blocos só garante com uma
+ * barreira a mais.
+ */
+int turno_precisa_estado(int turno)
+{
+    return sim->diferencial || checkpoint_devido(turno);
+}
+
+/*
+ * Função para imprimir o estado atual da arena. Só copia a arena para o
+ * renderizador; a formatação e a escrita acontecem na thread de E/S.
+ * Como as demais threads estão paradas na barreira, é também aqui que o
+ * checkpoint do turno é tirado.
+ */
+void imprime_turno(int turno)
+{
+    if (sim->diferencial)
+        diferencial_turno(turno);
+    checkpoint_turno(turno);
+    eventos_turno(turno);
+    if (!sim->sem_saida)
+        renderizador_quadro(turno, arena_copia, 0);
+}
+
+void processa_robo(int r)
+{
+    // O ID do robô é o índice da sua thread nas barreiras
+    fase_movimento(r);
+    barreira_espera(&sim->barreiras[SINC_MOVIMENTO], r);
+
+    fase_alvo_roubo(r);
+    barreira_espera(&sim->barreiras[SINC_ALVO_ROUBO], r);
+
+    fase_roubo(r);
+    barreira_espera(&sim->barreiras[SINC_ROUBO], r);
 }
 
-/* Função para imprimir o estado atual da arena */
-void imprime_estado()
+/* Etapa de movimentação para robôs com energia */
+void fase_movimento(int r)
 {
-    for (int i = 0; i < arena.n_lins; i++)
+    INSTR_ACESSO(&sim->robos.energia[r]);
+    if (sim->robos.energia[r] > 0)
     {
-        for (int j = 0; j < arena.n_cols; j++)
-        {
-            if (arena.cel[i][j].id == -1)
-            {
-                printf(" %c  ", arena.cel[i][j].obj);  // Imprime o objeto na célula
-            } else
-            {
-                printf("(%d) ", arena.cel[i][j].id);  // Imprime o ID do robô presente
-            }
-        }
-        printf("\n");
+        // Planeja e executa o movimento
+        calcula_movimento(r);
+        INSTR_ACESSO(eh_posicao_valida(sim->robos.move_i[r], sim->robos.move_j[r]) ?
+                     arena_endereco_id(celula(sim->robos.move_i[r], sim->robos.move_j[r])) : NULL);
+        INSTR_INICIO(movimento);
+        realiza_movimento(r);
+        INSTR_FIM(movimento, REGIAO_REALIZA_MOVIMENTO);
     }
-    fflush(stdout);
 }
 
-void processa_robo(Robo *robo)
+/*
+ * Escolha do alvo do roubo. Nesta etapa ninguém altera energia, então
+ * todos os ladrões veem a mesma energia dos vizinhos, que é guardada em
+ * energia_alvo para a etapa de roubo.
+ */
+void fase_alvo_roubo(int r)
 {
-    // Etapa de movimentação para robôs com energia
-    if (robo->energia > 0)
+    sim->robos.id_roubo_energia[r] = -1;
+    if (sim->robos.energia[r] == 0)
     {
-        // Planeja e executa o movimento
-        calcula_movimento(robo);
-        realiza_movimento(robo);
+        calcula_roubo_energia(r);
+        if (sim->robos.id_roubo_energia[r] >= 0)
+            sim->robos.energia_alvo[r] = sim->robos.energia[sim->robos.id_roubo_energia[r]];
     }
-    barrier_wait(&barrier);
+}
 
-    // Etapa de roubo para robôs sem energia
-    if (robo->energia == 0)
+/* Etapa de roubo para robôs sem energia que têm um alvo */
+void fase_roubo(int r)
+{
+    if (sim->robos.id_roubo_energia[r] >= 0)
     {
-        robo->id_antigo = robo->id;
-        robo->id = num_robos;  // Temporariamente altera o ID para evitar conflitos
-        calcula_roubo_energia(robo);
-        robo->id = robo->id_antigo;
-        realiza_roubo_energia(robo);
+        INSTR_INICIO(roubo);
+        realiza_roubo_energia(r);
+        INSTR_FIM(roubo, REGIAO_REALIZA_ROUBO);
     }
-    barrier_wait(&barrier);
 }
 
 /* Função que define a intenção de roubo de energia */
-void calcula_roubo_energia(Robo *robot)
+void calcula_roubo_energia(int r)
 {
     // Arrays para representar as direções Norte, Sul, Leste e Oeste
     int di[] = {-1, 1, 0, 0}; // Movimentos verticais
@@ -310,16 +383,16 @@ void calcula_roubo_energia(Robo *robot)
     // Verifica robôs vizinhos para decidir de quem roubar energia
     for (int i = 0; i < 4; i++)
     {
-        int ni = robot->i + di[i];  // Calcula a nova linha do vizinho
-        int nj = robot->j + dj[i];  // Calcula a nova coluna do vizinho
+        Coordenada ni = sim->robos.i[r] + di[i];  // Calcula a nova linha do vizinho
+        Coordenada nj = sim->robos.j[r] + dj[i];  // Calcula a nova coluna do vizinho
 
         // Verifica se a posição do vizinho é válida na arena
         if (eh_posicao_valida(ni, nj))
         {
-            int robo_vizinho = arena.cel[ni][nj].id;
+            int robo_vizinho = arena_id(celula(ni, nj));
 
             // Se houver um robô vizinho com mais de 1 unidade de energia, ele é um alvo
-            if (robo_vizinho >= 0 && robos[robo_vizinho].energia > 1)
+            if (robo_vizinho >= 0 && sim->robos.energia[robo_vizinho] > 1)
             {
                 // Prioriza o robô de menor ID para ser roubado
                 if (id_robo_roubo < 0 || robo_vizinho < id_robo_roubo)
@@ -331,39 +404,39 @@ void calcula_roubo_energia(Robo *robot)
     }
 
     // Define a intenção de roubo de energia do robô vizinho
-    robot->id_roubo_energia = id_robo_roubo;
+    sim->robos.id_roubo_energia[r] = id_robo_roubo;
     return;
 }
 
 /* Função para planejar o próximo movimento do robô */
-void calcula_movimento(Robo *robo)
+void calcula_movimento(int r)
 {
     // Inicialmente, a intenção de movimento é permanecer na mesma posição
-    robo->move_i = robo->i;
-    robo->move_j = robo->j;
+    sim->robos.move_i[r] = sim->robos.i[r];
+    sim->robos.move_j[r] = sim->robos.j[r];
 
     // Verifica se o robô ainda tem movimentos programados
-    if (robo->id_movimento >= robo->tamanho_sequencia)
+    if (sim->robos.faltam[r] == 0)
         return;
 
     // Obtém a direção do próximo movimento a partir da sequência programada
-    char direcao = robo->sequencia_movimentos[robo->id_movimento];
-    robo->id_movimento++;  // Atualiza o índice para o próximo movimento
+    int codigo = robo_proximo_codigo(&sim->robos, r);
+    char direcao = codigo < 0 ? 0 : direcao_codigo[codigo];
 
     // Atualiza a posição pretendida com base na direção
     switch (direcao)
     {
         case NORTE:
-            robo->move_i -= 1;  // Movimenta para o norte
+            sim->robos.move_i[r] -= 1;  // Movimenta para o norte
             break;
         case SUL:
-            robo->move_i += 1;  // Movimenta para o sul
+            sim->robos.move_i[r] += 1;  // Movimenta para o sul
             break;
         case LESTE:
-            robo->move_j += 1;  // Movimenta para o leste
+            sim->robos.move_j[r] += 1;  // Movimenta para o leste
             break;
         case OESTE:
-            robo->move_j -= 1;  // Movimenta para o oeste
+            sim->robos.move_j[r] -= 1;  // Movimenta para o oeste
             break;
         default:
             break;  // Direção inválida, o robô permanece na mesma posição
@@ -371,176 +444,197 @@ void calcula_movimento(Robo *robo)
 }
 
 /* Função para realizar o movimento do robô */
-void realiza_movimento(Robo *robo)
+void realiza_movimento(int r)
 {   
-    pthread_mutex_lock(&robo->mutex_robo);
+    pthread_mutex_t *mutex_robo = &sim->robos.travas[r].mutex;
+    trava_robo(mutex_robo);
     // Verifica se o robô ainda tem energia para se mover
-    if (robo->energia == 0) {
-        pthread_mutex_unlock(&robo->mutex_robo);
+    if (sim->robos.energia[r] == 0) {
+        pthread_mutex_unlock(mutex_robo);
         return;
     }
 
     // Verifica se a posição para onde o robô deseja se mover é válida
-    if (!eh_posicao_valida(robo->move_i, robo->move_j)) {
-        pthread_mutex_unlock(&robo->mutex_robo);
-        robo->move_i = robo->i;
-        robo->move_j = robo->j;
+    if (!eh_posicao_valida(sim->robos.move_i[r], sim->robos.move_j[r])) {
+        pthread_mutex_unlock(mutex_robo);
+        sim->robos.move_i[r] = sim->robos.i[r];
+        sim->robos.move_j[r] = sim->robos.j[r];
         return;
     }
 
     // Obtenção das células atuais e de destino
-    CelulaArena *nova_cel = &arena.cel[robo->move_i][robo->move_j];
-    CelulaArena *cel = &arena.cel[robo->i][robo->j];
+    size_t nova_cel = celula(sim->robos.move_i[r], sim->robos.move_j[r]);
+    size_t cel = celula(sim->robos.i[r], sim->robos.j[r]);
 
     // lock na célula de destino
-    pthread_mutex_lock(&nova_cel->mutex_celula);
+    trava_celula(mutex_celula(nova_cel), nova_cel);
 
     // Verifica se a célula de destino está vazia e não é um obstáculo (pilar)
-    if (nova_cel->obj != PILAR && nova_cel->id < 0)
+    if (arena_obj(nova_cel) != PILAR && arena_id(nova_cel) < 0)
     {
         // Coleta o objeto presente na célula de destino (se houver)
-        switch (nova_cel->obj)
+        switch (arena_obj(nova_cel))
         {
             case BATERIA:
-                robo->energia += energia_bateria;  // Recarrega energia com a bateria
+                sim->robos.energia[r] += sim->energia_bateria;  // Recarrega energia com a bateria
                 break;
             case FIGURA:
-                robo->figuras_coletadas++;  // Coleta a figura
+                sim->robos.frio[r].figuras_coletadas++;  // Coleta a figura
                 break;
         }
 
         // Limpa o objeto da célula de destino após coleta
-        nova_cel->obj = VAZIO;
+        arena_poe_obj(nova_cel, VAZIO);
 
         // Atualiza as células da arena com a nova posição do robô
-        if (cel->id == robo->id)
-            cel->id = -1;  // Remove o robô da célula atual
+        if (arena_id(cel) == sim->robos.frio[r].id)
+            arena_poe_id(cel, -1);  // Remove o robô da célula atual
 
         // Define o ID do robô na nova célula
-        nova_cel->id = robo->id;
+        arena_poe_id(nova_cel, sim->robos.frio[r].id);
 
         // Atualiza a posição do robô na arena
-        robo->i = robo->move_i;
-        robo->j = robo->move_j;
+        sim->robos.i[r] = sim->robos.move_i[r];
+        sim->robos.j[r] = sim->robos.move_j[r];
 
         // Reduz a energia do robô após o movimento
-        robo->energia--;
+        sim->robos.energia[r]--;
 
-    } else if (nova_cel->id >= 0 && movimento(nova_cel->id)) {
+    } else if (arena_id(nova_cel) >= 0 && movimento(arena_id(nova_cel))) {
         // Atualiza as células da arena com a nova posição do robô    
-        cel->id = -1;
+        arena_poe_id(cel, -1);
         // Atualiza a posição do robô na arena
-        robo->i = robo->move_i;
-        robo->j = robo->move_j;
-        nova_cel->id = robo->id;
+        sim->robos.i[r] = sim->robos.move_i[r];
+        sim->robos.j[r] = sim->robos.move_j[r];
+        arena_poe_id(nova_cel, sim->robos.frio[r].id);
         // Reduz a energia do robô após o movimento
-        robo->energia--;
-        }
-        pthread_mutex_unlock(&robos[nova_cel->id].mutex_robo);
-    pthread_mutex_unlock(&robo->mutex_robo);
+        sim->robos.energia[r]--;
+    }
+    pthread_mutex_unlock(mutex_celula(nova_cel));
+    pthread_mutex_unlock(mutex_robo);
 }
 
-/* Função que realiza o roubo de energia de um robô vizinho */
-void realiza_roubo_energia(Robo *robot)
-{   
-    pthread_mutex_lock(&robot->mutex_robo);
-    // Verifica se o robô já possui energia suficiente
-    if (robot->energia > 0) {
-        pthread_mutex_unlock(&robot->mutex_robo);
-        return;  // Robô não precisa roubar energia
-    }
-    int id_roubo = robot->id_roubo_energia;
+/*
+ * Função que realiza o roubo de energia de um robô vizinho, sem travas.
+ *
+ * Os ladrões de um mesmo alvo são todos vizinhos dele e são atendidos em
+ * ordem de ID enquanto o alvo tiver mais de 1 de energia: cada ladrão
+ * conta os ladrões de ID menor do seu alvo e só recebe energia se o alvo
+ * ainda tiver o que dar depois deles. O ladrão de menor ID desconta do
+ * alvo o total roubado, então a energia de cada robô tem um único
+ * escritor, e o resultado não depende da ordem das threads.
+ */
+void realiza_roubo_energia(int r)
+{
+    int di[] = {-1, 1, 0, 0};
+    int dj[] = { 0, 0, 1,-1};
+    int alvo = sim->robos.id_roubo_energia[r];
 
-    // Verifica se há um robô válido para roubar e se o alvo ainda tem energia
-    if (id_roubo == -1 || robos[id_roubo].energia == 0) {
-        pthread_mutex_unlock(&robot->mutex_robo);
-        return;  // Nenhum robô disponível para roubo ou sem energia
-    }
-    pthread_mutex_lock(&robos[id_roubo].mutex_robo);
-    
-    if (robos[id_roubo].energia > 1) {
-        // Rouba uma unidade de energia do robô alvo
-        robos[id_roubo].energia--;
-        robot->energia++;
+    int antes = 0;   // Ladrões do mesmo alvo com ID menor
+    int total = 0;   // Todos os ladrões do alvo
+    for (int d = 0; d < 4; d++)
+    {
+        Coordenada ni = sim->robos.i[alvo] + di[d];
+        Coordenada nj = sim->robos.j[alvo] + dj[d];
+        if (!eh_posicao_valida(ni, nj))
+            continue;
+        int vizinho = arena_id(celula(ni, nj));
+        if (vizinho >= 0 && sim->robos.id_roubo_energia[vizinho] == alvo)
+        {
+            total++;
+            if (vizinho < r)
+                antes++;
+        }
     }
-    pthread_mutex_unlock(&robos[id_roubo].mutex_robo);  // Unlock no robô vizinho
-    pthread_mutex_unlock(&robot->mutex_robo);   // Unlock no robô atual
-    // Reseta a intenção de roubo após o sucesso
-    robot->id_roubo_energia = -1;
 
+    // O alvo nunca fica com menos de 1
+    int disponivel = sim->robos.energia_alvo[r] - 1;
+    if (antes < disponivel)
+        sim->robos.energia[r]++;
+    if (antes == 0)
+        sim->robos.energia[alvo] -= (total < disponivel) ? total : disponivel;
 }
 
 /* Função que verifica se a posição está dentro dos limites da arena */
-int eh_posicao_valida(int i, int j)
+int eh_posicao_valida(Coordenada i, Coordenada j)
 {
-    return (i >= 0 && i < arena.n_lins && j >= 0 && j < arena.n_cols);
+    return (i >= 0 && i < sim->arena.n_lins && j >= 0 && j < sim->arena.n_cols);
 }
 
-/* Função para imprimir os resultados finais da simulação */
-void imprime_resultados()
+/* Tamanho do elemento de cada vetor de campos quentes, na ordem de Robos */
+const size_t tam_campos_quentes[NUM_CAMPOS_QUENTES] = {
+    sizeof(Coordenada), sizeof(Coordenada), sizeof(int), sizeof(Coordenada), sizeof(Coordenada),
+    sizeof(int), sizeof(int), sizeof(int), sizeof(uint32_t), sizeof(int),
+};
+
+/*
+ * Reserva os vetores de 'total' robôs, zerados. Os campos quentes ficam
+ * numa única região, cada vetor começando numa linha de cache e com o
+ * espaço do maior deles; as travas são iniciadas por quem as usa.
+ */
+void cria_robos(Robos *rb, int total)
 {
-    for (int i = 0; i < num_robos; i++)
-    {
-        printf("Robô %d:\n", robos[i].id);
-        printf("  Figuras coletadas: %d\n", robos[i].figuras_coletadas);
-        printf("  Energia restante: %d\n", robos[i].energia);
-        printf("  Posição final: (%d, %d)\n", robos[i].i, robos[i].j);
+    size_t n = total > 0 ? (size_t) total : 1;
+    size_t tam_vetor = (n * sizeof(Coordenada) + 63) / 64 * 64;
+
+    rb->tam_mapeado = tam_vetor * NUM_CAMPOS_QUENTES;
+    char *regiao = (char *) mmap(NULL, rb->tam_mapeado, PROT_READ | PROT_WRITE,
+                                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (regiao == MAP_FAILED) {
+        perror("mmap");
+        exit(1);
     }
+#ifdef MADV_HUGEPAGE
+    madvise(regiao, rb->tam_mapeado, MADV_HUGEPAGE);
+#endif
+    aponta_robos(rb, regiao);
+
+    rb->frio = (RoboFrio *) calloc(n, sizeof(RoboFrio));
+    rb->travas = (TravaRobo *) aligned_alloc(sizeof(TravaRobo), n * sizeof(TravaRobo));
 }
 
-/* Função para criar a arena com o número de linhas e colunas fornecido */
-void cria_arena(Arena *arena, int linhas, int colunas)
+/* Aponta os vetores de campos quentes para a região, com rb->tam_mapeado já definido */
+void aponta_robos(Robos *rb, char *regiao)
 {
-    arena->n_lins = linhas;
-    arena->n_cols = colunas;
-
-    // Aloca a matriz de ponteiros para as linhas
-    arena->cel = (CelulaArena **)malloc(linhas * sizeof(CelulaArena *));
-
-    // Aloca memória para cada linha de células e inicializa as células
-    for (int i = 0; i < linhas; i++)
-    {
-        arena->cel[i] = (CelulaArena *)malloc(colunas * sizeof(CelulaArena));
-
-        // Inicializa as células como vazias
-        for (int j = 0; j < colunas; j++)
-        {
-            arena->cel[i][j].obj = VAZIO;  // Célula vazia
-            arena->cel[i][j].id = -1;      // Sem robô inicialmente
-            // inicia o mutex de cada célula da arena
-            pthread_mutex_init(&arena->cel[i][j].mutex_celula, NULL);
-        }
-    }
-    return;
+    size_t tam_vetor = rb->tam_mapeado / NUM_CAMPOS_QUENTES;
+    void **vetores[NUM_CAMPOS_QUENTES] = {
+        (void **) &rb->i, (void **) &rb->j, (void **) &rb->energia, (void **) &rb->move_i,
+        (void **) &rb->move_j, (void **) &rb->id_roubo_energia, (void **) &rb->energia_alvo,
+        (void **) &rb->faltam, (void **) &rb->janela, (void **) &rb->na_janela,
+    };
+    for (int v = 0; v < NUM_CAMPOS_QUENTES; v++)
+        *vetores[v] = regiao + tam_vetor * v;
 }
 
-/* Função para desalocar a memória utilizada pela arena */
-void destroi_arena(Arena *arena)
+/* Copia os robôs para novos vetores; as sequências de movimentos são compartilhadas */
+void copia_robos(Robos *destino, const Robos *origem, int total)
 {
-    // Libera a memória de cada linha da matriz de células
-    for (int i = 0; i < arena->n_lins; i++)
-    {   
-        for (int j = 0; j < arena->n_cols; j++) {
-            // destrói o mutex de cada célula da arena
-            pthread_mutex_destroy(&arena->cel[i][j].mutex_celula);
-        }
-        free(arena->cel[i]);
-    }
+    cria_robos(destino, total);
+    memcpy(destino->i, origem->i, destino->tam_mapeado);
+    memcpy(destino->frio, origem->frio, sizeof(RoboFrio) * total);
+    free(destino->travas);
+    destino->travas = NULL;
+}
 
-    // Libera a matriz de ponteiros
-    free(arena->cel);
+/* Libera os vetores dos robôs, sem as sequências nem as travas */
+void libera_robos(Robos *rb)
+{
+    munmap(rb->i, rb->tam_mapeado);
+    free(rb->frio);
+    free(rb->travas);
+    memset(rb, 0, sizeof(Robos));
 }
 
 /* Função para desalocar a memória utilizada pelos robôs */
-void destroi_robos(Robo *robos, int num_robos)
+void destroi_robos(Robos *rb, int total)
 {
     // Libera a memória alocada para a sequência de movimentos de cada robô
-    for (int r = 0; r < num_robos; r++) {
-        free(robos[r].sequencia_movimentos);
+    for (int r = 0; r < total; r++) {
+        free(rb->frio[r].sequencia_movimentos);
         //  destrói o mutex para cada robô
-        pthread_mutex_destroy(&robos[r].mutex_robo);
+        pthread_mutex_destroy(&rb->travas[r].mutex);
     }
-    // Libera a memória do array de robôs
-    free(robos);
+    // Libera a memória dos vetores de robôs
+    libera_robos(rb);
 }
 
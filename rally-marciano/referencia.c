@@ -0,0 +1,442 @@
+/*
+ * Motor sequencial de referência.
+ *
+ * Implementa as regras do turno da forma mais direta possível, numa única
+ * thread e sem reaproveitar nada dos motores concorrentes, para servir de
+ * gabarito para eles:
+ *
+ * 1. Cada robô com energia consome o próximo movimento da sequência. Um
+ *    destino fora da arena ou com pilar equivale a ficar parado.
+ * 2. Cada célula disputada fica com o robô de menor ID. Os vencedores
+ *    ficam numa tabela de dispersão por célula, do tamanho do número de
+ *    robôs, e não numa tabela do tamanho da arena.
+ * 3. Um vencedor se move se o destino estiver vazio ou se o ocupante
+ *    também se mover. Começando com todos os vencedores se movendo, os
+ *    que ficariam atrás de um robô parado são retirados um a um; as
+ *    cadeias que terminam numa célula vazia e os ciclos continuam.
+ * 4. Os movimentos são aplicados: primeiro as origens são liberadas,
+ *    depois os destinos são ocupados.
+ * 5. Cada robô sem energia escolhe o vizinho de menor ID com mais de 1 de
+ *    energia; depois, em ordem de ID, cada ladrão recebe 1 se o alvo ainda
+ *    tiver mais de 1.
+ *
+ * O resultado deve ser idêntico ao dos motores plano e blocos.
+ *
+ * Para conferir os motores threads e pool, o modo diferencial usa as
+ * regras de processa_robo (por_chegada): em ordem de ID, cada robô com
+ * energia entra no destino se ele estiver vazio e sem pilar, ou se o
+ * ocupante pretendia se mover (move_i e move_j diferentes da posição).
+ * É a ordem em que o pool executa com um trabalhador.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "referencia.h"
+
+/* Robô que fica parado no turno */
+#define SEM_DESTINO ((size_t) -1)
+
+static void aloca_auxiliares(EstadoReferencia *e)
+{
+    int n = e->num_robos > 0 ? e->num_robos : 1;
+
+    // No máximo metade da tabela é usada, então as sondagens são curtas
+    size_t posicoes = 2;
+    while (posicoes < 2 * (size_t) n)
+        posicoes *= 2;
+    e->mascara = posicoes - 1;
+    e->disputadas = (size_t *) malloc(sizeof(size_t) * posicoes);
+    memset(e->disputadas, 0xff, sizeof(size_t) * posicoes);
+    e->vencedor = (int *) malloc(sizeof(int) * posicoes);
+    e->destino = (size_t *) malloc(sizeof(size_t) * n);
+    e->move = (unsigned char *) malloc(n);
+    e->alvo = (int *) malloc(sizeof(int) * n);
+}
+
+void referencia_inicia(EstadoReferencia *e)
+{
+    e->arena = &sim->arena;
+    e->robos = sim->robos;
+    e->num_robos = sim->num_robos;
+    e->energia_bateria = sim->energia_bateria;
+    e->copia = 0;
+    e->por_chegada = 0;
+    aloca_auxiliares(e);
+}
+
+void referencia_clona(EstadoReferencia *e)
+{
+    referencia_inicia(e);
+    e->copia = 1;
+    e->por_chegada = sim->motor == MOTOR_THREADS || sim->motor == MOTOR_POOL;
+    copia_robos(&e->robos, &sim->robos, sim->num_robos);
+
+    e->arena = &e->copia_arena;
+    cria_arena(e->arena, sim->arena.n_lins, sim->arena.n_cols);
+    size_t alocados = arena_alocados(&sim->arena);
+    for (size_t k = 0; k < alocados; k++)
+        memcpy(aloca_ladrilho_em(e->arena, arena_posicao_k(&sim->arena, k)),
+               arena_ladrilho_k(&sim->arena, k), sizeof(Ladrilho));
+}
+
+void referencia_libera(EstadoReferencia *e)
+{
+    if (e->copia) {
+        libera_robos(&e->robos);
+        destroi_arena(e->arena);
+    }
+    free(e->disputadas);
+    free(e->vencedor);
+    free(e->destino);
+    free(e->move);
+    free(e->alvo);
+}
+
+static inline int dentro(const EstadoReferencia *e, Coordenada i, Coordenada j)
+{
+    return i >= 0 && i < e->arena->n_lins && j >= 0 && j < e->arena->n_cols;
+}
+
+static inline size_t cel(const EstadoReferencia *e, Coordenada i, Coordenada j)
+{
+    return celula_em(e->arena, i, j);
+}
+
+/* Posição da célula c na tabela de disputadas: a dela, ou a vaga em que ela entraria */
+static size_t posicao_disputada(const EstadoReferencia *e, size_t c)
+{
+    size_t p = (size_t) (((uint64_t) c * 0x9E3779B97F4A7C15ULL) >> 32) & e->mascara;
+    while (e->disputadas[p] != SEM_DESTINO && e->disputadas[p] != c)
+        p = (p + 1) & e->mascara;
+    return p;
+}
+
+/* Menor ID que quer entrar na célula c, ou -1 */
+static int vencedor_de(const EstadoReferencia *e, size_t c)
+{
+    size_t p = posicao_disputada(e, c);
+    return e->disputadas[p] == c ? e->vencedor[p] : -1;
+}
+
+/* Movimentos pelas regras de processa_robo, um robô de cada vez em ordem de ID */
+static void movimento_por_chegada(EstadoReferencia *e)
+{
+    Robos *rb = &e->robos;
+
+    for (int r = 0; r < e->num_robos; r++) {
+        if (rb->energia[r] <= 0)
+            continue;
+
+        Coordenada i = rb->i[r], j = rb->j[r];
+        if (rb->faltam[r] > 0) {
+            int codigo = robo_proximo_codigo(rb, r);
+            switch (codigo < 0 ? 0 : direcao_codigo[codigo]) {
+                case NORTE: i--; break;
+                case SUL:   i++; break;
+                case LESTE: j++; break;
+                case OESTE: j--; break;
+                default:    break;
+            }
+        }
+        if (!dentro(e, i, j)) {
+            rb->move_i[r] = rb->i[r];
+            rb->move_j[r] = rb->j[r];
+            continue;
+        }
+        rb->move_i[r] = i;
+        rb->move_j[r] = j;
+
+        size_t origem = cel(e, rb->i[r], rb->j[r]), d = cel(e, i, j);
+        int ocupante = arena_id_em(e->arena, d);
+        if (arena_obj_em(e->arena, d) != PILAR && ocupante < 0) {
+            char obj = arena_obj_em(e->arena, d);
+            if (obj == BATERIA)
+                rb->energia[r] += e->energia_bateria;
+            else if (obj == FIGURA)
+                rb->frio[r].figuras_coletadas++;
+            arena_poe_obj_em(e->arena, d, VAZIO);
+            if (arena_id_em(e->arena, origem) == r)
+                arena_poe_id_em(e->arena, origem, -1);
+        } else if (ocupante >= 0 && (rb->move_i[ocupante] != rb->i[ocupante] ||
+                                     rb->move_j[ocupante] != rb->j[ocupante])) {
+            arena_poe_id_em(e->arena, origem, -1);
+        } else {
+            continue;
+        }
+        arena_poe_id_em(e->arena, d, r);
+        rb->i[r] = i;
+        rb->j[r] = j;
+        rb->energia[r]--;
+    }
+}
+
+void referencia_movimento(EstadoReferencia *e)
+{
+    int n = e->num_robos;
+    Robos *rb = &e->robos;
+
+    if (e->por_chegada) {
+        movimento_por_chegada(e);
+        return;
+    }
+
+    // 1 e 2: intenções e vencedor de cada célula (em ordem de ID, o primeiro é o menor)
+    for (int r = 0; r < n; r++) {
+        e->move[r] = 0;
+        e->destino[r] = SEM_DESTINO;
+        if (rb->energia[r] <= 0 || rb->faltam[r] == 0)
+            continue;
+
+        Coordenada i = rb->i[r], j = rb->j[r];
+        int codigo = robo_proximo_codigo(rb, r);
+        switch (codigo < 0 ? 0 : direcao_codigo[codigo]) {
+            case NORTE: i--; break;
+            case SUL:   i++; break;
+            case LESTE: j++; break;
+            case OESTE: j--; break;
+            default:    continue;
+        }
+        if (!dentro(e, i, j) || arena_obj_em(e->arena, cel(e, i, j)) == PILAR)
+            continue;
+
+        e->destino[r] = cel(e, i, j);
+        rb->move_i[r] = i;
+        rb->move_j[r] = j;
+        size_t p = posicao_disputada(e, e->destino[r]);
+        if (e->disputadas[p] == SEM_DESTINO) {
+            e->disputadas[p] = e->destino[r];
+            e->vencedor[p] = r;
+        }
+        e->move[r] = e->vencedor[p] == r;
+    }
+
+    // 3: retira os vencedores cujo destino tem um ocupante que não se move
+    int *pilha = (int *) malloc(sizeof(int) * (n > 0 ? n : 1));
+    int topo = 0;
+    for (int r = 0; r < n; r++) {
+        if (!e->move[r])
+            continue;
+        int ocupante = arena_id_em(e->arena, e->destino[r]);
+        if (ocupante >= 0 && !e->move[ocupante])
+            pilha[topo++] = r;
+    }
+    while (topo > 0) {
+        int r = pilha[--topo];
+        if (!e->move[r])
+            continue;
+        e->move[r] = 0;
+        // Quem queria entrar na célula de r agora fica atrás de um robô parado
+        int atras = vencedor_de(e, cel(e, rb->i[r], rb->j[r]));
+        if (atras >= 0 && e->move[atras])
+            pilha[topo++] = atras;
+    }
+    free(pilha);
+
+    // 4: aplica os movimentos
+    for (int r = 0; r < n; r++)
+        if (e->move[r])
+            arena_poe_id_em(e->arena, cel(e, rb->i[r], rb->j[r]), -1);
+    for (int r = 0; r < n; r++) {
+        if (!e->move[r])
+            continue;
+        size_t d = e->destino[r];
+        char obj = arena_obj_em(e->arena, d);
+        if (obj == BATERIA)
+            rb->energia[r] += e->energia_bateria;
+        else if (obj == FIGURA)
+            rb->frio[r].figuras_coletadas++;
+        arena_poe_obj_em(e->arena, d, VAZIO);
+        arena_poe_id_em(e->arena, d, r);
+        rb->i[r] = rb->move_i[r];
+        rb->j[r] = rb->move_j[r];
+        rb->energia[r]--;
+    }
+
+    // Esvazia a tabela de disputadas para o próximo turno
+    memset(e->disputadas, 0xff, sizeof(size_t) * (e->mascara + 1));
+}
+
+/*
+ * Roubo pelas regras de realiza_roubo_energia: cada ladrão conta os
+ * ladrões do seu alvo que a arena mostra ao redor dele, e recebe se os de
+ * ID menor ainda deixarem energia no alvo; o primeiro desconta o total.
+ * Com a arena coerente, o resultado é o mesmo da ordem de ID; as regras de
+ * processa_robo podem deixar um robô fora da sua célula, e aí não é.
+ */
+static void roubo_por_chegada(EstadoReferencia *e)
+{
+    static const int di[] = {-1, 1, 0, 0};
+    static const int dj[] = { 0, 0, 1,-1};
+    Robos *rb = &e->robos;
+
+    for (int r = 0; r < e->num_robos; r++)
+        if (e->alvo[r] >= 0)
+            rb->energia_alvo[r] = rb->energia[e->alvo[r]];
+
+    for (int r = 0; r < e->num_robos; r++) {
+        int a = e->alvo[r];
+        if (a < 0)
+            continue;
+        int antes = 0, total = 0;
+        for (int d = 0; d < 4; d++) {
+            Coordenada ni = rb->i[a] + di[d], nj = rb->j[a] + dj[d];
+            if (!dentro(e, ni, nj))
+                continue;
+            int v = arena_id_em(e->arena, cel(e, ni, nj));
+            if (v >= 0 && e->alvo[v] == a) {
+                total++;
+                if (v < r)
+                    antes++;
+            }
+        }
+        int disponivel = rb->energia_alvo[r] - 1;
+        if (antes < disponivel)
+            rb->energia[r]++;
+        if (antes == 0)
+            rb->energia[a] -= (total < disponivel) ? total : disponivel;
+    }
+}
+
+void referencia_roubo(EstadoReferencia *e)
+{
+    static const int di[] = {-1, 1, 0, 0};
+    static const int dj[] = { 0, 0, 1,-1};
+    int n = e->num_robos;
+    int *energia = e->robos.energia;
+
+    // Todos os alvos são escolhidos antes de qualquer roubo
+    for (int r = 0; r < n; r++) {
+        e->alvo[r] = -1;
+        if (energia[r] != 0)
+            continue;
+        for (int d = 0; d < 4; d++) {
+            Coordenada ni = e->robos.i[r] + di[d], nj = e->robos.j[r] + dj[d];
+            if (!dentro(e, ni, nj))
+                continue;
+            int v = arena_id_em(e->arena, cel(e, ni, nj));
+            if (v >= 0 && energia[v] > 1 && (e->alvo[r] < 0 || v < e->alvo[r]))
+                e->alvo[r] = v;
+        }
+    }
+
+    if (e->por_chegada) {
+        roubo_por_chegada(e);
+        return;
+    }
+
+    for (int r = 0; r < n; r++) {
+        int a = e->alvo[r];
+        if (a >= 0 && energia[a] > 1) {
+            energia[a]--;
+            energia[r]++;
+        }
+    }
+}
+
+void referencia_turno(EstadoReferencia *e)
+{
+    referencia_movimento(e);
+    referencia_roubo(e);
+}
+
+/*
+ * Executa a simulação com o motor sequencial de referência. As barreiras
+ * de uma única thread só servem para medir o tempo de cada etapa com -T.
+ */
+void executa_sequencial()
+{
+    EstadoReferencia e;
+    referencia_inicia(&e);
+    inicia_barreiras(1);
+
+    for (int turno = sim->turno_inicial; turno < sim->num_total_turnos; turno++) {
+        imprime_turno(turno);
+        barreira_espera(&sim->barreiras[SINC_IMPRESSAO], 0);
+
+        referencia_movimento(&e);
+        barreira_espera(&sim->barreiras[SINC_MOVIMENTO], 0);
+
+        referencia_roubo(&e);
+        barreira_espera(&sim->barreiras[SINC_ROUBO], 0);
+    }
+    referencia_libera(&e);
+}
+
+/* No modo diferencial, sim->gabarito é a cópia do estado avançada pela referência */
+void diferencial_turno(int turno)
+{
+    if (!sim->gabarito) {
+        sim->gabarito = (EstadoReferencia *) malloc(sizeof(EstadoReferencia));
+        referencia_clona(sim->gabarito);
+    } else if (!referencia_compara(sim->gabarito, turno)) {
+        exit(2);
+    }
+    referencia_turno(sim->gabarito);
+}
+
+int diferencial_finaliza()
+{
+    if (!sim->gabarito)
+        return 1;
+    int iguais = referencia_compara(sim->gabarito, sim->num_total_turnos);
+    if (iguais)
+        fprintf(stderr, "Diferencial: %d turnos idênticos à referência\n",
+                sim->num_total_turnos - sim->turno_inicial);
+    referencia_libera(sim->gabarito);
+    free(sim->gabarito);
+    sim->gabarito = NULL;
+    return iguais;
+}
+
+/* Compara as células do ladrilho que começa na célula base */
+static int compara_ladrilho(const EstadoReferencia *e, size_t base, int turno)
+{
+    for (size_t c = base; c < base + CELULAS_LADRILHO; c++) {
+        char obj = arena_obj_em(e->arena, c);
+        int id = arena_id_em(e->arena, c);
+        if (arena_obj(c) == obj && arena_id(c) == id)
+            continue;
+        fprintf(stderr, "Divergência no início do turno %d, célula (%lld, %lld):\n", turno,
+                (long long) celula_linha(c), (long long) celula_coluna(c));
+        fprintf(stderr, "  motor:      objeto '%c', robô %d\n", arena_obj(c), arena_id(c));
+        fprintf(stderr, "  referência: objeto '%c', robô %d\n", obj, id);
+        return 0;
+    }
+    return 1;
+}
+
+int referencia_compara(const EstadoReferencia *e, int turno)
+{
+    const Robos *a = &sim->robos, *b = &e->robos;
+    for (int r = 0; r < e->num_robos; r++) {
+        const RoboFrio *fa = &a->frio[r], *fb = &b->frio[r];
+        if (a->i[r] != b->i[r] || a->j[r] != b->j[r] || a->energia[r] != b->energia[r] ||
+            fa->figuras_coletadas != fb->figuras_coletadas || a->faltam[r] != b->faltam[r]) {
+            fprintf(stderr, "Divergência no início do turno %d, robô %d:\n", turno, r);
+            fprintf(stderr, "  motor:      posição (%lld, %lld), energia %d, figuras %d, movimento %d\n",
+                    (long long) a->i[r], (long long) a->j[r], a->energia[r],
+                    fa->figuras_coletadas, robo_movimento(a, r));
+            fprintf(stderr, "  referência: posição (%lld, %lld), energia %d, figuras %d, movimento %d\n",
+                    (long long) b->i[r], (long long) b->j[r], b->energia[r],
+                    fb->figuras_coletadas, robo_movimento(b, r));
+            return 0;
+        }
+    }
+
+    // As duas arenas têm a mesma geometria, e uma célula diferente está num ladrilho alocado
+    // em pelo menos uma delas
+    const Arena *arenas[2] = { &sim->arena, e->arena };
+    for (int a = 0; a < 2; a++) {
+        size_t alocados = arena_alocados(arenas[a]);
+        for (size_t k = 0; k < alocados; k++) {
+            size_t base = arena_posicao_k(arenas[a], k) << (2 * BITS_LADRILHO);
+            if (a == 1 && ladrilho_alocado_em(&sim->arena, base))
+                continue;
+            if (!compara_ladrilho(e, base, turno))
+                return 0;
+        }
+    }
+    return 1;
+}
@@ -0,0 +1,71 @@
+#ifndef __REFERENCIA_H__
+#define __REFERENCIA_H__
+
+#include <stddef.h>
+
+#include "rally.h"
+
+/*
+ * Estado de uma simulação para o motor sequencial de referência. Ele
+ * altera a arena e os robôs da simulação (motor sequencial) ou cópias
+ * próprias deles (modo diferencial). A cópia da arena tem os mesmos
+ * ladrilhos da original, então também cresce com o conteúdo, não com a
+ * área.
+ */
+typedef struct EstadoReferencia {
+    Arena *arena;        // Arena da simulação, ou copia_arena
+    Arena copia_arena;
+    Robos robos;
+    int num_robos;
+    int energia_bateria;
+    int copia;  // 1 se a arena e os robôs pertencem ao estado
+    int por_chegada;  // 1: movimentos pelas regras de processa_robo, em ordem de ID
+
+    /* Auxiliares do turno */
+    size_t *disputadas;  // Tabela de dispersão das células de destino do turno
+    int *vencedor;       // Menor ID que quer entrar na célula de mesma posição em disputadas
+    size_t mascara;      // Posições da tabela menos 1 (a tabela tem uma potência de 2)
+    size_t *destino;     // Célula de destino de cada robô
+    unsigned char *move; // 1 se o robô tenta se mover (e, no fim, se se moveu)
+    int *alvo;           // Alvo do roubo de cada robô, ou -1
+} EstadoReferencia;
+
+/* Usa a arena e os robôs da simulação */
+void referencia_inicia(EstadoReferencia *e);
+
+/*
+ * Copia a arena e os robôs da simulação; as sequências de movimentos são
+ * compartilhadas. Para os motores threads e pool, a cópia segue as regras
+ * de processa_robo (por_chegada).
+ */
+void referencia_clona(EstadoReferencia *e);
+
+void referencia_libera(EstadoReferencia *e);
+
+/* Etapa de movimentação de um turno */
+void referencia_movimento(EstadoReferencia *e);
+
+/* Etapa de roubo de energia de um turno */
+void referencia_roubo(EstadoReferencia *e);
+
+/* Um turno inteiro */
+void referencia_turno(EstadoReferencia *e);
+
+/*
+ * Compara o estado com a arena e os robôs da simulação. Retorna 1 se forem
+ * iguais; senão imprime em stderr a primeira diferença e retorna 0.
+ */
+int referencia_compara(const EstadoReferencia *e, int turno);
+
+/*
+ * Modo diferencial: chamada no início de cada turno, com as demais threads
+ * paradas. Compara o estado do motor com o da referência, que avança um
+ * turno por chamada a partir de uma cópia do estado inicial, e encerra o
+ * programa na primeira divergência.
+ */
+void diferencial_turno(int turno);
+
+/* Compara o estado final. Retorna 1 se o motor e a referência terminaram iguais */
+int diferencial_finaliza();
+
+#endif /*__REFERENCIA_H__*/
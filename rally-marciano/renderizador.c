@@ -0,0 +1,427 @@
+/*
+ * Renderizador assíncrono dos quadros da arena.
+ *
+ * A thread que imprime o turno só copia os ladrilhos alocados da arena
+ * para um dos dois quadros do renderizador e volta para a simulação. Uma
+ * thread de E/S ordena os ladrilhos do quadro pela posição, formata o
+ * quadro num buffer pré-alocado, com conversão de inteiros feita à mão,
+ * e o escreve com write() enquanto o próximo turno é calculado. No modo
+ * QUADRO_COMPLETO a saída é idêntica à de printf.
+ *
+ * Os quadros guardam só os ladrilhos alocados, então a memória do
+ * renderizador cresce com o conteúdo da arena, não com a área. O quadro
+ * completo percorre a arena linha a linha, com as linhas dos ladrilhos
+ * ausentes copiadas de uma linha vazia pronta, e vai sendo escrito em
+ * pedaços do tamanho do buffer. O modo QUADRO_ALTERACOES só percorre os
+ * ladrilhos presentes neste quadro ou no anterior.
+ *
+ * Cada simulação tem o seu renderizador (sim->renderizador), com a sua
+ * thread de E/S e a sua saída, então os cenários do modo lote imprimem
+ * ao mesmo tempo, cada um no seu arquivo.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "renderizador.h"
+
+#define NUM_QUADROS 2
+
+/* Tamanho do buffer de formatação, fora a folga de uma linha de ladrilho */
+#define TAM_BUFFER (1 << 20)
+
+/* Cópia dos ladrilhos alocados da arena num turno, na ordem de alocação */
+typedef struct {
+    Ladrilho *ladrilhos;
+    size_t *posicoes;
+    size_t num;
+    size_t cap;
+    int turno;
+    int cheio;   // 1 quando aguarda a thread de E/S
+    int ultimo;  // 1 no quadro que encerra a thread de E/S
+} Quadro;
+
+/* Ladrilho de um quadro e a sua posição, para a ordenação */
+typedef struct {
+    size_t posicao;
+    const Ladrilho *ladrilho;
+} Entrada;
+
+/* Estado do renderizador de uma simulação (sim->renderizador) */
+typedef struct Renderizador {
+    Quadro quadros[NUM_QUADROS];
+    int prox_escrita;  // Próximo quadro a ser preenchido pela simulação
+    int prox_leitura;  // Próximo quadro a ser escrito pela thread de E/S
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    pthread_t thread_es;
+
+    Coordenada lins, cols;
+    size_t por_linha;  // Ladrilhos em cada faixa de LADO_LADRILHO linhas
+    ModoQuadro modo;
+    int intervalo;
+    int saida;
+
+    char *buffer;       // Quadro formatado, em pedaços
+
+    Entrada *atuais;    // Ladrilhos do quadro sendo escrito, por posição
+    size_t cap_atuais;
+
+    /* Último quadro escrito, com os ladrilhos em ordem de posição (modo QUADRO_ALTERACOES) */
+    Ladrilho *ladrilhos_anteriores;
+    Entrada *anteriores;
+    size_t num_anteriores, cap_anteriores;
+    int tem_anterior;
+} Renderizador;
+
+/* Comuns a todos os renderizadores, e só escritos por inicia_vazios */
+static char linha_vazia[LADO_LADRILHO * 4];  // Uma linha de ladrilho sem objetos nem robôs
+static Ladrilho ladrilho_vazio;  // Um ladrilho ausente de um dos quadros
+static pthread_once_t vazios_iniciados = PTHREAD_ONCE_INIT;
+
+static void inicia_vazios()
+{
+    for (int b = 0; b < LADO_LADRILHO; b++)
+        memcpy(&linha_vazia[b * 4], " .  ", 4);
+    memset(ladrilho_vazio.obj, VAZIO, sizeof(ladrilho_vazio.obj));
+    memset(ladrilho_vazio.id, 0xff, sizeof(ladrilho_vazio.id));
+}
+
+/* Escreve o inteiro não negativo v em p e retorna o número de caracteres */
+static inline int formata_inteiro(char *p, uint64_t v)
+{
+    char tmp[20];
+    int n = 0;
+    do {
+        tmp[n++] = (char) ('0' + v % 10);
+        v /= 10;
+    } while (v);
+    for (int k = 0; k < n; k++)
+        p[k] = tmp[n - 1 - k];
+    return n;
+}
+
+/* Formata o conteúdo de uma célula: " x  " ou "(id) " */
+static inline char *formata_celula(char *p, char obj, int id)
+{
+    if (id == -1) {
+        p[0] = ' ';
+        p[1] = obj;
+        p[2] = ' ';
+        p[3] = ' ';
+        return p + 4;
+    }
+    *p++ = '(';
+    p += formata_inteiro(p, (unsigned) id);
+    *p++ = ')';
+    *p++ = ' ';
+    return p;
+}
+
+static char *formata_cabecalho(char *p, int turno)
+{
+    memcpy(p, "Turno ", 6);
+    p += 6;
+    p += formata_inteiro(p, (unsigned) turno);
+    *p++ = ':';
+    *p++ = '\n';
+    return p;
+}
+
+static void escreve_tudo(const Renderizador *r, const char *p, size_t n)
+{
+    while (n > 0) {
+        ssize_t w = write(r->saida, p, n);
+        if (w < 0) {
+            if (errno == EINTR)
+                continue;
+            perror("write");
+            return;
+        }
+        p += w;
+        n -= (size_t) w;
+    }
+}
+
+/* Escreve o buffer se o próximo trecho pode não caber; retorna onde continuar */
+static inline char *esvazia_se_cheio(const Renderizador *r, char *p)
+{
+    if ((size_t) (p - r->buffer) > TAM_BUFFER) {
+        escreve_tudo(r, r->buffer, (size_t) (p - r->buffer));
+        p = r->buffer;
+    }
+    return p;
+}
+
+static int compara_entradas(const void *a, const void *b)
+{
+    size_t pa = ((const Entrada *) a)->posicao, pb = ((const Entrada *) b)->posicao;
+    return pa < pb ? -1 : pa > pb;
+}
+
+/* Ordena os ladrilhos do quadro pela posição em atuais */
+static void ordena_quadro(Renderizador *r, const Quadro *q)
+{
+    if (q->num > r->cap_atuais) {
+        r->cap_atuais = q->num;
+        r->atuais = (Entrada *) realloc(r->atuais, r->cap_atuais * sizeof(Entrada));
+    }
+    for (size_t k = 0; k < q->num; k++) {
+        r->atuais[k].posicao = q->posicoes[k];
+        r->atuais[k].ladrilho = &q->ladrilhos[k];
+    }
+    qsort(r->atuais, q->num, sizeof(Entrada), compara_entradas);
+}
+
+/* Formata e escreve o quadro inteiro, linha a linha */
+static char *formata_completo(const Renderizador *r, const Quadro *q)
+{
+    char *p = formata_cabecalho(r->buffer, q->turno);
+    size_t t = 0;  // Primeiro ladrilho da faixa atual em atuais
+    for (Coordenada i0 = 0; i0 < r->lins; i0 += LADO_LADRILHO) {
+        size_t faixa = (size_t) i0 >> BITS_LADRILHO;
+        size_t fim = t;
+        while (fim < q->num && r->atuais[fim].posicao / r->por_linha == faixa)
+            fim++;
+        int linhas = r->lins - i0 < LADO_LADRILHO ? (int) (r->lins - i0) : LADO_LADRILHO;
+        for (int a = 0; a < linhas; a++) {
+            size_t k = t;
+            for (size_t c = 0; c < r->por_linha; c++) {
+                Coordenada j0 = (Coordenada) c << BITS_LADRILHO;
+                int n = r->cols - j0 < LADO_LADRILHO ? (int) (r->cols - j0) : LADO_LADRILHO;
+                if (k < fim && r->atuais[k].posicao == faixa * r->por_linha + c) {
+                    const Ladrilho *l = r->atuais[k++].ladrilho;
+                    for (int b = 0; b < n; b++)
+                        p = formata_celula(p, l->obj[a * LADO_LADRILHO + b],
+                                           l->id[a * LADO_LADRILHO + b]);
+                } else {
+                    memcpy(p, linha_vazia, (size_t) n * 4);
+                    p += n * 4;
+                }
+                p = esvazia_se_cheio(r, p);
+            }
+            *p++ = '\n';
+        }
+        t = fim;
+    }
+    return p;
+}
+
+/* Formata uma célula diferente do último quadro: "i j celula" */
+static inline char *formata_alteracao(char *p, Coordenada i, Coordenada j, char obj, int id)
+{
+    p += formata_inteiro(p, (uint64_t) i);
+    *p++ = ' ';
+    p += formata_inteiro(p, (uint64_t) j);
+    *p++ = ' ';
+    if (id == -1) {
+        *p++ = obj;
+    } else {
+        *p++ = '(';
+        p += formata_inteiro(p, (unsigned) id);
+        *p++ = ')';
+    }
+    *p++ = '\n';
+    return p;
+}
+
+/* Fim dos ladrilhos da faixa 'faixa' a partir de ini em v[0, n), ordenado por posição */
+static size_t fim_faixa(const Renderizador *r, const Entrada *v, size_t ini, size_t n,
+                        size_t faixa)
+{
+    while (ini < n && v[ini].posicao / r->por_linha == faixa)
+        ini++;
+    return ini;
+}
+
+/*
+ * Formata só as células diferentes do último quadro, uma por linha, na
+ * ordem das linhas da arena. Só os ladrilhos presentes num dos dois
+ * quadros podem ter mudado; um ladrilho ausente tem todas as células
+ * vazias.
+ */
+static char *formata_alteracoes(const Renderizador *r, const Quadro *q)
+{
+    char *p = formata_cabecalho(r->buffer, q->turno);
+    size_t t = 0, u = 0;  // Próximos ladrilhos em atuais e em anteriores
+    while (t < q->num || u < r->num_anteriores) {
+        size_t faixa = t < q->num ? r->atuais[t].posicao / r->por_linha : SIZE_MAX;
+        if (u < r->num_anteriores && r->anteriores[u].posicao / r->por_linha < faixa)
+            faixa = r->anteriores[u].posicao / r->por_linha;
+        size_t fim_t = fim_faixa(r, r->atuais, t, q->num, faixa);
+        size_t fim_u = fim_faixa(r, r->anteriores, u, r->num_anteriores, faixa);
+
+        for (int a = 0; a < LADO_LADRILHO; a++) {
+            Coordenada i = (Coordenada) faixa << BITS_LADRILHO | a;
+            if (i >= r->lins)
+                break;
+            // Os ladrilhos da faixa nas duas listas, em ordem de coluna
+            size_t x = t, y = u;
+            while (x < fim_t || y < fim_u) {
+                size_t pos = x < fim_t ? r->atuais[x].posicao : SIZE_MAX;
+                if (y < fim_u && r->anteriores[y].posicao < pos)
+                    pos = r->anteriores[y].posicao;
+                const Ladrilho *novo = &ladrilho_vazio, *velho = &ladrilho_vazio;
+                if (x < fim_t && r->atuais[x].posicao == pos)
+                    novo = r->atuais[x++].ladrilho;
+                if (y < fim_u && r->anteriores[y].posicao == pos)
+                    velho = r->anteriores[y++].ladrilho;
+
+                Coordenada j0 = (Coordenada) (pos % r->por_linha) << BITS_LADRILHO;
+                int n = r->cols - j0 < LADO_LADRILHO ? (int) (r->cols - j0) : LADO_LADRILHO;
+                for (int b = 0; b < n; b++) {
+                    int k = a * LADO_LADRILHO + b;
+                    if (novo->obj[k] == velho->obj[k] && novo->id[k] == velho->id[k])
+                        continue;
+                    p = formata_alteracao(p, i, j0 + b, novo->obj[k], novo->id[k]);
+                    // Com muitas alterações, esvazia o buffer antes de estourar
+                    p = esvazia_se_cheio(r, p);
+                }
+            }
+        }
+        t = fim_t;
+        u = fim_u;
+    }
+    return p;
+}
+
+/* Guarda os ladrilhos do quadro escrito, em ordem de posição, para o próximo */
+static void guarda_anterior(Renderizador *r, const Quadro *q)
+{
+    if (q->num > r->cap_anteriores) {
+        r->cap_anteriores = q->num;
+        free(r->ladrilhos_anteriores);
+        r->ladrilhos_anteriores = (Ladrilho *) malloc(r->cap_anteriores * sizeof(Ladrilho));
+        r->anteriores = (Entrada *) realloc(r->anteriores, r->cap_anteriores * sizeof(Entrada));
+    }
+    for (size_t k = 0; k < q->num; k++) {
+        memcpy(&r->ladrilhos_anteriores[k], r->atuais[k].ladrilho, sizeof(Ladrilho));
+        r->anteriores[k].posicao = r->atuais[k].posicao;
+        r->anteriores[k].ladrilho = &r->ladrilhos_anteriores[k];
+    }
+    r->num_anteriores = q->num;
+    r->tem_anterior = 1;
+}
+
+static void *thread_renderizador(void *arg)
+{
+    Renderizador *r = (Renderizador *) arg;
+    for (;;) {
+        pthread_mutex_lock(&r->mutex);
+        while (!r->quadros[r->prox_leitura].cheio)
+            pthread_cond_wait(&r->cond, &r->mutex);
+        Quadro *q = &r->quadros[r->prox_leitura];
+        pthread_mutex_unlock(&r->mutex);
+
+        if (q->ultimo)
+            break;
+
+        ordena_quadro(r, q);
+        char *p;
+        if (r->modo == QUADRO_ALTERACOES && r->tem_anterior) {
+            p = formata_alteracoes(r, q);
+        } else {
+            p = formata_completo(r, q);
+        }
+        escreve_tudo(r, r->buffer, (size_t) (p - r->buffer));
+
+        if (r->modo == QUADRO_ALTERACOES)
+            guarda_anterior(r, q);
+
+        pthread_mutex_lock(&r->mutex);
+        q->cheio = 0;
+        r->prox_leitura = (r->prox_leitura + 1) % NUM_QUADROS;
+        pthread_cond_broadcast(&r->cond);
+        pthread_mutex_unlock(&r->mutex);
+    }
+    return NULL;
+}
+
+void renderizador_inicia(Coordenada n_lins, Coordenada n_cols, int num_robos,
+                         ModoQuadro modo_quadro, int intervalo_quadros, int fd)
+{
+    pthread_once(&vazios_iniciados, inicia_vazios);
+
+    Renderizador *r = (Renderizador *) calloc(1, sizeof(Renderizador));
+    sim->renderizador = r;
+    r->lins = n_lins;
+    r->cols = n_cols;
+    r->por_linha = ((size_t) n_cols + LADO_LADRILHO - 1) >> BITS_LADRILHO;
+    if (r->por_linha == 0)
+        r->por_linha = 1;
+    r->modo = modo_quadro;
+    r->intervalo = intervalo_quadros > 0 ? intervalo_quadros : 1;
+    r->saida = fd;
+
+    // Largura máxima de uma célula: " x  " ou "(id) " com o maior ID. Entre duas
+    // conferências do buffer cabe uma linha de ladrilho, ou uma alteração
+    char tmp[24];
+    int largura = formata_inteiro(tmp, num_robos > 0 ? (unsigned) (num_robos - 1) : 0) + 3;
+    if (largura < 4)
+        largura = 4;
+    r->buffer = (char *) malloc(TAM_BUFFER + (size_t) LADO_LADRILHO * largura + 128);
+
+    pthread_mutex_init(&r->mutex, NULL);
+    pthread_cond_init(&r->cond, NULL);
+    pthread_create(&r->thread_es, NULL, thread_renderizador, r);
+}
+
+/* Espera o próximo quadro livre; retorna com ele reservado para a simulação */
+static Quadro *reserva_quadro(Renderizador *r)
+{
+    pthread_mutex_lock(&r->mutex);
+    while (r->quadros[r->prox_escrita].cheio)
+        pthread_cond_wait(&r->cond, &r->mutex);
+    Quadro *q = &r->quadros[r->prox_escrita];
+    pthread_mutex_unlock(&r->mutex);
+    return q;
+}
+
+static void entrega_quadro(Renderizador *r, Quadro *q)
+{
+    pthread_mutex_lock(&r->mutex);
+    q->cheio = 1;
+    r->prox_escrita = (r->prox_escrita + 1) % NUM_QUADROS;
+    pthread_cond_broadcast(&r->cond);
+    pthread_mutex_unlock(&r->mutex);
+}
+
+void renderizador_quadro(int turno, size_t (*copia)(Ladrilho **ladrilhos, size_t **posicoes,
+                                                    size_t *cap), int final)
+{
+    Renderizador *r = sim->renderizador;
+    if (!final && turno % r->intervalo != 0)
+        return;
+
+    Quadro *q = reserva_quadro(r);
+    q->num = copia(&q->ladrilhos, &q->posicoes, &q->cap);
+    q->turno = turno;
+    entrega_quadro(r, q);
+}
+
+void renderizador_finaliza()
+{
+    // Um quadro marcado como último avisa a thread de E/S que acabou
+    Renderizador *r = sim->renderizador;
+    Quadro *q = reserva_quadro(r);
+    q->ultimo = 1;
+    entrega_quadro(r, q);
+    pthread_join(r->thread_es, NULL);
+
+    for (int k = 0; k < NUM_QUADROS; k++) {
+        free(r->quadros[k].ladrilhos);
+        free(r->quadros[k].posicoes);
+    }
+    free(r->atuais);
+    free(r->ladrilhos_anteriores);
+    free(r->anteriores);
+    free(r->buffer);
+    pthread_mutex_destroy(&r->mutex);
+    pthread_cond_destroy(&r->cond);
+    free(r);
+    sim->renderizador = NULL;
+}
@@ -0,0 +1,31 @@
+#ifndef __RENDERIZADOR_H__
+#define __RENDERIZADOR_H__
+
+#include "rally.h"
+
+/* Formas de imprimir cada quadro */
+typedef enum {
+    QUADRO_COMPLETO,    // Arena inteira, no formato original de imprime_estado
+    QUADRO_ALTERACOES   // Só as células que mudaram desde o último quadro impresso
+} ModoQuadro;
+
+/*
+ * Inicia o renderizador e a thread de E/S que escreve os quadros em fd.
+ * Só um quadro a cada 'intervalo' turnos é impresso (além do final).
+ */
+void renderizador_inicia(Coordenada n_lins, Coordenada n_cols, int num_robos, ModoQuadro modo,
+                         int intervalo, int fd);
+
+/*
+ * Preenche um quadro livre com copia (arena_copia), que copia os
+ * ladrilhos alocados e as suas posições nos vetores do quadro, e o
+ * entrega para a thread de E/S. Só espera se os dois quadros anteriores
+ * ainda não tiverem sido escritos.
+ */
+void renderizador_quadro(int turno, size_t (*copia)(Ladrilho **ladrilhos, size_t **posicoes,
+                                                    size_t *cap), int final);
+
+/* Espera todos os quadros serem escritos e encerra a thread de E/S */
+void renderizador_finaliza();
+
+#endif /*__RENDERIZADOR_H__*/
@@ -0,0 +1,211 @@
+/*
+ * Compactação das sequências de movimentos em códigos de 2 bits, com
+ * blocos de repetição para trechos longos na mesma direção (sequencia.h).
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "rally.h"
+#include "sequencia.h"
+
+/* Trechos na mesma direção a partir deste tamanho viram um bloco REPETICAO */
+#define REPETICAO_MINIMA 16
+
+/* Movimentos por bloco LITERAL */
+#define MAX_LITERAL 128
+
+#define CABECALHO_REPETICAO 0x80
+#define CABECALHO_PARADO 0xC0
+
+const char direcao_codigo[4] = { NORTE, LESTE, SUL, OESTE };
+
+/* Código de 2 bits de cada caractere mais 1; 0 para caracteres inválidos */
+static const unsigned char codigo_mais_um[256] = {
+    [NORTE] = 1, [LESTE] = 2, [SUL] = 3, [OESTE] = 4
+};
+
+static inline int codigo_de(char direcao)
+{
+    return codigo_mais_um[(unsigned char) direcao] - 1;
+}
+
+static size_t grava_varint(unsigned char *p, uint32_t x)
+{
+    size_t n = 0;
+    while (x >= 0x80) {
+        p[n++] = (unsigned char) (x | 0x80);
+        x >>= 7;
+    }
+    p[n++] = (unsigned char) x;
+    return n;
+}
+
+/* Lê um inteiro variável; retorna 0 se ele passar de 'limite' ou de 32 bits */
+static int le_varint(const unsigned char *seq, size_t *pos, size_t limite, uint32_t *x)
+{
+    uint64_t v = 0;
+    for (int desloc = 0; desloc < 35; desloc += 7) {
+        if (*pos >= limite)
+            return 0;
+        unsigned char b = seq[(*pos)++];
+        v |= (uint64_t) (b & 0x7F) << desloc;
+        if (!(b & 0x80)) {
+            *x = (uint32_t) v;
+            return v <= UINT32_MAX;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Grava os n movimentos a partir de m, sem procurar repetições: os
+ * válidos em blocos LITERAL, os inválidos em blocos PARADO
+ */
+static size_t grava_trecho(unsigned char *p, const char *m, int n)
+{
+    size_t o = 0;
+    int i = 0;
+    while (i < n) {
+        int j = i;
+        while (j < n && codigo_de(m[j]) < 0)
+            j++;
+        if (j > i) {
+            p[o++] = CABECALHO_PARADO;
+            o += grava_varint(p + o, (uint32_t) (j - i));
+            i = j;
+            continue;
+        }
+
+        // Literal com até MAX_LITERAL movimentos válidos, 4 por byte
+        int limite = n - i < MAX_LITERAL ? n - i : MAX_LITERAL;
+        const char *l = m + i;
+        size_t cabecalho = o++;
+        int k = 0;
+        for (; k + 4 <= limite; k += 4) {
+            int a = codigo_de(l[k]), b = codigo_de(l[k + 1]);
+            int c = codigo_de(l[k + 2]), d = codigo_de(l[k + 3]);
+            if ((a | b | c | d) < 0)
+                break;
+            p[o++] = (unsigned char) (a | b << 2 | c << 4 | d << 6);
+        }
+        // Final do literal: menos de 4 movimentos ou um inválido a seguir
+        unsigned char byte = 0;
+        int u = 0;
+        for (; k < limite && codigo_de(l[k]) >= 0; k++) {
+            byte |= (unsigned char) (codigo_de(l[k]) << (2 * u));
+            if (++u == 4) {
+                p[o++] = byte;
+                byte = 0;
+                u = 0;
+            }
+        }
+        if (u > 0)
+            p[o++] = byte;
+        p[cabecalho] = (unsigned char) (k - 1);
+        i += k;
+    }
+    return o;
+}
+
+/*
+ * Toda repetição com REPETICAO_MINIMA ou mais movimentos contém uma das
+ * posições sondadas, que vão de REPETICAO_MINIMA em REPETICAO_MINIMA a
+ * partir do fim da repetição anterior. Só nelas a repetição é medida;
+ * o resto passa direto para grava_trecho.
+ */
+unsigned char *sequencia_compacta(const char *movimentos, int n)
+{
+    // Pior caso: movimentos válidos e inválidos alternados, 2 bytes por movimento
+    unsigned char *p = (unsigned char *) malloc(2 * (size_t) n + 8);
+    size_t o = 0;
+    int ini = 0;  // Início do trecho ainda não gravado
+
+    for (int pos = 0; pos < n; ) {
+        char c = movimentos[pos];
+        int codigo = codigo_de(c);
+        if (codigo < 0) {
+            pos += REPETICAO_MINIMA;
+            continue;
+        }
+        int l = pos, r = pos + 1;
+        while (l > ini && movimentos[l - 1] == c)
+            l--;
+        while (r < n && movimentos[r] == c)
+            r++;
+        if (r - l < REPETICAO_MINIMA) {
+            pos += REPETICAO_MINIMA;
+            continue;
+        }
+
+        o += grava_trecho(p + o, movimentos + ini, l - ini);
+        p[o++] = (unsigned char) (CABECALHO_REPETICAO | codigo);
+        o += grava_varint(p + o, (uint32_t) (r - l));
+        ini = pos = r;
+    }
+    o += grava_trecho(p + o, movimentos + ini, n - ini);
+
+    unsigned char *justo = (unsigned char *) realloc(p, o + SEQUENCIA_FOLGA);
+    if (!justo)
+        justo = p;
+    memset(justo + o, 0, SEQUENCIA_FOLGA);
+    return justo;
+}
+
+void sequencia_abre_bloco(const unsigned char *seq, CursorSequencia *c)
+{
+    unsigned char h = seq[c->pos++];
+    c->bit = 0;
+    if (h < CABECALHO_REPETICAO) {
+        c->tipo = BLOCO_LITERAL;
+        c->restantes = (uint32_t) h + 1;
+        return;
+    }
+    c->tipo = h < CABECALHO_PARADO ? BLOCO_REPETICAO : BLOCO_PARADO;
+    c->codigo = h & 3;
+    le_varint(seq, &c->pos, SIZE_MAX, &c->restantes);
+}
+
+void sequencia_avanca(const unsigned char *seq, CursorSequencia *c, long n)
+{
+    while (n > 0) {
+        if (c->restantes == 0)
+            sequencia_abre_bloco(seq, c);
+        uint32_t k = (uint64_t) n < c->restantes ? (uint32_t) n : c->restantes;
+        c->restantes -= k;
+        n -= k;
+        if (c->tipo != BLOCO_LITERAL)
+            continue;
+        size_t codigos = c->bit / 2 + k;
+        c->pos += codigos / 4;
+        c->bit = (uint8_t) (2 * (codigos % 4));
+        if (c->restantes == 0 && c->bit != 0) {
+            c->pos++;
+            c->bit = 0;
+        }
+    }
+}
+
+long sequencia_bytes(const unsigned char *seq, size_t limite, int n)
+{
+    size_t pos = 0;
+    while (n > 0) {
+        if (pos >= limite)
+            return -1;
+        unsigned char h = seq[pos++];
+        uint32_t k;
+        if (h < CABECALHO_REPETICAO) {
+            k = (uint32_t) h + 1;
+            pos += (k + 3) / 4;
+        } else if ((h & ~3) == CABECALHO_REPETICAO || h == CABECALHO_PARADO) {
+            if (!le_varint(seq, &pos, limite, &k) || k == 0)
+                return -1;
+        } else {
+            return -1;
+        }
+        if (k > (uint32_t) n || pos > limite)
+            return -1;
+        n -= (int) k;
+    }
+    return (long) pos;
+}
@@ -0,0 +1,120 @@
+#ifndef __SEQUENCIA_H__
+#define __SEQUENCIA_H__
+
+/*
+ * Sequências de movimentos compactadas.
+ *
+ * Cada movimento válido ocupa 2 bits (N, L, S, O). A sequência é uma
+ * série de blocos, cada um começando por um byte de cabeçalho:
+ *
+ * - 0x00 a 0x7F (LITERAL): h + 1 movimentos (1 a 128), seguidos de
+ *   (h + 4) / 4 bytes com 4 códigos de 2 bits cada, do bit menos
+ *   significativo para o mais significativo;
+ * - 0x80 a 0x83 (REPETICAO): o movimento de código h & 3 repetido, com a
+ *   quantidade em seguida como inteiro variável (7 bits por byte, o bit
+ *   mais alto indica que há mais bytes);
+ * - 0xC0 (PARADO): caracteres inválidos na entrada, em que o robô fica
+ *   parado, com a quantidade em seguida como inteiro variável.
+ *
+ * A sequência é lida em ordem, uma janela de movimentos por vez
+ * (sequencia_recarrega). O cursor de cada robô aponta para o que vem
+ * depois da janela atual.
+ */
+
+#include <limits.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Movimentos de uma janela de um bloco LITERAL: 16 códigos de 2 bits em 32 bits */
+#define JANELA_MOVIMENTOS 16
+
+/* Bytes alocados depois do fim de cada sequência, para a leitura de 4 bytes de sequencia_recarrega */
+#define SEQUENCIA_FOLGA 3
+
+/* Posição de leitura de uma sequência compactada */
+typedef struct {
+    size_t pos;          // Próximo byte da sequência
+    uint32_t restantes;  // Movimentos que faltam no bloco atual
+    uint8_t tipo;        // Tipo do bloco atual
+    uint8_t codigo;      // Código do movimento de um bloco REPETICAO
+    uint8_t bit;         // Deslocamento do próximo código no byte atual (LITERAL)
+} CursorSequencia;
+
+/* Tipos de bloco */
+enum {
+    BLOCO_LITERAL,
+    BLOCO_REPETICAO,
+    BLOCO_PARADO
+};
+
+/* Movimento de cada código de 2 bits */
+extern const char direcao_codigo[4];
+
+/*
+ * Compacta os n movimentos de 'movimentos' (caracteres da entrada) numa
+ * sequência alocada com malloc, com SEQUENCIA_FOLGA bytes a mais
+ */
+unsigned char *sequencia_compacta(const char *movimentos, int n);
+
+/*
+ * Tamanho em bytes dos n primeiros movimentos da sequência, ou -1 se ela
+ * for malformada ou passar de 'limite' bytes
+ */
+long sequencia_bytes(const unsigned char *seq, size_t limite, int n);
+
+/* Pula os n próximos movimentos */
+void sequencia_avanca(const unsigned char *seq, CursorSequencia *c, long n);
+
+/* Lê o cabeçalho do próximo bloco */
+void sequencia_abre_bloco(const unsigned char *seq, CursorSequencia *c);
+
+/*
+ * Lê a próxima janela de movimentos em *janela e *n. Só pode ser chamada
+ * enquanto houver movimentos.
+ *
+ * A janela traz os próximos códigos de 2 bits, do bit menos significativo
+ * para o mais significativo, e *n diz quantos deles valem:
+ * - num bloco LITERAL, até JANELA_MOVIMENTOS códigos, lidos de uma vez;
+ * - num bloco REPETICAO, o código repetido nos 16 pares de bits e *n com
+ *   todo o bloco (até INT_MAX): girar a janela 2 bits não a altera;
+ * - num bloco PARADO, *n negativo, com -*n movimentos parados.
+ */
+static inline void sequencia_recarrega(const unsigned char *seq, CursorSequencia *c,
+                                       uint32_t *janela, int *n)
+{
+    if (c->restantes == 0)
+        sequencia_abre_bloco(seq, c);
+
+    if (c->tipo == BLOCO_LITERAL) {
+        // Os bytes do literal seguem em ordem; o último pode estar incompleto
+        const unsigned char *p = seq + c->pos;
+        uint32_t palavra = (uint32_t) p[0] | (uint32_t) p[1] << 8 | (uint32_t) p[2] << 16 |
+                           (uint32_t) p[3] << 24;
+        uint32_t disponiveis = JANELA_MOVIMENTOS - c->bit / 2;
+        uint32_t k = c->restantes < disponiveis ? c->restantes : disponiveis;
+        *janela = palavra >> c->bit;
+        *n = (int) k;
+
+        c->restantes -= k;
+        uint32_t codigos = c->bit / 2 + k;
+        c->pos += codigos / 4;
+        c->bit = (uint8_t) (2 * (codigos % 4));
+        if (c->restantes == 0 && c->bit != 0) {
+            c->pos++;
+            c->bit = 0;
+        }
+        return;
+    }
+
+    uint32_t k = c->restantes < INT_MAX ? c->restantes : INT_MAX;
+    c->restantes -= k;
+    if (c->tipo == BLOCO_REPETICAO) {
+        *janela = c->codigo * 0x55555555u;
+        *n = (int) k;
+    } else {
+        *janela = 0;
+        *n = -(int) k;
+    }
+}
+
+#endif /*__SEQUENCIA_H__*/
@@ -0,0 +1,315 @@
+/*
+ * Topologia NUMA e posicionamento dos trabalhadores (topologia.h).
+ */
+
+#define _GNU_SOURCE
+
+#include <dirent.h>
+#include <errno.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include "rally.h"
+#include "topologia.h"
+
+/* Maior ID de nó considerado */
+#define MAX_NOS 1024
+
+int modo_numa = 0;
+
+static pthread_once_t topologia_lida = PTHREAD_ONCE_INIT;
+static int num_nos;
+static int num_cpus;
+static int cpus[CPU_SETSIZE];           // CPUs utilizáveis, agrupadas por nó
+static short no_da_cpu[CPU_SETSIZE];    // Nó de cada CPU
+
+/* Nó de cada página de uma região, lido uma vez do kernel */
+typedef struct {
+    const char *base;
+    size_t tam;
+    short *no;  // -1 se a página ainda não existe
+} PaginasRegiao;
+
+static pthread_once_t paginas_lidas = PTHREAD_ONCE_INIT;
+static PaginasRegiao regioes[MAX_SEGMENTOS + 1];  // Segmentos da arena e campos quentes dos robôs
+static int num_regioes;
+static size_t tam_pagina;
+
+/* Nova região da arena e dos robôs, preenchida pelos trabalhadores */
+static struct {
+    char *segmentos[MAX_SEGMENTOS];  // Nova reserva dos ladrilhos (diretorio_nova_reserva)
+    const Posse *posses;
+    size_t *ordem;     // Ladrilhos da reserva atual, agrupados por dono
+    size_t *inicio;    // Início do grupo de cada trabalhador em ordem
+    char *campos;      // Campos quentes, no layout de cria_robos
+    RoboFrio *frio;
+} destino;
+
+/* Liga em 'conjunto' as CPUs de uma lista como "0-3,8-11" */
+static void le_lista_cpus(const char *caminho, cpu_set_t *conjunto)
+{
+    CPU_ZERO(conjunto);
+    FILE *f = fopen(caminho, "r");
+    if (!f)
+        return;
+    int ini, fim;
+    while (fscanf(f, "%d", &ini) == 1) {
+        fim = ini;
+        int sep = fgetc(f);
+        if (sep == '-') {
+            if (fscanf(f, "%d", &fim) != 1)
+                break;
+            sep = fgetc(f);
+        }
+        for (int c = ini; c <= fim && c < CPU_SETSIZE; c++)
+            CPU_SET(c, conjunto);
+        if (sep != ',')
+            break;
+    }
+    fclose(f);
+}
+
+static int compara_int(const void *a, const void *b)
+{
+    return *(const int *) a - *(const int *) b;
+}
+
+static void le_topologia()
+{
+    cpu_set_t permitidas;
+    if (sched_getaffinity(0, sizeof(permitidas), &permitidas) != 0) {
+        CPU_ZERO(&permitidas);
+        for (long c = 0; c < sysconf(_SC_NPROCESSORS_ONLN) && c < CPU_SETSIZE; c++)
+            CPU_SET(c, &permitidas);
+    }
+
+    // IDs dos nós, em ordem crescente
+    static int nos[MAX_NOS];
+    int n = 0;
+    DIR *dir = opendir("/sys/devices/system/node");
+    if (dir) {
+        struct dirent *e;
+        char resto;
+        int no;
+        while ((e = readdir(dir)) != NULL)
+            if (sscanf(e->d_name, "node%d%c", &no, &resto) == 1 && no < MAX_NOS && n < MAX_NOS)
+                nos[n++] = no;
+        closedir(dir);
+    }
+    qsort(nos, n, sizeof(int), compara_int);
+
+    for (int k = 0; k < n; k++) {
+        char caminho[64];
+        cpu_set_t do_no;
+        snprintf(caminho, sizeof(caminho), "/sys/devices/system/node/node%d/cpulist", nos[k]);
+        le_lista_cpus(caminho, &do_no);
+        int antes = num_cpus;
+        for (int c = 0; c < CPU_SETSIZE; c++)
+            if (CPU_ISSET(c, &do_no) && CPU_ISSET(c, &permitidas)) {
+                cpus[num_cpus++] = c;
+                no_da_cpu[c] = (short) nos[k];
+            }
+        if (num_cpus > antes)
+            num_nos++;
+    }
+
+    // Kernel sem NUMA: um único nó com todas as CPUs
+    if (num_cpus == 0) {
+        for (int c = 0; c < CPU_SETSIZE; c++)
+            if (CPU_ISSET(c, &permitidas))
+                cpus[num_cpus++] = c;
+        num_nos = 1;
+    }
+}
+
+int topologia_num_nos()
+{
+    pthread_once(&topologia_lida, le_topologia);
+    return num_nos;
+}
+
+int topologia_no_atual()
+{
+    pthread_once(&topologia_lida, le_topologia);
+    int c = sched_getcpu();
+    return (c >= 0 && c < CPU_SETSIZE) ? no_da_cpu[c] : -1;
+}
+
+pthread_attr_t *topologia_atributos(pthread_attr_t *attr, int t, int n)
+{
+    if (!modo_numa)
+        return NULL;
+    pthread_once(&topologia_lida, le_topologia);
+    if (num_cpus == 0)
+        return NULL;
+
+    // Trabalhadores de IDs vizinhos ficam em CPUs vizinhas, então no mesmo nó
+    cpu_set_t cpu;
+    CPU_ZERO(&cpu);
+    CPU_SET(cpus[(long) t * num_cpus / n], &cpu);
+    pthread_attr_init(attr);
+    pthread_attr_setaffinity_np(attr, sizeof(cpu), &cpu);
+    return attr;
+}
+
+static void *mapeia(size_t tam)
+{
+    void *regiao = mmap(NULL, tam, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (regiao == MAP_FAILED) {
+        perror("mmap");
+        exit(1);
+    }
+#ifdef MADV_HUGEPAGE
+    madvise(regiao, tam, MADV_HUGEPAGE);
+#endif
+    return regiao;
+}
+
+/* Trabalhador cuja posse contém a primeira célula do ladrilho k da reserva, ou 0 */
+static int dono_ladrilho(size_t k, int n)
+{
+    size_t base = arena_posicao_k(&sim->arena, k) << (2 * BITS_LADRILHO);
+    Coordenada i = celula_linha(base), j = celula_coluna(base);
+    for (int t = 0; t < n; t++) {
+        const Posse *p = &destino.posses[t];
+        if (i >= p->lin_ini && i < p->lin_fim && j >= p->col_ini && j < p->col_fim)
+            return t;
+    }
+    return 0;
+}
+
+/* Copia a posse de um trabalhador para a nova região; é o primeiro toque nessas páginas */
+static void *copia_posse(void *arg)
+{
+    const Posse *p = (const Posse *) arg;
+    int t = (int) (p - destino.posses);
+
+    // Os ladrilhos de cada trabalhador ficam contíguos na nova reserva
+    const Arena *a = &sim->arena;
+    for (size_t s = destino.inicio[t]; s < destino.inicio[t + 1]; s++)
+        memcpy(diretorio_endereco(&a->ladrilhos, destino.segmentos, s),
+               arena_ladrilho_k(a, destino.ordem[s]), sizeof(Ladrilho));
+
+    if (p->robo_fim > p->robo_ini) {
+        size_t n = (size_t) (p->robo_fim - p->robo_ini);
+        size_t tam_vetor = sim->robos.tam_mapeado / NUM_CAMPOS_QUENTES;
+        for (int v = 0; v < NUM_CAMPOS_QUENTES; v++) {
+            size_t desloc = tam_vetor * v + (size_t) p->robo_ini * tam_campos_quentes[v];
+            memcpy(destino.campos + desloc, (char *) sim->robos.i + desloc,
+                   n * tam_campos_quentes[v]);
+        }
+        memcpy(&destino.frio[p->robo_ini], &sim->robos.frio[p->robo_ini], n * sizeof(RoboFrio));
+    }
+    return NULL;
+}
+
+void topologia_distribui(const Posse *posses, int n)
+{
+    if (!modo_numa)
+        return;
+
+    // Agrupa os ladrilhos alocados por dono, na ordem da reserva
+    size_t alocados = arena_alocados(&sim->arena);
+    int *dono = (int *) malloc(sizeof(int) * (alocados > 0 ? alocados : 1));
+    destino.posses = posses;
+    destino.inicio = (size_t *) calloc(n + 1, sizeof(size_t));
+    destino.ordem = (size_t *) malloc(sizeof(size_t) * (alocados > 0 ? alocados : 1));
+    for (size_t k = 0; k < alocados; k++) {
+        dono[k] = dono_ladrilho(k, n);
+        destino.inicio[dono[k] + 1]++;
+    }
+    for (int t = 0; t < n; t++)
+        destino.inicio[t + 1] += destino.inicio[t];
+    size_t *proximo = (size_t *) malloc(sizeof(size_t) * n);
+    memcpy(proximo, destino.inicio, sizeof(size_t) * n);
+    for (size_t k = 0; k < alocados; k++)
+        destino.ordem[proximo[dono[k]]++] = k;
+    free(proximo);
+    free(dono);
+
+    diretorio_nova_reserva(&sim->arena.ladrilhos, destino.segmentos);
+    destino.campos = (char *) mapeia(sim->robos.tam_mapeado);
+    // Um bloco grande vem de um mmap próprio do malloc, ainda sem páginas
+    destino.frio = (RoboFrio *) malloc(sizeof(RoboFrio) * (sim->num_robos > 0 ? sim->num_robos : 1));
+
+    pthread_t *threads = (pthread_t *) malloc(sizeof(pthread_t) * n);
+    for (int t = 0; t < n; t++) {
+        pthread_attr_t attr;
+        pthread_attr_t *a = topologia_atributos(&attr, t, n);
+        cria_thread_simulacao(&threads[t], a, copia_posse, (void *) &posses[t]);
+        if (a)
+            pthread_attr_destroy(a);
+    }
+    for (int t = 0; t < n; t++)
+        pthread_join(threads[t], NULL);
+    free(threads);
+
+    // O diretório passa a apontar para as cópias
+    diretorio_troca_reserva(&sim->arena.ladrilhos, destino.segmentos, destino.ordem);
+    free(destino.ordem);
+    free(destino.inicio);
+    munmap(sim->robos.i, sim->robos.tam_mapeado);
+    aponta_robos(&sim->robos, destino.campos);
+    free(sim->robos.frio);
+    sim->robos.frio = destino.frio;
+}
+
+static void le_paginas_regiao(PaginasRegiao *rg, const void *base, size_t tam)
+{
+    size_t n = (tam + tam_pagina - 1) / tam_pagina;
+    void **paginas = (void **) malloc(sizeof(void *) * n);
+    int *status = (int *) malloc(sizeof(int) * n);
+    for (size_t k = 0; k < n; k++) {
+        paginas[k] = (char *) base + k * tam_pagina;
+        status[k] = 0;
+    }
+#ifdef SYS_move_pages
+    // Sem destinos, move_pages só informa o nó atual de cada página
+    if (syscall(SYS_move_pages, 0, (unsigned long) n, paginas, NULL, status, 0) != 0 &&
+        errno != ENOSYS)
+        for (size_t k = 0; k < n; k++)
+            status[k] = -1;
+#endif
+
+    rg->base = (const char *) base;
+    rg->tam = tam;
+    rg->no = (short *) malloc(sizeof(short) * (n > 0 ? n : 1));
+    for (size_t k = 0; k < n; k++)
+        rg->no[k] = (short) (status[k] >= 0 ? status[k] : -1);
+    free(paginas);
+    free(status);
+}
+
+/* Lê o nó das páginas já tocadas; as tabelas ficam até o fim do processo */
+static void le_paginas()
+{
+    tam_pagina = (size_t) sysconf(_SC_PAGESIZE);
+    // Só a parte já usada de cada segmento da reserva; os ladrilhos alocados
+    // depois ficam sem nó conhecido
+    const Arena *a = &sim->arena;
+    size_t alocados = arena_alocados(a);
+    for (size_t k = 0; k < alocados; k += diretorio_capacidade(num_regioes), num_regioes++) {
+        size_t n = alocados - k;
+        if (n > diretorio_capacidade(num_regioes))
+            n = diretorio_capacidade(num_regioes);
+        le_paginas_regiao(&regioes[num_regioes], diretorio_reserva_k(&a->ladrilhos, k),
+                          n * sizeof(Ladrilho));
+    }
+    le_paginas_regiao(&regioes[num_regioes++], sim->robos.i, sim->robos.tam_mapeado);
+}
+
+int topologia_no_do_endereco(const void *p)
+{
+    pthread_once(&paginas_lidas, le_paginas);
+    const char *c = (const char *) p;
+    for (int r = 0; r < num_regioes; r++)
+        if (c >= regioes[r].base && c < regioes[r].base + regioes[r].tam)
+            return regioes[r].no[(c - regioes[r].base) / tam_pagina];
+    return -1;
+}
@@ -0,0 +1,51 @@
+#ifndef __TOPOLOGIA_H__
+#define __TOPOLOGIA_H__
+
+/*
+ * Topologia NUMA e posicionamento dos trabalhadores (-N).
+ *
+ * As CPUs e os nós são lidos de /sys/devices/system/node, restritos às
+ * CPUs em que o processo pode rodar. Sem esse diretório (kernel sem NUMA),
+ * todas as CPUs ficam num único nó.
+ *
+ * Com -N, cada trabalhador dos motores pool, plano e blocos é fixado numa
+ * CPU, com trabalhadores vizinhos no mesmo nó, e antes do primeiro turno
+ * cada um toca primeiro as linhas da arena e a fatia dos robôs que são
+ * dele, para que o kernel ponha essas páginas no nó da sua CPU.
+ */
+
+#include <pthread.h>
+
+/* Parte da arena e dos robôs de um trabalhador */
+typedef struct {
+    Coordenada lin_ini, lin_fim;    // Linhas [lin_ini, lin_fim)
+    Coordenada col_ini, col_fim;    // Colunas [col_ini, col_fim)
+    int robo_ini, robo_fim;  // Robôs [robo_ini, robo_fim)
+} Posse;
+
+/* 1 com -N: fixa os trabalhadores e distribui a memória pelos nós */
+extern int modo_numa;
+
+int topologia_num_nos();
+
+/* Nó da CPU em que a thread que chama está rodando agora */
+int topologia_no_atual();
+
+/*
+ * Prepara attr para criar o trabalhador t de n fixado na sua CPU.
+ * Retorna attr, ou NULL sem -N (atributos padrão).
+ */
+pthread_attr_t *topologia_atributos(pthread_attr_t *attr, int t, int n);
+
+/*
+ * Com -N, recria a região das células da arena e a dos robôs: cada um
+ * dos n trabalhadores, já fixado na sua CPU, copia para a nova região a
+ * parte descrita em posses[t]. Deve ser chamada com as threads do motor
+ * ainda paradas. Sem -N, não faz nada.
+ */
+void topologia_distribui(const Posse *posses, int n);
+
+/* Nó da página do endereço p da arena ou dos robôs, ou -1 se desconhecido */
+int topologia_no_do_endereco(const void *p);
+
+#endif /*__TOPOLOGIA_H__*/